@@ -1,14 +1,16 @@
 #pragma once
 
 #include "s_precomp.h"
+#include "s_platform.h"
+#include "s_memory_category.h"
 #include "s_memory_config.h"
 
 namespace Skanim
 {
     /** The allocator used by std containers and other memory allocation/deallocation
-     *  operations.
+     *  operations. The memory comes from the alloc manager of category C.
      */
-    template <typename T>
+    template <typename T, MemoryCategory C = MEMORY_CATEGORY_GENERAL>
     class Allocator
     {
     public:
@@ -25,7 +27,7 @@ namespace Skanim
         Allocator(const Allocator &) = default;
 
         template <typename U>
-        Allocator(const Allocator<U> &) noexcept
+        Allocator(const Allocator<U, C> &) noexcept
         {}
 
         ~Allocator() = default;
@@ -33,7 +35,7 @@ namespace Skanim
         template <typename U>
         struct rebind
         {
-            typedef Allocator<U> other;
+            typedef Allocator<U, C> other;
         };
 
         pointer address(reference r) const
@@ -48,18 +50,26 @@ namespace Skanim
 
         size_type max_size() const
         {
-            return MemoryConfig::getGlobalAllocManager()->
+            return MemoryConfig::getAllocManager(C)->
                 getMaxAllocationSize();
         }
 
         /** Allocate memory for n number object T but doesn't construct them.
-         *  The second argumant is not used.
+         *  The memory is aligned to alignof(T), over-aligned types get aligned
+         *  allocations. The second argumant is not used.
          */
          pointer allocate(size_type n, const void *p = nullptr)
          {
              assert(n > 0);
-             return static_cast<pointer>(MemoryConfig::getGlobalAllocManager()->
-                 allocateBytes(n * sizeof(T)));
+             if (alignof(T) > IAllocManager::DEFAULT_ALIGNMENT) {
+                 return static_cast<pointer>(MemoryConfig::getAllocManager(C)->
+                     allocateAlignedBytes(n * sizeof(T), alignof(T), _SKANIM_CALL_SITE));
+             }
+
+             // With memory tracking the function name tells the element
+             // type and the category.
+             return static_cast<pointer>(MemoryConfig::getAllocManager(C)->
+                 allocateBytes(n * sizeof(T), _SKANIM_CALL_SITE));
          }
 
         /** Deallocate the memory which is allocated by allocate()
@@ -68,7 +78,13 @@ namespace Skanim
          void deallocate(pointer p, size_type size = 0)
          {
              assert(p != nullptr);
-             MemoryConfig::getGlobalAllocManager()->
+             if (alignof(T) > IAllocManager::DEFAULT_ALIGNMENT) {
+                 MemoryConfig::getAllocManager(C)->
+                     deallocateAlignedBytes(static_cast<void*>(p));
+                 return;
+             }
+
+             MemoryConfig::getAllocManager(C)->
                  deallocateBytes(static_cast<void*>(p));
          }
 
@@ -91,19 +107,21 @@ namespace Skanim
 
     /** Determine allocator equality.
      */
-    template <typename T1, typename T2>
-    bool operator==(const Allocator<T1> &, const Allocator<T2> &) noexcept
+    template <typename T1, typename T2, MemoryCategory C>
+    bool operator==(const Allocator<T1, C> &, const Allocator<T2, C> &) noexcept
     {
-        // Memory from other allocator can be released by this allocator.
+        // Memory from other allocator of the same category can be released by
+        // this allocator.
         return true;
     }
 
     /** Determine allocator equality.
      */
-    template <typename T1, typename T2>
-    bool operator!=(const Allocator<T1> &, const Allocator<T2> &) noexcept
+    template <typename T1, typename T2, MemoryCategory C>
+    bool operator!=(const Allocator<T1, C> &, const Allocator<T2, C> &) noexcept
     {
-        // Memory from other allocator can be released by this allocator.
+        // Memory from other allocator of the same category can be released by
+        // this allocator.
         return false;
     }
 };
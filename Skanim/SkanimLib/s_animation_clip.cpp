@@ -29,11 +29,33 @@ namespace Skanim
         // directly since it's impossible to lerp between the key pose next to it.
         if (key_index != m_key_pose_sequence.size() - 1) {
             Pose::lerp(t, m_key_pose_sequence[key_index], 
-                m_key_pose_sequence[key_index + 1], extracted_pose);
+                m_key_pose_sequence[key_index + 1], extracted_pose,
+                QuaternionBatch::MODE_SLERP_FAST);
         }
         else {
             *extracted_pose = m_key_pose_sequence[key_index];
         }
     }
 
+    void KeyPoseAnimationClip::extractPose(long local_time,
+        const JointRange *ranges, size_t range_count, Pose *extracted_pose) const
+    {
+        assert(local_time >= 0 && local_time <= getLength() &&
+            "local time out of range");
+
+        const int key_index = local_time / m_key_pose_interval;
+        const float t = (float)local_time / m_key_pose_interval - key_index;
+        // The last key pose is interpolated with itself.
+        const size_t next_key_index = std::min((size_t)key_index + 1,
+            m_key_pose_sequence.size() - 1);
+
+        extracted_pose->resize(m_track_count);
+
+        for (size_t i_range = 0; i_range < range_count; ++i_range) {
+            Pose::lerp(t, m_key_pose_sequence[key_index],
+                m_key_pose_sequence[next_key_index], ranges[i_range],
+                extracted_pose, QuaternionBatch::MODE_SLERP_FAST);
+        }
+    }
+
 };
\ No newline at end of file
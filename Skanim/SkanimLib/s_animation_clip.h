@@ -37,6 +37,12 @@ namespace Skanim
         virtual void extractPose(long local_time, Pose *extracted_pose) 
             const override;
 
+        /** Extract the joints in the given ranges from this clip with local
+         *  time.
+         */
+        virtual void extractPose(long local_time, const JointRange *ranges,
+            size_t range_count, Pose *extracted_pose) const override;
+
         /** Get the number of key poses.
          */
         size_t getKeyPoseCount() const
@@ -123,7 +129,7 @@ namespace Skanim
         }
 
     private:
-        typedef vector<Pose> _PosesArray;
+        typedef std::vector<Pose, Allocator<Pose, MEMORY_CATEGORY_ANIMATION_CLIP>> _PosesArray;
 
         // The number of joint tracks.
         const size_t m_track_count;
@@ -0,0 +1,90 @@
+#include "s_precomp.h"
+#include "s_animation_crossfader.h"
+#include "s_animation_state.h"
+
+namespace Skanim
+{
+    AnimationCrossfader::AnimationCrossfader() noexcept
+        : m_current_state(nullptr),
+          m_outgoing_state(nullptr),
+          m_fade_time(0),
+          m_fade_elapsed_time(0),
+          m_sample_threshold(0.01f)
+    {}
+
+    void AnimationCrossfader::play(AnimationState *animation_state,
+        bool reset_state)
+    {
+        assert(animation_state && "animation state can't be nullptr");
+
+        m_current_state = animation_state;
+        m_outgoing_state = nullptr;
+
+        if (reset_state)
+            m_current_state->reset();
+        else
+            m_current_state->discardRootMotion();
+    }
+
+    void AnimationCrossfader::crossfade(AnimationState *animation_state,
+        long fade_time, bool reset_state)
+    {
+        assert(animation_state && "animation state can't be nullptr");
+
+        if (animation_state == m_current_state)
+            return;
+
+        if (!m_current_state || fade_time <= 0) {
+            play(animation_state, reset_state);
+            return;
+        }
+
+        m_outgoing_state = m_current_state;
+        m_current_state = animation_state;
+        m_fade_time = fade_time;
+        m_fade_elapsed_time = 0;
+
+        // The last root transform of the incoming state could be from long
+        // ago, so its first delta root transform starts from the pose it's
+        // faded in at, which is its first pose if it's reset.
+        if (reset_state)
+            m_current_state->reset();
+        else
+            m_current_state->discardRootMotion();
+    }
+
+    void AnimationCrossfader::update(long elapsed_time, Pose *result)
+    {
+        assert(m_current_state && "no animation state to play");
+
+        float outgoing_weight = 0.0f;
+        if (m_outgoing_state) {
+            m_fade_elapsed_time += elapsed_time;
+            outgoing_weight = getOutgoingWeight();
+
+            // End the transition once the outgoing state is too light to be
+            // worth sampling.
+            if (outgoing_weight <= m_sample_threshold)
+                m_outgoing_state = nullptr;
+        }
+
+        m_current_state->advanceTime(elapsed_time, result);
+
+        if (m_outgoing_state) {
+            m_outgoing_state->advanceTime(elapsed_time, &m_outgoing_pose);
+
+            // Both root transforms are deltas since the last update, so
+            // blending them gives the blended root motion.
+            Pose::lerp(1.0f - outgoing_weight, m_outgoing_pose, *result, result);
+        }
+    }
+
+    float AnimationCrossfader::getOutgoingWeight() const
+    {
+        if (!m_outgoing_state)
+            return 0.0f;
+
+        return 1.0f - Math::clamp01((float)m_fade_elapsed_time / m_fade_time);
+    }
+
+};
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_pose.h"
+
+namespace Skanim
+{
+    class AnimationState;
+
+    /** Animation crossfader plays one animation state at a time and fades from
+     *  one state to another. During a transition the incoming state is
+     *  extracted into the destination pose and the outgoing state is blended
+     *  over it in place. The outgoing state is only sampled while its weight is
+     *  above the sample threshold, once it drops below that the transition
+     *  ends. The root joint of the destination pose holds the blend of the two
+     *  states' delta root transforms.
+     */
+    class _SKANIM_EXPORT AnimationCrossfader
+    {
+    public:
+        AnimationCrossfader() noexcept;
+
+        /** Play the given state immediately and stop any transition. The state
+         *  is reset if reset_state is true, otherwise it continues from where
+         *  it is without the root motion since it was last extracted.
+         */
+        void play(AnimationState *animation_state, bool reset_state = true);
+
+        /** Fade from the current state to the given state in fade_time. The
+         *  state is reset if reset_state is true, otherwise it continues from
+         *  where it is and the root motion since it was last extracted is
+         *  discarded, so the blended root doesn't jump. If a transition is
+         *  already running its outgoing state is dropped, and the current
+         *  state starts fading out from full weight. If there is no current state, or
+         *  fade_time isn't positive, the state is played immediately. Fading
+         *  to the current state does nothing.
+         */
+        void crossfade(AnimationState *animation_state, long fade_time,
+            bool reset_state = true);
+
+        /** Advance the time of the states and the transition, and extract the
+         *  blended pose into result.
+         */
+        void update(long elapsed_time, Pose *result);
+
+        /** Get the current state, which is the incoming state if a transition
+         *  is running.
+         */
+        AnimationState *getCurrentState() const
+        {
+            return m_current_state;
+        }
+
+        /** Get the outgoing state of the running transition, or nullptr if
+         *  there is no transition.
+         */
+        AnimationState *getOutgoingState() const
+        {
+            return m_outgoing_state;
+        }
+
+        /** Check if a transition is running.
+         */
+        bool isFading() const
+        {
+            return m_outgoing_state != nullptr;
+        }
+
+        /** Get the weight of the outgoing state, which is zero if there is no
+         *  transition.
+         */
+        float getOutgoingWeight() const;
+
+        /** Get the sample threshold. The outgoing state is sampled only while
+         *  its weight is above it.
+         */
+        float getSampleThreshold() const
+        {
+            return m_sample_threshold;
+        }
+
+        /** Modify the sample threshold, which is clamped to [0, 1].
+         */
+        void setSampleThreshold(float threshold)
+        {
+            m_sample_threshold = Math::clamp01(threshold);
+        }
+
+    private:
+        // The current state, which is the incoming state during a transition.
+        AnimationState *m_current_state;
+        // The outgoing state, or nullptr if there is no transition.
+        AnimationState *m_outgoing_state;
+
+        // The length and the elapsed time of the transition.
+        long m_fade_time;
+        long m_fade_elapsed_time;
+
+        // The weight below which the outgoing state isn't sampled.
+        float m_sample_threshold;
+
+        // The pose the outgoing state is extracted into. It keeps its buffer
+        // between transitions.
+        Pose m_outgoing_pose;
+    };
+};
\ No newline at end of file
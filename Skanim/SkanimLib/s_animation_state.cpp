@@ -1,6 +1,7 @@
 #include "s_precomp.h"
 #include "s_animation_state.h"
 #include "s_ianimation_clip.h"
+#include "s_root_motion_track.h"
 
 namespace Skanim
 {
@@ -10,7 +11,11 @@ namespace Skanim
           m_current_local_time(0),
           m_is_looping(false),
           m_jump_flag(JUMP_FLAG_NONE),
-          m_last_root_transform(Transform::IDENTITY())
+          m_root_motion_track(nullptr),
+          m_last_local_time(0),
+          m_loop_count(0),
+          m_last_root_transform(Transform::IDENTITY()),
+          m_is_last_root_transform_outdated(false)
     {}
 
     AnimationState::AnimationState(const String &name, 
@@ -21,10 +26,30 @@ namespace Skanim
           m_current_local_time(0),
           m_is_looping(loop_play),
           m_jump_flag(JUMP_FLAG_NONE),
-          m_last_root_transform(Transform::IDENTITY())
+          m_root_motion_track(nullptr),
+          m_last_local_time(0),
+          m_loop_count(0),
+          m_last_root_transform(Transform::IDENTITY()),
+          m_is_last_root_transform_outdated(false)
     {}
 
     void AnimationState::advanceTime(long elapsed_time)
+    {
+        advanceTime(elapsed_time, &m_current_pose);
+    }
+
+    void AnimationState::advanceTime(long elapsed_time, Pose *extracted_pose)
+    {
+        _advanceLocalTime(elapsed_time);
+
+        // Update the current pose.
+        if (extracted_pose)
+            _updateCurrentPose(extracted_pose);
+        else
+            discardRootMotion();
+    }
+
+    void AnimationState::_advanceLocalTime(long elapsed_time)
     {
         assert(m_animation_clip && "no animation clip");
 
@@ -48,10 +73,13 @@ namespace Skanim
                 m_jump_flag = JUMP_FLAG_NONE;
             }
             else {
-                m_current_local_time /= animation_clip_time_length;
+                // Wrap the time into the clip and count the wraps.
+                long loop_count = m_current_local_time / animation_clip_time_length;
+                m_current_local_time %= animation_clip_time_length;
 
                 if (m_current_local_time < 0) {
                     m_current_local_time += animation_clip_time_length;
+                    --loop_count;
                     // Jump to the front happens.
                     m_jump_flag = JUMP_FLAG_FORWARD;
                 }
@@ -59,54 +87,120 @@ namespace Skanim
                     // Backward jump happens.
                     m_jump_flag = JUMP_FLAG_BACKWARD;
                 }
+
+                m_loop_count += (int)loop_count;
             }
         }
         else {
             m_jump_flag = JUMP_FLAG_NONE;
         }
-
-        // Update the current pose.
-        _updateCurrentPose();
     }
 
     void AnimationState::reset()
     {
         // Set the current local time to 0.
         m_current_local_time = 0;
+        m_last_local_time = 0;
+        m_loop_count = 0;
 
         // Update the current pose so the current pose is the first pose of the
         // animation.
-        _updateCurrentPose();
+        _updateCurrentPose(&m_current_pose);
 
         // Overwrite the delta root motion in the pose to be identity so
         // the root won't move.
         m_current_pose.setJointTransform(0, Transform::IDENTITY());
     }
 
+    void AnimationState::discardRootMotion()
+    {
+        m_is_last_root_transform_outdated = true;
+        // The root motion track measures from the last local time.
+        m_last_local_time = m_current_local_time;
+        m_loop_count = 0;
+    }
+
     void AnimationState::setAnimationClip(const IAnimationClip *clip)
     {
         assert(clip && "animation clip can't be nullptr");
 
         m_animation_clip = clip;
+        m_clip_handle.reset();
+        // The track was built from the previous clip.
+        m_root_motion_track = nullptr;
 
         reset();
 
         _updateBoundaryRootTransforms();
     }
 
-    void AnimationState::_updateCurrentPose()
+    void AnimationState::setAnimationClip(const ClipHandle &clip_handle)
+    {
+        // Hold the new handle before releasing the old one, in case they
+        // refer to the same clip.
+        ClipHandle handle = clip_handle;
+        setAnimationClip(handle.get());
+        m_clip_handle = std::move(handle);
+    }
+
+    void AnimationState::setRootMotionTrack(const RootMotionTrack *root_motion_track)
+    {
+        assert((!root_motion_track || !m_animation_clip ||
+            root_motion_track->getLength() == m_animation_clip->getLength()) &&
+            "the root motion track isn't built from the animation clip");
+
+        m_root_motion_track = root_motion_track;
+
+        // Measure the root motion from the current time on.
+        m_last_local_time = m_current_local_time;
+        m_loop_count = 0;
+    }
+
+    void AnimationState::setJointRanges(const vector<JointRange> &ranges)
+    {
+        m_joint_ranges = ranges;
+
+        // The root transform is needed to calculate the root motion.
+        if (!m_joint_ranges.empty() && m_joint_ranges.front().begin > 0) {
+            const JointRange root_range = { 0, 1 };
+            if (m_joint_ranges.front().begin == 1)
+                m_joint_ranges.front().begin = 0;
+            else
+                m_joint_ranges.insert(m_joint_ranges.begin(), root_range);
+        }
+    }
+
+    void AnimationState::_updateCurrentPose(Pose *current_pose)
     {
         // Extract the current pose from animation clip.
-        m_animation_clip->extractPose(m_current_local_time, &m_current_pose);
+        if (m_joint_ranges.empty()) {
+            m_animation_clip->extractPose(m_current_local_time, current_pose);
+        }
+        else {
+            m_animation_clip->extractPose(m_current_local_time,
+                m_joint_ranges.data(), m_joint_ranges.size(), current_pose);
+        }
 
         // Keep the current root transform and calculate the delta root transform.
-        Transform current_root_transform = m_current_pose.getJointTransform(0);
+        Transform current_root_transform = current_pose->getJointTransform(0);
         Transform delta_root_transform;
 
         // Calculate the delta root motion.
         // There could be local time jump due to loop playing, if jump happens we
         // should handle this special situation.
-        if (m_jump_flag == JUMP_FLAG_NONE) {
+        if (m_root_motion_track) {
+            // The track gives the delta since the last extraction directly,
+            // however many times the playback wrapped around.
+            delta_root_transform = m_root_motion_track->getDelta(m_last_local_time,
+                m_current_local_time, m_loop_count);
+            m_is_last_root_transform_outdated = false;
+        }
+        else if (m_is_last_root_transform_outdated) {
+            // There is no valid last root transform to measure the motion from.
+            delta_root_transform = Transform::IDENTITY();
+            m_is_last_root_transform_outdated = false;
+        }
+        else if (m_jump_flag == JUMP_FLAG_NONE) {
             delta_root_transform = Transform::combine(current_root_transform,
                 m_last_root_transform.inversed());
         }
@@ -139,19 +233,23 @@ namespace Skanim
         // Keep the current root transform and replace the root transform
         // in current pose with delta root transform.
         m_last_root_transform = current_root_transform;
-        m_current_pose.setJointTransform(0, delta_root_transform);
+        m_last_local_time = m_current_local_time;
+        m_loop_count = 0;
+        current_pose->setJointTransform(0, delta_root_transform);
     }
 
     void AnimationState::_updateBoundaryRootTransforms()
     {
         // Extract the root transform of the begin pose and the end pose in the
-        // animation clip.
+        // animation clip. Only the root joint is decoded.
         Pose temp_pose;
+        const JointRange root_range = { 0, 1 };
 
-        m_animation_clip->extractPose(0, &temp_pose);
+        m_animation_clip->extractPose(0, &root_range, 1, &temp_pose);
         m_begining_root_transform = temp_pose.getJointTransform(0);
 
-        m_animation_clip->extractPose(m_animation_clip->getLength(), &temp_pose);
+        m_animation_clip->extractPose(m_animation_clip->getLength(), &root_range,
+            1, &temp_pose);
         m_end_root_transform = temp_pose.getJointTransform(0);
     }
 
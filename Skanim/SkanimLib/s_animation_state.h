@@ -1,11 +1,14 @@
 #pragma once
 
 #include "s_prerequisites.h"
+#include "s_clip_cache.h"
 #include "s_pose.h"
 #include "s_transform.h"
 
 namespace Skanim
 {
+    class RootMotionTrack;
+
     /** An animation state could play a animation clip, just like a player.
      *  It keeps the current playback time of the animation clip and extract 
      *  current pose from animation clip which is being used. It also converts
@@ -24,11 +27,25 @@ namespace Skanim
          */
         void advanceTime(long elapsed_time);
 
+        /** Advance time of this state and extract the current pose into the
+         *  given pose instead of the state's own current pose, which is left
+         *  unchanged. It's used to update many states into scratch poses.
+         *  If extracted_pose is nullptr only the time advances and nothing is
+         *  extracted, the root motion of the skipped time is discarded.
+         */
+        void advanceTime(long elapsed_time, Pose *extracted_pose);
+
         /** Reset the animation state. This will set the current playback position
          *  to the begining of the animation clip.
          */
         void reset();
 
+        /** Discard the root motion since the last extracted pose, so the next
+         *  extracted pose has no root motion. Use it when a state which wasn't
+         *  extracted for a while is played again without being reset.
+         */
+        void discardRootMotion();
+
         /** Get the name of this animation state.
          */
         const String &getName() const
@@ -56,6 +73,11 @@ namespace Skanim
          */
         void setAnimationClip(const IAnimationClip *clip);
 
+        /** Modify the animation clip to a clip of a clip cache. The animation
+         *  state holds the handle, so the clip isn't evicted while it's used.
+         */
+        void setAnimationClip(const ClipHandle &clip_handle);
+
         /** Get the playback speed of this animation state.
          */
         float getSpeed() const 
@@ -84,6 +106,39 @@ namespace Skanim
             m_is_looping = enable;
         }
 
+        /** Get the root motion track of the animation clip, or nullptr if
+         *  the root motion is measured from the extracted poses.
+         */
+        const RootMotionTrack *getRootMotionTrack() const
+        {
+            return m_root_motion_track;
+        }
+
+        /** Modify the root motion track of the animation clip, which must be
+         *  built from the clip played by this state. The delta root transforms
+         *  are then taken from the track, which measures them exactly across
+         *  loops and jumps. Give nullptr to measure the root motion from the
+         *  extracted poses again. The track is removed when the animation clip
+         *  changes.
+         */
+        void setRootMotionTrack(const RootMotionTrack *root_motion_track);
+
+        /** Restrict the extraction to the joints in the given ranges, which
+         *  must be sorted and must not overlap. It's useful for states played
+         *  by masked layers, where only the masked joints are needed. The root
+         *  joint is always extracted for the root motion. Give an empty vector
+         *  to extract all the joints again.
+         */
+        void setJointRanges(const vector<JointRange> &ranges);
+
+        /** Get the ranges of the joints which are extracted. It's empty if all
+         *  the joints are extracted.
+         */
+        const vector<JointRange> &getJointRanges() const
+        {
+            return m_joint_ranges;
+        }
+
         /** Get the current pose extracted from animation clip.
          */
         const Pose &getCurrentPose() const
@@ -93,8 +148,12 @@ namespace Skanim
 
     private:
 
-        // Update the current extracted pose.
-        void _updateCurrentPose();
+        // Advance the current local time and update the jump flag.
+        void _advanceLocalTime(long elapsed_time);
+
+        // Extract the current pose into the given pose and convert its root
+        // transform to the delta root transform.
+        void _updateCurrentPose(Pose *current_pose);
 
         // Update the begining root transform and the end root transform.
         void _updateBoundaryRootTransforms();
@@ -104,6 +163,8 @@ namespace Skanim
         String m_name;
         // The animation clip used by this animation state.
         const IAnimationClip *m_animation_clip;
+        // The handle of the animation clip if it's from a clip cache.
+        ClipHandle m_clip_handle;
         
         // The playback speed factor.
         float m_speed;
@@ -121,13 +182,27 @@ namespace Skanim
         const int JUMP_FLAG_BACKWARD = -1;
         const int JUMP_FLAG_NONE = 0;
 
+        // The root motion track of the animation clip, or nullptr.
+        const RootMotionTrack *m_root_motion_track;
+        // The local time of the last extraction, and the number of times the
+        // playback wrapped around the clip since then. Only used with a root
+        // motion track.
+        long m_last_local_time;
+        int m_loop_count;
+
         // The the extracted root transform last time.
         Transform m_last_root_transform;
+        // Indicate that the time advanced without extracting poses, so the last
+        // root transform is outdated.
+        bool m_is_last_root_transform_outdated;
         // The first pose's root transform in the animation clip.
         Transform m_begining_root_transform;
         // The end pose's root transform in the animation clip.
         Transform m_end_root_transform;
         // Current pose.
         Pose m_current_pose;
+        // The ranges of the joints which are extracted, all the joints are
+        // extracted if it's empty.
+        vector<JointRange> m_joint_ranges;
     };
 };
\ No newline at end of file
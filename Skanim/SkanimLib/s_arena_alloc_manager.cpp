@@ -0,0 +1,120 @@
+#include "s_precomp.h"
+#include "s_arena_alloc_manager.h"
+
+namespace Skanim
+{
+    ArenaAllocManager::ArenaAllocManager(size_t capacity,
+        IAllocManager *upstream) noexcept
+        : m_upstream(upstream ? upstream : &m_default_upstream),
+          m_chunks(nullptr),
+          m_current(0),
+          m_end(0),
+          m_used_size(0),
+          m_capacity(0)
+    {
+        if (capacity > 0)
+            _addChunk(capacity);
+    }
+
+    ArenaAllocManager::~ArenaAllocManager()
+    {
+        _releaseChunks();
+    }
+
+    void *ArenaAllocManager::allocateBytes(size_t count, const wchar_t *file,
+        int line, const wchar_t *func)
+    {
+        return _allocate(count, _ALIGNMENT);
+    }
+
+    void ArenaAllocManager::deallocateBytes(void *ptr)
+    {
+        // The arena's own memory is released by reset().
+        if (ptr != nullptr && !owns(ptr))
+            m_upstream->deallocateBytes(ptr);
+    }
+
+    void *ArenaAllocManager::allocateAlignedBytes(size_t count,
+        size_t alignment, const wchar_t *file, int line, const wchar_t *func)
+    {
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0 &&
+            "alignment isn't a power of two");
+        return _allocate(count, std::max(alignment, _ALIGNMENT));
+    }
+
+    void ArenaAllocManager::deallocateAlignedBytes(void *ptr)
+    {
+        if (ptr != nullptr && !owns(ptr))
+            m_upstream->deallocateAlignedBytes(ptr);
+    }
+
+    void ArenaAllocManager::reset()
+    {
+        // Merge the chunks into a single one which could hold a whole frame.
+        if (m_chunks != nullptr && m_chunks->next != nullptr) {
+            const size_t capacity = m_capacity;
+            _releaseChunks();
+            _addChunk(capacity);
+        }
+
+        m_current = m_chunks ?
+            reinterpret_cast<uintptr_t>(m_chunks) + _CHUNK_HEADER_SIZE : 0;
+        m_used_size = 0;
+    }
+
+    void *ArenaAllocManager::_allocate(size_t count, size_t alignment)
+    {
+        uintptr_t address = (m_current + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (m_chunks == nullptr || address + count > m_end) {
+            // Make the new chunk at least as large as everything allocated so
+            // far, so the number of chunks grows logarithmically in a frame.
+            _addChunk(std::max(count + alignment - _ALIGNMENT, m_capacity));
+            address = (m_current + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        }
+
+        m_used_size += address + count - m_current;
+        m_current = address + count;
+
+        return reinterpret_cast<void*>(address);
+    }
+
+    bool ArenaAllocManager::owns(const void *ptr) const
+    {
+        const uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+        for (_ChunkHeader *chunk = m_chunks; chunk; chunk = chunk->next) {
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(chunk) + _CHUNK_HEADER_SIZE;
+            if (address >= begin && address < begin + chunk->size)
+                return true;
+        }
+        return false;
+    }
+
+    void ArenaAllocManager::_addChunk(size_t n_bytes)
+    {
+        // Keep the chunk size aligned so the next chunk's allocations are.
+        n_bytes = (n_bytes + _ALIGNMENT - 1) & ~(_ALIGNMENT - 1);
+
+        _ChunkHeader *chunk = static_cast<_ChunkHeader*>(
+            m_upstream->allocateBytes(_CHUNK_HEADER_SIZE + n_bytes));
+        chunk->next = m_chunks;
+        chunk->size = n_bytes;
+        m_chunks = chunk;
+
+        m_current = reinterpret_cast<uintptr_t>(chunk) + _CHUNK_HEADER_SIZE;
+        m_end = m_current + n_bytes;
+        m_capacity += n_bytes;
+    }
+
+    void ArenaAllocManager::_releaseChunks()
+    {
+        while (m_chunks) {
+            _ChunkHeader *next = m_chunks->next;
+            m_upstream->deallocateBytes(m_chunks);
+            m_chunks = next;
+        }
+
+        m_current = 0;
+        m_end = 0;
+        m_capacity = 0;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_default_alloc_manager.h"
+#include "s_ialloc_manager.h"
+
+namespace Skanim
+{
+    /** Arena alloc manager is a linear alloc manager for memory which only
+     *  lives during a frame. Allocations bump a pointer, deallocations of its
+     *  own memory do nothing, and everything is released at once by reset().
+     *  Like FrameArena it merges the chunks added during a frame into one at
+     *  the next reset.
+     *  Memory which the arena didn't allocate is freed by the upstream alloc
+     *  manager, so it could be installed as the alloc manager of a memory
+     *  category for a scope, with the alloc manager it replaces as upstream.
+     *  Memory allocated by the arena must not be used after reset() and must
+     *  not be freed by another alloc manager. The manager isn't thread safe,
+     *  so a category must only be used by one thread while the arena is
+     *  installed.
+     */
+    class _SKANIM_EXPORT ArenaAllocManager : public IAllocManager
+    {
+    public:
+        /** Construct an arena alloc manager.
+         *  @param capacity The initial capacity in bytes.
+         *  @param upstream The alloc manager of the chunks and of the memory
+         *  not allocated by the arena. If it's nullptr malloc() and free() are
+         *  used.
+         */
+        explicit ArenaAllocManager(size_t capacity = 0,
+            IAllocManager *upstream = nullptr) noexcept;
+
+        virtual ~ArenaAllocManager();
+
+        ArenaAllocManager(const ArenaAllocManager &) = delete;
+
+        ArenaAllocManager &operator=(const ArenaAllocManager &) = delete;
+
+        virtual void *allocateBytes(size_t count,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr) override;
+
+        virtual void deallocateBytes(void *ptr) override;
+
+        virtual size_t getMaxAllocationSize() override
+        {
+            return m_upstream->getMaxAllocationSize() - _CHUNK_HEADER_SIZE;
+        }
+
+        virtual void *allocateAlignedBytes(size_t count, size_t alignment,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr) override;
+
+        virtual void deallocateAlignedBytes(void *ptr) override;
+
+        /** Release all the allocations at once.
+         */
+        void reset();
+
+        /** Check if a pointer is inside the memory of the arena.
+         */
+        bool owns(const void *ptr) const;
+
+        /** Get the number of bytes allocated since the last reset, including
+         *  the alignment padding.
+         */
+        size_t getUsedSize() const
+        {
+            return m_used_size;
+        }
+
+        /** Get the total capacity of all the chunks in bytes.
+         */
+        size_t getCapacity() const
+        {
+            return m_capacity;
+        }
+
+    private:
+        // Allocations are aligned at least like malloc() does.
+        static const size_t _ALIGNMENT = 16;
+
+        // The chunk header holds the next chunk and the chunk size.
+        static const size_t _CHUNK_HEADER_SIZE = 16;
+
+        struct _ChunkHeader
+        {
+            _ChunkHeader *next;
+            size_t size;
+        };
+
+        // Bump allocate count bytes with the given alignment.
+        void *_allocate(size_t count, size_t alignment);
+
+        // Add a chunk which holds at least n_bytes and make it the current
+        // chunk.
+        void _addChunk(size_t n_bytes);
+
+        // Free all the chunks.
+        void _releaseChunks();
+
+    private:
+        // Used as the upstream if none is given.
+        DefaultAllocManager m_default_upstream;
+        IAllocManager *m_upstream;
+
+        // The chunks, the current one first. They are linked through their
+        // headers so the arena needs no container, which could allocate from
+        // the arena itself.
+        _ChunkHeader *m_chunks;
+
+        // The begin and the end of the free space in the current chunk.
+        uintptr_t m_current;
+        uintptr_t m_end;
+
+        size_t m_used_size;
+        size_t m_capacity;
+    };
+};
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "s_precomp.h"
+#include "s_asset_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Skanim
+{
+#ifndef _WIN32
+    namespace
+    {
+        // Convert a file name to the narrow string POSIX functions take.
+        // Only ASCII file names are supported.
+        std::string _toNarrowFileName(const String &file_name)
+        {
+            std::string narrow_file_name;
+            narrow_file_name.reserve(file_name.size());
+            for (auto c : file_name)
+                narrow_file_name.push_back((char)c);
+            return narrow_file_name;
+        }
+    }
+#endif
+
+    AssetFile::AssetFile() noexcept
+        : m_data(nullptr),
+          m_size(0),
+          m_file_handle(nullptr),
+          m_mapping_handle(nullptr)
+    {}
+
+    AssetFile::~AssetFile()
+    {
+        close();
+    }
+
+#ifdef _WIN32
+
+    bool AssetFile::open(const String &file_name)
+    {
+        close();
+
+        HANDLE file = CreateFileW(file_name.c_str(), GENERIC_READ,
+            FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0 ||
+            (unsigned long long)file_size.QuadPart > SIZE_MAX) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0,
+            nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return false;
+        }
+
+        const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        m_data = data;
+        m_size = (size_t)file_size.QuadPart;
+        m_file_handle = file;
+        m_mapping_handle = mapping;
+        return true;
+    }
+
+    void AssetFile::close()
+    {
+        if (!m_data)
+            return;
+
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping_handle);
+        CloseHandle(m_file_handle);
+
+        m_data = nullptr;
+        m_size = 0;
+        m_file_handle = nullptr;
+        m_mapping_handle = nullptr;
+    }
+
+    bool AssetFile::write(const String &file_name, const void *data, size_t size)
+    {
+        HANDLE file = CreateFileW(file_name.c_str(), GENERIC_WRITE, 0, nullptr,
+            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        // WriteFile takes 32 bit sizes, so large blocks are written in pieces.
+        const char *bytes = static_cast<const char*>(data);
+        bool succeeded = true;
+        while (size > 0 && succeeded) {
+            const DWORD piece_size = (DWORD)std::min(size, (size_t)(1u << 30));
+            DWORD written_size = 0;
+            succeeded = WriteFile(file, bytes, piece_size, &written_size, nullptr) &&
+                written_size == piece_size;
+            bytes += piece_size;
+            size -= piece_size;
+        }
+
+        CloseHandle(file);
+        return succeeded;
+    }
+
+#else
+
+    bool AssetFile::open(const String &file_name)
+    {
+        close();
+
+        const int file = ::open(_toNarrowFileName(file_name).c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat file_status;
+        if (fstat(file, &file_status) != 0 || file_status.st_size <= 0) {
+            ::close(file);
+            return false;
+        }
+
+        void *data = mmap(nullptr, (size_t)file_status.st_size, PROT_READ,
+            MAP_PRIVATE, file, 0);
+        // The mapping stays valid after the file is closed.
+        ::close(file);
+        if (data == MAP_FAILED)
+            return false;
+
+        m_data = data;
+        m_size = (size_t)file_status.st_size;
+        return true;
+    }
+
+    void AssetFile::close()
+    {
+        if (!m_data)
+            return;
+
+        munmap(const_cast<void*>(m_data), m_size);
+
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    bool AssetFile::write(const String &file_name, const void *data, size_t size)
+    {
+        FILE *file = fopen(_toNarrowFileName(file_name).c_str(), "wb");
+        if (!file)
+            return false;
+
+        const bool succeeded = fwrite(data, 1, size, file) == size;
+        return fclose(file) == 0 && succeeded;
+    }
+
+#endif
+
+    AssetStream::AssetStream() noexcept
+        : m_is_open(false),
+          m_size(0),
+          m_file_handle(nullptr),
+          m_file_descriptor(-1)
+    {}
+
+    AssetStream::~AssetStream()
+    {
+        close();
+    }
+
+#ifdef _WIN32
+
+    bool AssetStream::open(const String &file_name)
+    {
+        close();
+
+        HANDLE file = CreateFileW(file_name.c_str(), GENERIC_READ,
+            FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) {
+            CloseHandle(file);
+            return false;
+        }
+
+        m_is_open = true;
+        m_size = (uint64_t)file_size.QuadPart;
+        m_file_handle = file;
+        return true;
+    }
+
+    void AssetStream::close()
+    {
+        if (!m_is_open)
+            return;
+
+        CloseHandle(m_file_handle);
+
+        m_is_open = false;
+        m_size = 0;
+        m_file_handle = nullptr;
+    }
+
+    bool AssetStream::read(uint64_t offset, void *buffer, size_t size) const
+    {
+        assert(m_is_open && "no file is open");
+
+        if (offset > m_size || size > m_size - offset)
+            return false;
+
+        // Each read carries its own offset so reads don't share a file
+        // position.
+        char *bytes = static_cast<char*>(buffer);
+        while (size > 0) {
+            const DWORD piece_size = (DWORD)std::min(size, (size_t)(1u << 30));
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD)offset;
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+            DWORD read_size = 0;
+            if (!ReadFile(m_file_handle, bytes, piece_size, &read_size, &overlapped) ||
+                read_size != piece_size)
+                return false;
+
+            bytes += piece_size;
+            offset += piece_size;
+            size -= piece_size;
+        }
+        return true;
+    }
+
+#else
+
+    bool AssetStream::open(const String &file_name)
+    {
+        close();
+
+        const int file = ::open(_toNarrowFileName(file_name).c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat file_status;
+        if (fstat(file, &file_status) != 0) {
+            ::close(file);
+            return false;
+        }
+
+        m_is_open = true;
+        m_size = (uint64_t)file_status.st_size;
+        m_file_descriptor = file;
+        return true;
+    }
+
+    void AssetStream::close()
+    {
+        if (!m_is_open)
+            return;
+
+        ::close(m_file_descriptor);
+
+        m_is_open = false;
+        m_size = 0;
+        m_file_descriptor = -1;
+    }
+
+    bool AssetStream::read(uint64_t offset, void *buffer, size_t size) const
+    {
+        assert(m_is_open && "no file is open");
+
+        if (offset > m_size || size > m_size - offset)
+            return false;
+
+        char *bytes = static_cast<char*>(buffer);
+        while (size > 0) {
+            const ssize_t read_size = pread(m_file_descriptor, bytes, size,
+                (off_t)offset);
+            if (read_size <= 0)
+                return false;
+
+            bytes += read_size;
+            offset += (uint64_t)read_size;
+            size -= (size_t)read_size;
+        }
+        return true;
+    }
+
+#endif
+
+};
\ No newline at end of file
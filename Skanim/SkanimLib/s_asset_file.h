@@ -0,0 +1,123 @@
+#pragma once
+
+#include "s_prerequisites.h"
+
+namespace Skanim
+{
+    /** Asset file maps a whole file into memory read-only. The mapped memory
+     *  starts at a page boundary, so binary assets could be used in place.
+     */
+    class _SKANIM_EXPORT AssetFile
+    {
+    public:
+        AssetFile() noexcept;
+
+        ~AssetFile();
+
+        AssetFile(const AssetFile &) = delete;
+
+        AssetFile &operator=(const AssetFile &) = delete;
+
+        /** Map a file into memory. A file mapped before is closed first.
+         *  Return false if the file can't be opened or mapped.
+         */
+        bool open(const String &file_name);
+
+        /** Unmap the file. Clips and skeletons which use the mapped memory
+         *  must not be used anymore.
+         */
+        void close();
+
+        /** Check if a file is mapped.
+         */
+        bool isOpen() const
+        {
+            return m_data != nullptr;
+        }
+
+        /** Get the mapped memory.
+         */
+        const void *getData() const
+        {
+            return m_data;
+        }
+
+        /** Get the size in bytes of the mapped memory.
+         */
+        size_t getSize() const
+        {
+            return m_size;
+        }
+
+        /** Write a block of memory to a file, which is created or truncated.
+         *  Return false if the file can't be written.
+         */
+        static bool write(const String &file_name, const void *data, size_t size);
+
+    private:
+        // The mapped memory.
+        const void *m_data;
+
+        // The size of the mapped memory.
+        size_t m_size;
+
+        // Platform handles of the file and the mapping.
+        void *m_file_handle;
+        void *m_mapping_handle;
+    };
+
+    /** Asset stream reads pieces of a file at arbitrary offsets, for assets
+     *  which are too large to be resident. Reads at different offsets could
+     *  be issued from different threads at the same time.
+     */
+    class _SKANIM_EXPORT AssetStream
+    {
+    public:
+        AssetStream() noexcept;
+
+        ~AssetStream();
+
+        AssetStream(const AssetStream &) = delete;
+
+        AssetStream &operator=(const AssetStream &) = delete;
+
+        /** Open a file for reading. A file opened before is closed first.
+         *  Return false if the file can't be opened.
+         */
+        bool open(const String &file_name);
+
+        /** Close the file.
+         */
+        void close();
+
+        /** Check if a file is open.
+         */
+        bool isOpen() const
+        {
+            return m_is_open;
+        }
+
+        /** Get the size in bytes of the file.
+         */
+        uint64_t getSize() const
+        {
+            return m_size;
+        }
+
+        /** Read size bytes at offset into buffer. Return false if they can't
+         *  all be read.
+         */
+        bool read(uint64_t offset, void *buffer, size_t size) const;
+
+    private:
+        // Indicate if a file is open.
+        bool m_is_open;
+
+        // The size of the file.
+        uint64_t m_size;
+
+        // The platform handle of the file.
+        void *m_file_handle;
+        int m_file_descriptor;
+    };
+};
\ No newline at end of file
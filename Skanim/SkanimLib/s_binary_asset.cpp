@@ -0,0 +1,492 @@
+#include "s_precomp.h"
+#include "s_binary_asset.h"
+#include "s_interleaved_animation_clip.h"
+#include "s_joint.h"
+#include "s_skeleton_definition.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // "SKAN" in a little endian word.
+        const uint32_t MAGIC = 0x4e414b53;
+
+        // Written in the native byte order, it tells the byte order apart.
+        const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        // The header of every asset.
+        struct AssetHeader
+        {
+            uint32_t magic;
+            uint16_t version;
+            uint16_t type;
+            uint32_t byte_order_mark;
+            uint8_t float_size;
+            uint8_t char_size;
+            uint16_t header_size;
+            // The size of the whole asset including the header.
+            uint64_t asset_size;
+            // FNV-1a hash of the bytes after the header.
+            uint32_t checksum;
+            uint32_t reserved;
+        };
+
+        // The body of an animation clip asset, which follows the header.
+        struct AnimationClipBody
+        {
+            uint64_t track_count;
+            uint64_t key_count;
+            int64_t key_pose_interval;
+            uint64_t name_offset;
+            uint64_t name_length;
+            uint64_t key_data_offset;
+        };
+
+        // The body of a skeleton asset, which follows the header.
+        struct SkeletonBody
+        {
+            uint64_t joint_count;
+            uint64_t parent_indices_offset;
+            uint64_t skinning_ids_offset;
+            uint64_t lcl_transforms_offset;
+            uint64_t inv_glb_binding_transforms_offset;
+            uint64_t name_spans_offset;
+            uint64_t names_offset;
+            uint64_t names_length;
+            uint64_t name_offset;
+            uint64_t name_length;
+        };
+
+        // The number of floats of a transform.
+        const size_t TRANSFORM_SIZE = 8;
+
+        uint32_t _checksum(const unsigned char *bytes, size_t size)
+        {
+            uint32_t hash = 2166136261u;
+            for (size_t i = 0; i < size; ++i) {
+                hash ^= bytes[i];
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        // Appends aligned blocks to an asset buffer.
+        class _AssetWriter
+        {
+        public:
+            explicit _AssetWriter(vector<unsigned char> *buffer)
+                : m_buffer(buffer)
+            {
+                m_buffer->clear();
+            }
+
+            // Append size bytes at the next aligned offset and return that
+            // offset.
+            uint64_t append(const void *data, size_t size)
+            {
+                const size_t offset = (m_buffer->size() + BinaryAsset::ALIGNMENT - 1) &
+                    ~(BinaryAsset::ALIGNMENT - 1);
+                m_buffer->resize(offset + size);
+                if (size > 0)
+                    std::memcpy(m_buffer->data() + offset, data, size);
+                return offset;
+            }
+
+            // Fill the header at the beginning of the buffer.
+            void finish(BinaryAsset::Type type)
+            {
+                AssetHeader *header = reinterpret_cast<AssetHeader*>(m_buffer->data());
+                header->magic = MAGIC;
+                header->version = BinaryAsset::VERSION;
+                header->type = (uint16_t)type;
+                header->byte_order_mark = BYTE_ORDER_MARK;
+                header->float_size = sizeof(float);
+                header->char_size = sizeof(String::value_type);
+                header->header_size = sizeof(AssetHeader);
+                header->asset_size = m_buffer->size();
+                header->checksum = _checksum(m_buffer->data() + sizeof(AssetHeader),
+                    m_buffer->size() - sizeof(AssetHeader));
+                header->reserved = 0;
+            }
+
+            unsigned char *at(uint64_t offset)
+            {
+                return m_buffer->data() + offset;
+            }
+
+        private:
+            vector<unsigned char> *m_buffer;
+        };
+
+        // Check that an array of count elements of element_size bytes at
+        // offset is inside an asset of asset_size bytes and is aligned.
+        bool _isArrayValid(uint64_t offset, uint64_t count, size_t element_size,
+            uint64_t asset_size)
+        {
+            if (offset % BinaryAsset::ALIGNMENT != 0 || offset > asset_size)
+                return false;
+            return count <= (asset_size - offset) / element_size;
+        }
+
+        template <typename T>
+        const T *_at(const void *data, uint64_t offset)
+        {
+            return reinterpret_cast<const T*>(static_cast<const unsigned char*>(data) +
+                offset);
+        }
+    }
+
+    void BinaryAsset::writeAnimationClip(const InterleavedAnimationClip &clip,
+        vector<unsigned char> *buffer)
+    {
+        _AssetWriter writer(buffer);
+        const AssetHeader header = {};
+        writer.append(&header, sizeof(header));
+
+        AnimationClipBody body = {};
+        const uint64_t body_offset = writer.append(&body, sizeof(body));
+
+        body.track_count = clip.getTrackCount();
+        body.key_count = clip.getKeyPoseCount();
+        body.key_pose_interval = clip.getKeyPoseInterval();
+        body.name_length = clip.getName().size();
+        body.name_offset = writer.append(clip.getName().data(),
+            clip.getName().size() * sizeof(String::value_type));
+        body.key_data_offset = writer.append(clip.getKeyData(),
+            clip.getKeyDataSize() * sizeof(float));
+
+        std::memcpy(writer.at(body_offset), &body, sizeof(body));
+        writer.finish(TYPE_ANIMATION_CLIP);
+    }
+
+    void BinaryAsset::writeSkeleton(const SkeletonDefinition &skeleton, const String &name,
+        vector<unsigned char> *buffer)
+    {
+        const size_t joint_count = skeleton.getJointCount();
+
+        // Gather the joints into arrays.
+        vector<int32_t> parent_indices(joint_count);
+        vector<int32_t> skinning_ids(joint_count);
+        vector<float> lcl_transforms(joint_count * TRANSFORM_SIZE);
+        vector<float> inv_glb_binding_transforms(joint_count * TRANSFORM_SIZE);
+        vector<uint32_t> name_spans(joint_count * 2);
+        String names;
+
+        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+            parent_indices[i_joint] = skeleton.getParentIndex(i_joint);
+            skinning_ids[i_joint] = skeleton.getSkinningId(i_joint);
+
+            const Transform *transforms[2] = {
+                &skeleton.getBindingLclTransform(i_joint),
+                &skeleton.getInvGlbBindingTransform(i_joint) };
+            float *components[2] = {
+                lcl_transforms.data() + i_joint * TRANSFORM_SIZE,
+                inv_glb_binding_transforms.data() + i_joint * TRANSFORM_SIZE };
+            for (int i = 0; i < 2; ++i) {
+                const Quaternion &rotation = transforms[i]->getRotation();
+                const Vector3 &translation = transforms[i]->getTranslation();
+                components[i][0] = rotation.getX();
+                components[i][1] = rotation.getY();
+                components[i][2] = rotation.getZ();
+                components[i][3] = rotation.getW();
+                components[i][4] = translation.getX();
+                components[i][5] = translation.getY();
+                components[i][6] = translation.getZ();
+                components[i][7] = transforms[i]->getScale();
+            }
+
+            name_spans[i_joint * 2] = (uint32_t)names.size();
+            const String &name = skeleton.getJointName(i_joint);
+            name_spans[i_joint * 2 + 1] = (uint32_t)name.size();
+            names += name;
+        }
+
+        _AssetWriter writer(buffer);
+        const AssetHeader header = {};
+        writer.append(&header, sizeof(header));
+
+        SkeletonBody body = {};
+        const uint64_t body_offset = writer.append(&body, sizeof(body));
+
+        body.joint_count = joint_count;
+        body.parent_indices_offset = writer.append(parent_indices.data(),
+            joint_count * sizeof(int32_t));
+        body.skinning_ids_offset = writer.append(skinning_ids.data(),
+            joint_count * sizeof(int32_t));
+        body.lcl_transforms_offset = writer.append(lcl_transforms.data(),
+            lcl_transforms.size() * sizeof(float));
+        body.inv_glb_binding_transforms_offset = writer.append(
+            inv_glb_binding_transforms.data(),
+            inv_glb_binding_transforms.size() * sizeof(float));
+        body.name_spans_offset = writer.append(name_spans.data(),
+            name_spans.size() * sizeof(uint32_t));
+        body.names_length = names.size();
+        body.names_offset = writer.append(names.data(),
+            names.size() * sizeof(String::value_type));
+        body.name_length = name.size();
+        body.name_offset = writer.append(name.data(),
+            name.size() * sizeof(String::value_type));
+
+        std::memcpy(writer.at(body_offset), &body, sizeof(body));
+        writer.finish(TYPE_SKELETON);
+    }
+
+    BinaryAsset::Status BinaryAsset::_readHeader(const void *data, size_t size,
+        Type type, bool is_whole, uint64_t *asset_size)
+    {
+        if ((uintptr_t)data % ALIGNMENT != 0)
+            return STATUS_MISALIGNED;
+        if (size < sizeof(AssetHeader))
+            return STATUS_TRUNCATED;
+
+        const AssetHeader *header = static_cast<const AssetHeader*>(data);
+        if (header->magic != MAGIC) {
+            // The magic number of an asset written in the other byte order.
+            if (header->magic == 0x534b414e)
+                return STATUS_INCOMPATIBLE_LAYOUT;
+            return STATUS_BAD_MAGIC;
+        }
+        if (header->byte_order_mark != BYTE_ORDER_MARK ||
+            header->float_size != sizeof(float) ||
+            header->char_size != sizeof(String::value_type))
+            return STATUS_INCOMPATIBLE_LAYOUT;
+        if (header->version != VERSION ||
+            header->header_size != sizeof(AssetHeader))
+            return STATUS_UNSUPPORTED_VERSION;
+        if (header->asset_size < sizeof(AssetHeader))
+            return STATUS_CORRUPTED;
+
+        // Only the beginning of an asset which is read in pieces is available,
+        // so its content can't be verified.
+        if (is_whole) {
+            if (header->asset_size > size)
+                return STATUS_TRUNCATED;
+
+            const unsigned char *bytes = static_cast<const unsigned char*>(data);
+            if (_checksum(bytes + sizeof(AssetHeader),
+                (size_t)header->asset_size - sizeof(AssetHeader)) != header->checksum)
+                return STATUS_CHECKSUM_MISMATCH;
+        }
+        if (header->type != type)
+            return STATUS_WRONG_TYPE;
+
+        *asset_size = header->asset_size;
+        return STATUS_OK;
+    }
+
+    BinaryAsset::Status BinaryAsset::readAnimationClip(const void *data,
+        size_t size, AnimationClipView *view)
+    {
+        uint64_t asset_size;
+        Status status = _readHeader(data, size, TYPE_ANIMATION_CLIP, true,
+            &asset_size);
+        if (status != STATUS_OK)
+            return status;
+
+        AnimationClipLayout layout;
+        status = _readAnimationClipBody(data, (size_t)asset_size, asset_size,
+            &layout);
+        if (status != STATUS_OK)
+            return status;
+
+        view->key_data = _at<float>(data, layout.key_data_offset);
+        view->track_count = layout.track_count;
+        view->key_count = layout.key_count;
+        view->key_pose_interval = layout.key_pose_interval;
+        view->name = layout.name;
+        view->name_length = layout.name_length;
+        return STATUS_OK;
+    }
+
+    BinaryAsset::Status BinaryAsset::readAnimationClipLayout(const void *head,
+        size_t head_size, uint64_t asset_size, AnimationClipLayout *layout)
+    {
+        uint64_t header_asset_size;
+        const Status status = _readHeader(head, head_size, TYPE_ANIMATION_CLIP,
+            false, &header_asset_size);
+        if (status != STATUS_OK)
+            return status;
+        if (header_asset_size > asset_size)
+            return STATUS_TRUNCATED;
+
+        return _readAnimationClipBody(head, std::min(head_size,
+            (size_t)header_asset_size), header_asset_size, layout);
+    }
+
+    BinaryAsset::Status BinaryAsset::_readAnimationClipBody(const void *data,
+        size_t size, uint64_t asset_size, AnimationClipLayout *layout)
+    {
+        const uint64_t body_offset = (sizeof(AssetHeader) + ALIGNMENT - 1) &
+            ~(uint64_t)(ALIGNMENT - 1);
+        if (!_isArrayValid(body_offset, 1, sizeof(AnimationClipBody), size))
+            return body_offset + sizeof(AnimationClipBody) > asset_size ?
+                STATUS_CORRUPTED : STATUS_TRUNCATED;
+        const AnimationClipBody *body = _at<AnimationClipBody>(data, body_offset);
+
+        // The body and the name must be in data, the key data could be out of
+        // it if only the beginning of the asset is given.
+        const uint64_t segment_size =
+            InterleavedAnimationClip::getSegmentSize(1) * body->track_count;
+        const uint64_t segment_count =
+            InterleavedAnimationClip::getSegmentCount((size_t)body->key_count);
+        if (body->track_count > asset_size || body->key_count > asset_size ||
+            body->key_pose_interval <= 0 ||
+            (segment_count > 0 && segment_size > asset_size / segment_count) ||
+            !_isArrayValid(body->name_offset, body->name_length,
+                sizeof(String::value_type), asset_size) ||
+            !_isArrayValid(body->key_data_offset, segment_size * segment_count,
+                sizeof(float), asset_size))
+            return STATUS_CORRUPTED;
+        if (!_isArrayValid(body->name_offset, body->name_length,
+            sizeof(String::value_type), size))
+            return STATUS_TRUNCATED;
+
+        layout->track_count = (size_t)body->track_count;
+        layout->key_count = (size_t)body->key_count;
+        layout->key_pose_interval = (long)body->key_pose_interval;
+        layout->key_data_offset = body->key_data_offset;
+        layout->name = _at<String::value_type>(data, body->name_offset);
+        layout->name_length = (size_t)body->name_length;
+        return STATUS_OK;
+    }
+
+    BinaryAsset::Status BinaryAsset::readSkeleton(const void *data, size_t size,
+        SkeletonView *view)
+    {
+        uint64_t asset_size;
+        const Status status = _readHeader(data, size, TYPE_SKELETON, true,
+            &asset_size);
+        if (status != STATUS_OK)
+            return status;
+
+        const uint64_t body_offset = (sizeof(AssetHeader) + ALIGNMENT - 1) &
+            ~(uint64_t)(ALIGNMENT - 1);
+        if (!_isArrayValid(body_offset, 1, sizeof(SkeletonBody), asset_size))
+            return STATUS_CORRUPTED;
+        const SkeletonBody *body = _at<SkeletonBody>(data, body_offset);
+
+        const uint64_t joint_count = body->joint_count;
+        if (joint_count > asset_size ||
+            !_isArrayValid(body->parent_indices_offset, joint_count,
+                sizeof(int32_t), asset_size) ||
+            !_isArrayValid(body->skinning_ids_offset, joint_count,
+                sizeof(int32_t), asset_size) ||
+            !_isArrayValid(body->lcl_transforms_offset, joint_count * TRANSFORM_SIZE,
+                sizeof(float), asset_size) ||
+            !_isArrayValid(body->inv_glb_binding_transforms_offset,
+                joint_count * TRANSFORM_SIZE, sizeof(float), asset_size) ||
+            !_isArrayValid(body->name_spans_offset, joint_count * 2,
+                sizeof(uint32_t), asset_size) ||
+            !_isArrayValid(body->names_offset, body->names_length,
+                sizeof(String::value_type), asset_size) ||
+            !_isArrayValid(body->name_offset, body->name_length,
+                sizeof(String::value_type), asset_size))
+            return STATUS_CORRUPTED;
+
+        // Joints must be in pre-order, every parent comes before its children.
+        const int32_t *parent_indices = _at<int32_t>(data, body->parent_indices_offset);
+        const int32_t *skinning_ids = _at<int32_t>(data, body->skinning_ids_offset);
+        const uint32_t *name_spans = _at<uint32_t>(data, body->name_spans_offset);
+        const String::value_type *names = _at<String::value_type>(data,
+            body->names_offset);
+        vector<JointId> joint_ids(joint_count);
+        size_t skinning_matrix_count = 0;
+        for (uint64_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+            const int32_t parent_index = parent_indices[i_joint];
+            if (i_joint == 0 ? parent_index != Joint::INDEX_NULL :
+                parent_index < 0 || (uint64_t)parent_index >= i_joint)
+                return STATUS_CORRUPTED;
+
+            const uint64_t name_begin = name_spans[i_joint * 2];
+            const uint64_t name_length = name_spans[i_joint * 2 + 1];
+            if (name_begin + name_length > body->names_length)
+                return STATUS_CORRUPTED;
+            joint_ids[i_joint] = JointId(names + name_begin, (size_t)name_length);
+
+            if (skinning_ids[i_joint] < Joint::SKINNING_ID_NULL)
+                return STATUS_CORRUPTED;
+            if (skinning_ids[i_joint] != Joint::SKINNING_ID_NULL)
+                ++skinning_matrix_count;
+        }
+
+        // The skinning ids of the non-dummy joints index the skinning matrix
+        // palette, so each of them must be in it and be used once.
+        vector<unsigned char> is_skinning_id_used(skinning_matrix_count, 0);
+        for (uint64_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+            const int32_t skinning_id = skinning_ids[i_joint];
+            if (skinning_id == Joint::SKINNING_ID_NULL)
+                continue;
+            if ((size_t)skinning_id >= skinning_matrix_count ||
+                is_skinning_id_used[skinning_id])
+                return STATUS_CORRUPTED;
+            is_skinning_id_used[skinning_id] = 1;
+        }
+
+        // Joint names and their ids must be unique in a skeleton.
+        std::sort(joint_ids.begin(), joint_ids.end(),
+            [](const JointId &a, const JointId &b) {
+            return a.getHash() < b.getHash();
+        });
+        if (std::adjacent_find(joint_ids.begin(), joint_ids.end()) != joint_ids.end())
+            return STATUS_CORRUPTED;
+
+        view->joint_count = (size_t)joint_count;
+        view->parent_indices = parent_indices;
+        view->skinning_ids = skinning_ids;
+        view->lcl_transforms = _at<float>(data, body->lcl_transforms_offset);
+        view->inv_glb_binding_transforms = _at<float>(data,
+            body->inv_glb_binding_transforms_offset);
+        view->name_spans = name_spans;
+        view->names = names;
+        view->name = _at<String::value_type>(data, body->name_offset);
+        view->name_length = (size_t)body->name_length;
+        return STATUS_OK;
+    }
+
+    SkeletonDefinition *BinaryAsset::createSkeletonDefinition(const SkeletonView &view)
+    {
+        SkeletonDefinition *definition = SkeletonDefinition::create();
+
+        for (size_t i_joint = 0; i_joint < view.joint_count; ++i_joint) {
+            Joint joint(view.getJointName(i_joint), view.skinning_ids[i_joint]);
+            joint.setLclTransform(view.getLclTransform(i_joint));
+            joint.setInvGlbBindingTransform(view.getInvGlbBindingTransform(i_joint));
+            if (!definition->addJointPreOrder(joint, view.parent_indices[i_joint])) {
+                definition->release();
+                return nullptr;
+            }
+        }
+
+        definition->freeze();
+        return definition;
+    }
+
+    const char *BinaryAsset::getStatusDescription(Status status)
+    {
+        switch (status) {
+        case STATUS_OK:
+            return "ok";
+        case STATUS_TRUNCATED:
+            return "the data is smaller than the asset";
+        case STATUS_BAD_MAGIC:
+            return "the data isn't a binary asset";
+        case STATUS_UNSUPPORTED_VERSION:
+            return "the asset was written by an unsupported format version";
+        case STATUS_INCOMPATIBLE_LAYOUT:
+            return "the byte order, float size or character size of the asset "
+                "differs from this machine";
+        case STATUS_MISALIGNED:
+            return "the asset isn't aligned";
+        case STATUS_CHECKSUM_MISMATCH:
+            return "the checksum doesn't match the content";
+        case STATUS_WRONG_TYPE:
+            return "the asset is of another type";
+        case STATUS_CORRUPTED:
+            return "an offset or a count in the asset is out of range";
+        case STATUS_IO_ERROR:
+            return "the file of the asset can't be opened or read";
+        }
+        return "unknown status";
+    }
+
+};
\ No newline at end of file
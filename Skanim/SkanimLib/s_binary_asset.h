@@ -0,0 +1,214 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_transform.h"
+
+namespace Skanim
+{
+    class InterleavedAnimationClip;
+
+    /** Binary asset is a file format for animation clips and skeletons which
+     *  is used in place, for example from a file mapped by AssetFile. All the
+     *  positions in an asset are offsets from its beginning so it could be
+     *  loaded at any address, and every array starts at a multiple of
+     *  ALIGNMENT bytes. Reading an asset only validates it and points views
+     *  into it, nothing is parsed or copied.
+     *
+     *  An asset begins with a header holding a magic number, the format
+     *  version, the asset type, a description of the memory layout of the
+     *  machine which wrote it and a checksum of everything after the header.
+     *  Assets are only read on machines with the same layout.
+     *
+     *  Assets are written offline by the tool which imports the clips and
+     *  skeletons: it builds them with the library, converts them with
+     *  writeAnimationClip() or writeSkeleton() and saves the buffer with
+     *  AssetFile::write().
+     */
+    class _SKANIM_EXPORT BinaryAsset
+    {
+    public:
+        /** Asset types.
+         */
+        enum Type
+        {
+            TYPE_ANIMATION_CLIP = 1,
+            TYPE_SKELETON = 2
+        };
+
+        /** Results of reading an asset.
+         */
+        enum Status
+        {
+            STATUS_OK,
+            // The data is smaller than the asset claims to be.
+            STATUS_TRUNCATED,
+            // The data isn't a binary asset.
+            STATUS_BAD_MAGIC,
+            // The asset was written by another version of the format.
+            STATUS_UNSUPPORTED_VERSION,
+            // The byte order, float size or character size differs.
+            STATUS_INCOMPATIBLE_LAYOUT,
+            // The data doesn't start at a multiple of ALIGNMENT bytes.
+            STATUS_MISALIGNED,
+            // The checksum doesn't match the content.
+            STATUS_CHECKSUM_MISMATCH,
+            // The asset isn't of the requested type.
+            STATUS_WRONG_TYPE,
+            // An offset or a count in the asset is out of range.
+            STATUS_CORRUPTED,
+            // The file of the asset can't be opened or read.
+            STATUS_IO_ERROR
+        };
+
+        /** The current version of the format.
+         */
+        static const uint16_t VERSION = 1;
+
+        /** The alignment of the asset and of every array in it.
+         */
+        static const size_t ALIGNMENT = 16;
+
+        /** An animation clip in an asset. The key data is in the layout of
+         *  InterleavedAnimationClip, which could be constructed on it directly:
+         *  InterleavedAnimationClip(key_data, track_count, key_count,
+         *  key_pose_interval, String(name, name_length)).
+         */
+        struct AnimationClipView
+        {
+            const float *key_data;
+            size_t track_count;
+            size_t key_count;
+            long key_pose_interval;
+            const String::value_type *name;
+            size_t name_length;
+        };
+
+        /** A skeleton in an asset. Joints are in pre-order. Transforms take
+         *  Pose::STREAM_COUNT floats each, in the order of Pose::Stream.
+         */
+        struct SkeletonView
+        {
+            size_t joint_count;
+            const int32_t *parent_indices;
+            const int32_t *skinning_ids;
+            const float *lcl_transforms;
+            const float *inv_glb_binding_transforms;
+            // The offset and the length of each joint's name in names.
+            const uint32_t *name_spans;
+            const String::value_type *names;
+            // The name of the skeleton.
+            const String::value_type *name;
+            size_t name_length;
+
+            /** Get the local transform of a joint.
+             */
+            Transform getLclTransform(size_t joint_index) const
+            {
+                assert(joint_index < joint_count && "joint index out of range");
+                return _toTransform(lcl_transforms + joint_index * _TRANSFORM_SIZE);
+            }
+
+            /** Get the inverse global binding transform of a joint.
+             */
+            Transform getInvGlbBindingTransform(size_t joint_index) const
+            {
+                assert(joint_index < joint_count && "joint index out of range");
+                return _toTransform(inv_glb_binding_transforms +
+                    joint_index * _TRANSFORM_SIZE);
+            }
+
+            /** Get the name of a joint.
+             */
+            String getJointName(size_t joint_index) const
+            {
+                assert(joint_index < joint_count && "joint index out of range");
+                const uint32_t *span = name_spans + joint_index * 2;
+                return String(names + span[0], span[1]);
+            }
+        };
+
+        /** Where the parts of an animation clip are in an asset, used to read
+         *  the key data in pieces instead of mapping the whole asset.
+         */
+        struct AnimationClipLayout
+        {
+            size_t track_count;
+            size_t key_count;
+            long key_pose_interval;
+            // The offset of the key data from the beginning of the asset.
+            uint64_t key_data_offset;
+            const String::value_type *name;
+            size_t name_length;
+        };
+
+        /** Write an animation clip as an asset into buffer, which is resized
+         *  to the size of the asset.
+         */
+        static void writeAnimationClip(const InterleavedAnimationClip &clip,
+            vector<unsigned char> *buffer);
+
+        /** Write a skeleton definition as an asset into buffer, which is
+         *  resized to the size of the asset.
+         */
+        static void writeSkeleton(const SkeletonDefinition &skeleton, const String &name,
+            vector<unsigned char> *buffer);
+
+        /** Validate an animation clip asset of size bytes and point view into
+         *  it. The view is only valid while data is.
+         */
+        static Status readAnimationClip(const void *data, size_t size,
+            AnimationClipView *view);
+
+        /** Validate the beginning of an animation clip asset of asset_size
+         *  bytes and find where the key data is. head holds the first
+         *  head_size bytes of the asset, which must contain the header and the
+         *  name. The checksum isn't verified since the content isn't read.
+         *  The name in layout points into head.
+         */
+        static Status readAnimationClipLayout(const void *head, size_t head_size,
+            uint64_t asset_size, AnimationClipLayout *layout);
+
+        /** Validate a skeleton asset of size bytes and point view into it.
+         *  Besides the layout, the joints must be in pre-order, their names
+         *  must have distinct ids and the skinning ids of the non-dummy joints
+         *  must be distinct and less than their count. The view is only valid
+         *  while data is.
+         */
+        static Status readSkeleton(const void *data, size_t size,
+            SkeletonView *view);
+
+        /** Create a frozen skeleton definition from a skeleton asset. The
+         *  caller holds a reference to it and has to release it. Return
+         *  nullptr if two joint names have the same id, which doesn't happen
+         *  with a view validated by readSkeleton().
+         */
+        static SkeletonDefinition *createSkeletonDefinition(const SkeletonView &view);
+
+        /** Get a readable description of a status.
+         */
+        static const char *getStatusDescription(Status status);
+
+    private:
+        // The number of floats of a transform.
+        static const size_t _TRANSFORM_SIZE = 8;
+
+        // Read a transform stored in the order of Pose::Stream.
+        static Transform _toTransform(const float *components)
+        {
+            return Transform(components[7],
+                Quaternion(components[3], components[0], components[1], components[2]),
+                Vector3(components[4], components[5], components[6]));
+        }
+
+        // Validate the header of an asset of the given type and return the
+        // size of the asset in asset_size. If is_whole is false data is only
+        // the beginning of the asset and the checksum isn't verified.
+        static Status _readHeader(const void *data, size_t size, Type type,
+            bool is_whole, uint64_t *asset_size);
+
+        // Validate the body of an animation clip asset of asset_size bytes,
+        // whose first size bytes are in data.
+        static Status _readAnimationClipBody(const void *data, size_t size,
+            uint64_t asset_size, AnimationClipLayout *layout);
+    };
+};
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "s_precomp.h"
+#include "s_blend_tree.h"
+#include "s_animation_state.h"
+#include "s_transform_batch.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // Blend the children by their weights into result. Children whose
+        // weights are zero are skipped. Each weighted child is interpolated
+        // into the running result by its share of the weights so far, which
+        // gives the normalized weighted average.
+        void _blendWeightedChildren(const vector<IBlendNode*> &children,
+            const vector<float> &weights, long elapsed_time, PosePool *pose_pool,
+            Pose *result)
+        {
+            Pose *child_pose = nullptr;
+            float total_weight = 0.0f;
+
+            for (size_t i_child = 0; i_child < children.size(); ++i_child) {
+                const float weight = weights[i_child];
+                if (weight <= 0.0f) {
+                    children[i_child]->skip(elapsed_time);
+                    continue;
+                }
+
+                if (total_weight == 0.0f) {
+                    children[i_child]->evaluate(elapsed_time, pose_pool, result);
+                }
+                else {
+                    if (!child_pose)
+                        child_pose = pose_pool->acquire(result->getJointCount());
+
+                    children[i_child]->evaluate(elapsed_time, pose_pool, child_pose);
+                    Pose::lerp(weight / (total_weight + weight), *result,
+                        *child_pose, result);
+                }
+                total_weight += weight;
+            }
+
+            if (child_pose)
+                pose_pool->release(child_pose);
+        }
+
+        void _skipChildren(const vector<IBlendNode*> &children, long elapsed_time)
+        {
+            for (IBlendNode *child : children)
+                child->skip(elapsed_time);
+        }
+    }
+
+    ClipBlendNode::ClipBlendNode(AnimationState *animation_state) noexcept
+        : m_animation_state(animation_state)
+    {
+        assert(animation_state && "animation state can't be nullptr");
+    }
+
+    void ClipBlendNode::evaluate(long elapsed_time, PosePool *pose_pool,
+        Pose *result)
+    {
+        m_animation_state->advanceTime(elapsed_time, result);
+    }
+
+    void ClipBlendNode::skip(long elapsed_time)
+    {
+        m_animation_state->advanceTime(elapsed_time, nullptr);
+    }
+
+    LerpBlendNode::LerpBlendNode(IBlendNode *a, IBlendNode *b, float weight) noexcept
+        : m_a(a),
+          m_b(b),
+          m_weight(Math::clamp01(weight))
+    {
+        assert(a && b && "child node can't be nullptr");
+    }
+
+    void LerpBlendNode::evaluate(long elapsed_time, PosePool *pose_pool,
+        Pose *result)
+    {
+        if (m_weight <= 0.0f) {
+            m_a->evaluate(elapsed_time, pose_pool, result);
+            m_b->skip(elapsed_time);
+        }
+        else if (m_weight >= 1.0f) {
+            m_a->skip(elapsed_time);
+            m_b->evaluate(elapsed_time, pose_pool, result);
+        }
+        else {
+            m_a->evaluate(elapsed_time, pose_pool, result);
+
+            Pose *b_pose = pose_pool->acquire(result->getJointCount());
+            m_b->evaluate(elapsed_time, pose_pool, b_pose);
+            Pose::lerp(m_weight, *result, *b_pose, result);
+            pose_pool->release(b_pose);
+        }
+    }
+
+    void LerpBlendNode::skip(long elapsed_time)
+    {
+        m_a->skip(elapsed_time);
+        m_b->skip(elapsed_time);
+    }
+
+    AdditiveBlendNode::AdditiveBlendNode(IBlendNode *base, IBlendNode *additive,
+        float weight) noexcept
+        : m_base(base),
+          m_additive(additive),
+          m_weight(Math::clamp01(weight))
+    {
+        assert(base && additive && "child node can't be nullptr");
+    }
+
+    void AdditiveBlendNode::evaluate(long elapsed_time, PosePool *pose_pool,
+        Pose *result)
+    {
+        m_base->evaluate(elapsed_time, pose_pool, result);
+
+        if (m_weight <= 0.0f) {
+            m_additive->skip(elapsed_time);
+            return;
+        }
+
+        const size_t joint_count = result->getJointCount();
+        Pose *additive_pose = pose_pool->acquire(joint_count);
+        m_additive->evaluate(elapsed_time, pose_pool, additive_pose);
+
+        assert(additive_pose->getJointCount() == joint_count &&
+            "joint count differs");
+
+        // Scale the additive pose by interpolating it from identity.
+        if (m_weight < 1.0f) {
+            Pose *identity_pose = pose_pool->acquire(joint_count);
+            identity_pose->setIdentity();
+            Pose::lerp(m_weight, *identity_pose, *additive_pose, additive_pose);
+            pose_pool->release(identity_pose);
+        }
+
+        TransformBatch::ConstStreams additive, base;
+        TransformBatch::Streams combined;
+        for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+            additive.streams[i_stream] = additive_pose->getStream((Pose::Stream)i_stream);
+            base.streams[i_stream] = result->getStream((Pose::Stream)i_stream);
+            combined.streams[i_stream] = result->getStream((Pose::Stream)i_stream);
+        }
+        TransformBatch::combine(joint_count, additive, base, combined);
+
+        pose_pool->release(additive_pose);
+    }
+
+    void AdditiveBlendNode::skip(long elapsed_time)
+    {
+        m_base->skip(elapsed_time);
+        m_additive->skip(elapsed_time);
+    }
+
+    BlendSpace1DNode::BlendSpace1DNode() noexcept
+        : m_parameter(0.0f)
+    {}
+
+    void BlendSpace1DNode::evaluate(long elapsed_time, PosePool *pose_pool,
+        Pose *result)
+    {
+        assert(m_children.empty() == false && "blend space has no child");
+
+        _updateWeights();
+        _blendWeightedChildren(m_children, m_weights, elapsed_time, pose_pool,
+            result);
+    }
+
+    void BlendSpace1DNode::skip(long elapsed_time)
+    {
+        _skipChildren(m_children, elapsed_time);
+    }
+
+    void BlendSpace1DNode::addChild(IBlendNode *child, float position)
+    {
+        assert(child && "child node can't be nullptr");
+
+        // Insert after the children at the same position.
+        const size_t index = std::upper_bound(m_positions.begin(),
+            m_positions.end(), position) - m_positions.begin();
+
+        m_children.insert(m_children.begin() + index, child);
+        m_positions.insert(m_positions.begin() + index, position);
+        m_weights.resize(m_children.size());
+    }
+
+    void BlendSpace1DNode::_updateWeights()
+    {
+        std::fill(m_weights.begin(), m_weights.end(), 0.0f);
+
+        const size_t last = m_children.size() - 1;
+        if (m_parameter <= m_positions.front()) {
+            m_weights.front() = 1.0f;
+        }
+        else if (m_parameter >= m_positions.back()) {
+            m_weights.back() = 1.0f;
+        }
+        else {
+            // Find the segment which contains the parameter.
+            size_t i_right = std::upper_bound(m_positions.begin(),
+                m_positions.end(), m_parameter) - m_positions.begin();
+            i_right = std::min(i_right, last);
+            const size_t i_left = i_right - 1;
+
+            const float t = (m_parameter - m_positions[i_left]) /
+                (m_positions[i_right] - m_positions[i_left]);
+            m_weights[i_left] = 1.0f - t;
+            m_weights[i_right] = t;
+        }
+    }
+
+    BlendSpace2DNode::BlendSpace2DNode() noexcept
+        : m_parameter_x(0.0f),
+          m_parameter_y(0.0f)
+    {}
+
+    void BlendSpace2DNode::evaluate(long elapsed_time, PosePool *pose_pool,
+        Pose *result)
+    {
+        assert(m_children.empty() == false && "blend space has no child");
+
+        _updateWeights();
+        _blendWeightedChildren(m_children, m_weights, elapsed_time, pose_pool,
+            result);
+    }
+
+    void BlendSpace2DNode::skip(long elapsed_time)
+    {
+        _skipChildren(m_children, elapsed_time);
+    }
+
+    void BlendSpace2DNode::addChild(IBlendNode *child, float x, float y)
+    {
+        assert(child && "child node can't be nullptr");
+
+        m_children.push_back(child);
+        m_positions_x.push_back(x);
+        m_positions_y.push_back(y);
+        m_weights.resize(m_children.size());
+    }
+
+    void BlendSpace2DNode::_updateWeights()
+    {
+        // Gradient band interpolation. Each pair of children splits the plane
+        // with a band between them, and a child's weight is the smallest of
+        // its influences in all the bands it's in.
+        const size_t child_count = m_children.size();
+        float total_weight = 0.0f;
+        size_t i_nearest = 0;
+        float nearest_distance = FLT_MAX;
+
+        for (size_t i = 0; i < child_count; ++i) {
+            const float px = m_parameter_x - m_positions_x[i];
+            const float py = m_parameter_y - m_positions_y[i];
+
+            float weight = 1.0f;
+            for (size_t j = 0; j < child_count && weight > 0.0f; ++j) {
+                if (j == i)
+                    continue;
+
+                const float dx = m_positions_x[j] - m_positions_x[i];
+                const float dy = m_positions_y[j] - m_positions_y[i];
+                const float square_length = dx * dx + dy * dy;
+                if (square_length <= 0.0f)
+                    continue;
+
+                weight = std::min(weight,
+                    Math::clamp01(1.0f - (px * dx + py * dy) / square_length));
+            }
+
+            m_weights[i] = weight;
+            total_weight += weight;
+
+            const float distance = px * px + py * py;
+            if (distance < nearest_distance) {
+                nearest_distance = distance;
+                i_nearest = i;
+            }
+        }
+
+        // Make sure some child is played even if the bands leave no weight.
+        if (total_weight <= 0.0f)
+            m_weights[i_nearest] = 1.0f;
+    }
+
+    MaskBlendNode::MaskBlendNode(IBlendNode *base, IBlendNode *overlay,
+        const vector<float> &joint_weights, float weight) noexcept
+        : m_base(base),
+          m_overlay(overlay),
+          m_joint_weights(joint_weights),
+          m_joint_factors(joint_weights.size()),
+          m_weight(Math::clamp01(weight))
+    {
+        assert(base && overlay && "child node can't be nullptr");
+
+        for (auto &joint_weight : m_joint_weights)
+            joint_weight = Math::clamp01(joint_weight);
+
+        _updateJointRanges();
+    }
+
+    void MaskBlendNode::evaluate(long elapsed_time, PosePool *pose_pool,
+        Pose *result)
+    {
+        m_base->evaluate(elapsed_time, pose_pool, result);
+
+        if (m_weight <= 0.0f || m_joint_ranges.empty()) {
+            m_overlay->skip(elapsed_time);
+            return;
+        }
+
+        const size_t joint_count = result->getJointCount();
+        assert(joint_count == m_joint_weights.size() &&
+            "the mask doesn't match the pose");
+
+        Pose *overlay_pose = pose_pool->acquire(joint_count);
+        m_overlay->evaluate(elapsed_time, pose_pool, overlay_pose);
+
+        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint)
+            m_joint_factors[i_joint] = m_joint_weights[i_joint] * m_weight;
+        Pose::lerp(m_joint_factors.data(), *result, *overlay_pose, result);
+
+        pose_pool->release(overlay_pose);
+    }
+
+    void MaskBlendNode::skip(long elapsed_time)
+    {
+        m_base->skip(elapsed_time);
+        m_overlay->skip(elapsed_time);
+    }
+
+    void MaskBlendNode::setJointWeight(size_t joint_index, float weight)
+    {
+        assert(joint_index < m_joint_weights.size() && "joint index out of range");
+
+        m_joint_weights[joint_index] = Math::clamp01(weight);
+
+        _updateJointRanges();
+    }
+
+    void MaskBlendNode::_updateJointRanges()
+    {
+        m_joint_ranges.clear();
+
+        const size_t joint_count = m_joint_weights.size();
+        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+            if (m_joint_weights[i_joint] <= 0.0f)
+                continue;
+
+            // Extend the last range if the joint follows it.
+            if (!m_joint_ranges.empty() && m_joint_ranges.back().end == i_joint) {
+                m_joint_ranges.back().end = i_joint + 1;
+            }
+            else {
+                const JointRange range = { i_joint, i_joint + 1 };
+                m_joint_ranges.push_back(range);
+            }
+        }
+    }
+
+    BlendTree::BlendTree(IBlendNode *root) noexcept
+        : m_root(root)
+    {}
+
+    void BlendTree::update(long elapsed_time, Pose *result)
+    {
+        assert(m_root && "blend tree has no root");
+
+        m_root->evaluate(elapsed_time, &m_pose_pool, result);
+    }
+
+};
\ No newline at end of file
@@ -0,0 +1,379 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_pose.h"
+#include "s_pose_pool.h"
+
+namespace Skanim
+{
+    class AnimationState;
+
+    /** A node of a blend tree. A node produces a local pose, either by playing
+     *  an animation state or by blending the poses of its child nodes. Nodes
+     *  don't own their children.
+     */
+    class _SKANIM_EXPORT IBlendNode
+    {
+    public:
+        virtual ~IBlendNode() = 0
+        {}
+
+        /** Advance the time of this node and its children and evaluate the
+         *  blended pose into result. Scratch poses are taken from pose_pool.
+         */
+        virtual void evaluate(long elapsed_time, PosePool *pose_pool,
+            Pose *result) = 0;
+
+        /** Advance the time of this node and its children without sampling
+         *  any animation clip. Parents call this instead of evaluate() when the
+         *  node's weight is zero, so time stays in sync while it's not blended.
+         */
+        virtual void skip(long elapsed_time) = 0;
+    };
+
+    /** A leaf node which plays an animation state.
+     */
+    class _SKANIM_EXPORT ClipBlendNode : public IBlendNode
+    {
+    public:
+        explicit ClipBlendNode(AnimationState *animation_state) noexcept;
+
+        virtual void evaluate(long elapsed_time, PosePool *pose_pool,
+            Pose *result) override;
+
+        virtual void skip(long elapsed_time) override;
+
+        /** Get the animation state played by this node.
+         */
+        AnimationState *getAnimationState() const
+        {
+            return m_animation_state;
+        }
+
+        /** Modify the animation state played by this node.
+         */
+        void setAnimationState(AnimationState *animation_state)
+        {
+            assert(animation_state && "animation state can't be nullptr");
+            m_animation_state = animation_state;
+        }
+
+    private:
+        // The animation state played by this node.
+        AnimationState *m_animation_state;
+    };
+
+    /** Linearly interpolate between two child nodes. The weight is the
+     *  factor of the second child. A child whose weight is zero is skipped.
+     */
+    class _SKANIM_EXPORT LerpBlendNode : public IBlendNode
+    {
+    public:
+        LerpBlendNode(IBlendNode *a, IBlendNode *b, float weight = 0.0f) noexcept;
+
+        virtual void evaluate(long elapsed_time, PosePool *pose_pool,
+            Pose *result) override;
+
+        virtual void skip(long elapsed_time) override;
+
+        /** Get the weight of the second child.
+         */
+        float getWeight() const
+        {
+            return m_weight;
+        }
+
+        /** Modify the weight of the second child, which is clamped to [0, 1].
+         */
+        void setWeight(float weight)
+        {
+            m_weight = Math::clamp01(weight);
+        }
+
+    private:
+        // The two children.
+        IBlendNode *m_a;
+        IBlendNode *m_b;
+
+        // The weight of the second child.
+        float m_weight;
+    };
+
+    /** Add the pose of an additive child on top of the pose of a base child.
+     *  Additive poses hold per-joint differences, each of which is applied in
+     *  its joint's space before the base transform, the same as
+     *  Transform::combine(additive, base). The weight scales the additive
+     *  pose from identity, and the additive child is skipped if it's zero.
+     */
+    class _SKANIM_EXPORT AdditiveBlendNode : public IBlendNode
+    {
+    public:
+        AdditiveBlendNode(IBlendNode *base, IBlendNode *additive,
+            float weight = 1.0f) noexcept;
+
+        virtual void evaluate(long elapsed_time, PosePool *pose_pool,
+            Pose *result) override;
+
+        virtual void skip(long elapsed_time) override;
+
+        /** Get the weight of the additive child.
+         */
+        float getWeight() const
+        {
+            return m_weight;
+        }
+
+        /** Modify the weight of the additive child, which is clamped to
+         *  [0, 1].
+         */
+        void setWeight(float weight)
+        {
+            m_weight = Math::clamp01(weight);
+        }
+
+    private:
+        // The base child and the additive child.
+        IBlendNode *m_base;
+        IBlendNode *m_additive;
+
+        // The weight of the additive child.
+        float m_weight;
+    };
+
+    /** Blend the children placed on a line by a parameter. The two children
+     *  around the parameter are interpolated, all others are skipped.
+     */
+    class _SKANIM_EXPORT BlendSpace1DNode : public IBlendNode
+    {
+    public:
+        BlendSpace1DNode() noexcept;
+
+        virtual void evaluate(long elapsed_time, PosePool *pose_pool,
+            Pose *result) override;
+
+        virtual void skip(long elapsed_time) override;
+
+        /** Place a child at the given position. Children are kept sorted by
+         *  their positions.
+         */
+        void addChild(IBlendNode *child, float position);
+
+        /** Get the number of children.
+         */
+        size_t getChildCount() const
+        {
+            return m_children.size();
+        }
+
+        /** Get the blend parameter.
+         */
+        float getParameter() const
+        {
+            return m_parameter;
+        }
+
+        /** Modify the blend parameter. Parameters out of the range of the
+         *  children's positions are clamped.
+         */
+        void setParameter(float parameter)
+        {
+            m_parameter = parameter;
+        }
+
+    private:
+        // Calculate the weight of each child from the parameter.
+        void _updateWeights();
+
+    private:
+        // The children, their positions and their weights in the last
+        // evaluation.
+        vector<IBlendNode*> m_children;
+        vector<float> m_positions;
+        vector<float> m_weights;
+
+        // The blend parameter.
+        float m_parameter;
+    };
+
+    /** Blend the children placed on a plane by a 2D parameter. The weights are
+     *  calculated by gradient band interpolation, so only children near the
+     *  parameter get weights and the others are skipped.
+     */
+    class _SKANIM_EXPORT BlendSpace2DNode : public IBlendNode
+    {
+    public:
+        BlendSpace2DNode() noexcept;
+
+        virtual void evaluate(long elapsed_time, PosePool *pose_pool,
+            Pose *result) override;
+
+        virtual void skip(long elapsed_time) override;
+
+        /** Place a child at the given position.
+         */
+        void addChild(IBlendNode *child, float x, float y);
+
+        /** Get the number of children.
+         */
+        size_t getChildCount() const
+        {
+            return m_children.size();
+        }
+
+        /** Get the x component of the blend parameter.
+         */
+        float getParameterX() const
+        {
+            return m_parameter_x;
+        }
+
+        /** Get the y component of the blend parameter.
+         */
+        float getParameterY() const
+        {
+            return m_parameter_y;
+        }
+
+        /** Modify the blend parameter.
+         */
+        void setParameter(float x, float y)
+        {
+            m_parameter_x = x;
+            m_parameter_y = y;
+        }
+
+    private:
+        // Calculate the weight of each child from the parameter.
+        void _updateWeights();
+
+    private:
+        // The children, their positions and their weights in the last
+        // evaluation.
+        vector<IBlendNode*> m_children;
+        vector<float> m_positions_x;
+        vector<float> m_positions_y;
+        vector<float> m_weights;
+
+        // The blend parameter.
+        float m_parameter_x;
+        float m_parameter_y;
+    };
+
+    /** Blend an overlay child over a base child with a weight per joint, for
+     *  example to play an upper body animation over a locomotion. The factor
+     *  of each joint is its mask weight multiplied by the node's weight. The
+     *  overlay child is skipped if no joint has a factor above zero.
+     */
+    class _SKANIM_EXPORT MaskBlendNode : public IBlendNode
+    {
+    public:
+        /** Construct a mask node. joint_weights holds a weight in [0, 1] per
+         *  joint and its size must be the joint count of the children's poses.
+         */
+        MaskBlendNode(IBlendNode *base, IBlendNode *overlay,
+            const vector<float> &joint_weights, float weight = 1.0f) noexcept;
+
+        virtual void evaluate(long elapsed_time, PosePool *pose_pool,
+            Pose *result) override;
+
+        virtual void skip(long elapsed_time) override;
+
+        /** Get the weight of a joint in the mask.
+         */
+        float getJointWeight(size_t joint_index) const
+        {
+            assert(joint_index < m_joint_weights.size() && "joint index out of range");
+            return m_joint_weights[joint_index];
+        }
+
+        /** Modify the weight of a joint in the mask.
+         */
+        void setJointWeight(size_t joint_index, float weight);
+
+        /** Get the ranges of the joints whose weights are above zero. They
+         *  could be given to AnimationState::setJointRanges() of the states
+         *  played by the overlay child, so only the masked joints are sampled.
+         */
+        const vector<JointRange> &getJointRanges() const
+        {
+            return m_joint_ranges;
+        }
+
+        /** Get the weight of the overlay child.
+         */
+        float getWeight() const
+        {
+            return m_weight;
+        }
+
+        /** Modify the weight of the overlay child, which is clamped to [0, 1].
+         */
+        void setWeight(float weight)
+        {
+            m_weight = Math::clamp01(weight);
+        }
+
+    private:
+        // Rebuild the ranges of the joints whose weights are above zero.
+        void _updateJointRanges();
+
+    private:
+        // The base child and the overlay child.
+        IBlendNode *m_base;
+        IBlendNode *m_overlay;
+
+        // The weight of each joint in the mask.
+        vector<float> m_joint_weights;
+        // The ranges of the joints whose weights are above zero.
+        vector<JointRange> m_joint_ranges;
+        // The interpolation factor of each joint.
+        vector<float> m_joint_factors;
+
+        // The weight of the overlay child.
+        float m_weight;
+    };
+
+    /** A blend tree evaluates a graph of blend nodes into one local pose,
+     *  which could be given to Skeleton::setPose(). Intermediate poses come
+     *  from the tree's pose pool, so after the first evaluation a graph of
+     *  the same shape is evaluated without any heap allocation.
+     */
+    class _SKANIM_EXPORT BlendTree
+    {
+    public:
+        explicit BlendTree(IBlendNode *root = nullptr) noexcept;
+
+        /** Get the root node.
+         */
+        IBlendNode *getRoot() const
+        {
+            return m_root;
+        }
+
+        /** Modify the root node.
+         */
+        void setRoot(IBlendNode *root)
+        {
+            m_root = root;
+        }
+
+        /** Advance the time of all the nodes and evaluate the root node into
+         *  result.
+         */
+        void update(long elapsed_time, Pose *result);
+
+        /** Get the pool which provides the intermediate poses.
+         */
+        PosePool &getPosePool()
+        {
+            return m_pose_pool;
+        }
+
+    private:
+        // The root node.
+        IBlendNode *m_root;
+
+        // The pool of intermediate poses.
+        PosePool m_pose_pool;
+    };
+};
\ No newline at end of file
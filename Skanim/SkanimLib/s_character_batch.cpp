@@ -0,0 +1,146 @@
+#include "s_precomp.h"
+#include "s_character_batch.h"
+#include "s_animation_state.h"
+#include "s_ianimation_clip.h"
+#include "s_job_system.h"
+#include "s_skeleton.h"
+#include "s_skeleton_definition.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // The number of characters a job updates at least. A character takes a
+        // few microseconds per stage, which is much longer than scheduling a
+        // job, so the ranges could be small.
+        const size_t CHARACTER_GRAIN_SIZE = 4;
+    }
+
+    CharacterBatch::CharacterBatch(size_t arena_capacity,
+        JobSystem *job_system) noexcept
+        : m_frame_arena(arena_capacity),
+          m_job_system(job_system)
+    {}
+
+    size_t CharacterBatch::getPaletteSize(const Character *characters,
+        size_t count)
+    {
+        size_t palette_size = 0;
+        for (size_t i_character = 0; i_character < count; ++i_character)
+            palette_size += characters[i_character].skeleton->getSkinningMatrixCount();
+        return palette_size;
+    }
+
+    void CharacterBatch::update(long elapsed_time, const Character *characters,
+        size_t count, MatrixUA4 *palettes, size_t *palette_offsets)
+    {
+        m_frame_arena.reset();
+
+        // Lay out the scratch poses in the arena one after another, so the
+        // stages below walk through memory linearly. The arena isn't thread
+        // safe, so this is done before the stages run in parallel. The palette
+        // offsets are needed up front for the same reason.
+        Pose *poses = m_frame_arena.allocateArray<Pose>(count);
+        long *elapsed_times = m_frame_arena.allocateArray<long>(count);
+        unsigned char *is_updated = m_frame_arena.allocateArray<unsigned char>(count);
+        if (!palette_offsets)
+            palette_offsets = m_frame_arena.allocateArray<size_t>(count);
+
+        size_t palette_offset = 0;
+        for (size_t i_character = 0; i_character < count; ++i_character) {
+            const Character &character = characters[i_character];
+            assert(character.animation_state && character.skeleton &&
+                "character isn't complete");
+            assert(character.animation_state->getAnimationClip() &&
+                "no animation clip");
+
+            palette_offsets[i_character] = palette_offset;
+            palette_offset += character.skeleton->getSkinningMatrixCount();
+
+            // Throttle the characters with a level of detail state.
+            elapsed_times[i_character] = elapsed_time;
+            is_updated[i_character] = _updateLodState(character, elapsed_time,
+                elapsed_times + i_character);
+            if (!is_updated[i_character])
+                continue;
+
+            new (poses + i_character) Pose(character.animation_state->
+                getAnimationClip()->getTrackCount(), &m_frame_arena);
+        }
+
+        // Sample all the animation clips.
+        _forEachCharacter(count, [&](size_t begin, size_t end) {
+            for (size_t i_character = begin; i_character < end; ++i_character) {
+                if (is_updated[i_character]) {
+                    characters[i_character].animation_state->advanceTime(
+                        elapsed_times[i_character], poses + i_character);
+                }
+            }
+        });
+
+        // Pose all the skeletons, which propagates the local transforms to
+        // global transforms.
+        _forEachCharacter(count, [&](size_t begin, size_t end) {
+            for (size_t i_character = begin; i_character < end; ++i_character) {
+                if (is_updated[i_character])
+                    characters[i_character].skeleton->setPose(poses[i_character]);
+            }
+        });
+
+        // Generate the palettes into the contiguous output buffer.
+        _forEachCharacter(count, [&](size_t begin, size_t end) {
+            for (size_t i_character = begin; i_character < end; ++i_character) {
+                if (is_updated[i_character]) {
+                    characters[i_character].skeleton->writeSkinningMatricesPalette(
+                        palettes + palette_offsets[i_character]);
+                }
+            }
+        });
+
+        // Poses only own memory if a clip has grown them beyond the arena.
+        for (size_t i_character = 0; i_character < count; ++i_character) {
+            if (is_updated[i_character])
+                poses[i_character].~Pose();
+        }
+    }
+
+    bool CharacterBatch::_updateLodState(const Character &character,
+        long elapsed_time, long *update_elapsed_time)
+    {
+        LodState *lod_state = character.lod_state;
+        if (!lod_state)
+            return true;
+
+        // A skipped update only accumulates the time, so the root motion
+        // isn't lost.
+        lod_state->pending_time += elapsed_time;
+        if (lod_state->frames_to_skip > 0) {
+            --lod_state->frames_to_skip;
+            return false;
+        }
+
+        // Extract only the joints which are animated at the level.
+        const SkeletonDefinition *definition = character.skeleton->getDefinition();
+        const size_t level = character.skeleton->getLodLevel();
+        if (level != lod_state->level) {
+            character.animation_state->setJointRanges(
+                definition->getLodJointRanges(level));
+            lod_state->level = level;
+        }
+
+        lod_state->frames_to_skip = definition->getLodUpdateInterval(level) - 1;
+        *update_elapsed_time = lod_state->pending_time;
+        lod_state->pending_time = 0;
+        return true;
+    }
+
+    template <typename F>
+    void CharacterBatch::_forEachCharacter(size_t count, const F &function)
+    {
+        if (m_job_system)
+            m_job_system->parallelFor(count, CHARACTER_GRAIN_SIZE, function);
+        else
+            function(0, count);
+    }
+
+};
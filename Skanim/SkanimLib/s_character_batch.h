@@ -0,0 +1,148 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_frame_arena.h"
+
+namespace Skanim
+{
+    class AnimationState;
+    class JobSystem;
+
+    /** Character batch updates many characters as one pipeline. Instead of
+     *  advancing, posing and skinning each character in turn, every stage runs
+     *  over all the characters before the next one starts, so each loop only
+     *  touches the data of a single stage. Scratch poses are handed out from a
+     *  frame arena and all the palettes are written into one contiguous buffer
+     *  which could be uploaded to the GPU at once.
+     *  Characters with a level of detail state are throttled: a character is
+     *  only updated every few frames as its skeleton's level of detail
+     *  defines, and only the joints animated at that level are extracted.
+     */
+    class _SKANIM_EXPORT CharacterBatch
+    {
+    public:
+        /** The level of detail state of a character, which persists between
+         *  updates.
+         */
+        struct LodState
+        {
+            LodState() noexcept
+                : frames_to_skip(0),
+                  pending_time(0),
+                  level(0)
+            {}
+
+            /** The number of updates the character skips before it's updated
+             *  again. Give characters at the same level different initial
+             *  values to spread their updates across frames.
+             */
+            unsigned int frames_to_skip;
+
+            /** The time elapsed in the skipped updates, which the character
+             *  advances by in its next update.
+             */
+            long pending_time;
+
+            /** The level of detail which the animation state's joint ranges
+             *  are set for.
+             */
+            size_t level;
+        };
+
+        /** A character is an animation state which drives a skeleton. A
+         *  character without a level of detail state is updated every frame.
+         */
+        struct Character
+        {
+            Character() noexcept
+                : animation_state(nullptr),
+                  skeleton(nullptr),
+                  lod_state(nullptr)
+            {}
+
+            Character(AnimationState *animation_state, Skeleton *skeleton,
+                LodState *lod_state = nullptr) noexcept
+                : animation_state(animation_state),
+                  skeleton(skeleton),
+                  lod_state(lod_state)
+            {}
+
+            AnimationState *animation_state;
+            Skeleton *skeleton;
+            LodState *lod_state;
+        };
+
+        /** Construct a character batch.
+         *  @param arena_capacity The initial capacity of the frame arena in
+         *  bytes. The arena grows to fit a frame if it's too small.
+         *  @param job_system If it's not nullptr, the characters of every stage
+         *  are spread across the job system's workers.
+         */
+        explicit CharacterBatch(size_t arena_capacity = 0,
+            JobSystem *job_system = nullptr) noexcept;
+
+        /** Get the total number of skinning matrices of the characters, which
+         *  is the size of the palette buffer update() needs.
+         */
+        static size_t getPaletteSize(const Character *characters, size_t count);
+
+        /** Update count characters. Each animation state advances its time and
+         *  extracts its pose into a scratch pose, which is then set to its
+         *  skeleton. The animation states' own current poses aren't updated.
+         *  The joint ranges of the animation states of characters with a level
+         *  of detail state are set to the joints animated at their skeletons'
+         *  levels.
+         *  @param palettes The buffer which receives all the skinning matrices
+         *  palettes one after another, in the order of the characters. It must
+         *  hold getPaletteSize() matrices. The palettes of characters which
+         *  skip this update aren't written and hold their last matrices, so
+         *  the same buffer should be given in every update.
+         *  @param palette_offsets If it's not nullptr, it receives the index of
+         *  each character's first skinning matrix in palettes.
+         */
+        void update(long elapsed_time, const Character *characters, size_t count,
+            MatrixUA4 *palettes, size_t *palette_offsets = nullptr);
+
+        /** Get the frame arena which holds the scratch data of an update. It's
+         *  reset at the beginning of every update.
+         */
+        FrameArena &getFrameArena()
+        {
+            return m_frame_arena;
+        }
+
+        /** Get the job system used by this batch.
+         */
+        JobSystem *getJobSystem() const
+        {
+            return m_job_system;
+        }
+
+        /** Modify the job system used by this batch. Set it to nullptr to
+         *  update all the characters on the calling thread.
+         */
+        void setJobSystem(JobSystem *job_system)
+        {
+            m_job_system = job_system;
+        }
+
+    private:
+        // Advance a character's level of detail state. Return false if the
+        // character skips this update, otherwise update_elapsed_time receives
+        // the time the character advances by.
+        bool _updateLodState(const Character &character, long elapsed_time,
+            long *update_elapsed_time);
+
+        // Run function(begin, end) over [0, count) characters, in parallel
+        // if there is a job system.
+        template <typename F>
+        void _forEachCharacter(size_t count, const F &function);
+
+    private:
+        // Scratch memory of an update.
+        FrameArena m_frame_arena;
+
+        // The job system which runs the stages, or nullptr.
+        JobSystem *m_job_system;
+    };
+};
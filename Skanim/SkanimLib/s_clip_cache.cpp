@@ -0,0 +1,286 @@
+#include "s_precomp.h"
+#include "s_clip_cache.h"
+#include "s_asset_file.h"
+#include "s_binary_asset.h"
+#include "s_interleaved_animation_clip.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // An interleaved clip on the key data of a mapped asset file, which
+        // it owns.
+        class _MappedAnimationClip : public InterleavedAnimationClip
+        {
+        public:
+            _MappedAnimationClip(AssetFile *file,
+                const BinaryAsset::AnimationClipView &view)
+                : InterleavedAnimationClip(view.key_data, view.track_count,
+                      view.key_count, view.key_pose_interval,
+                      String(view.name, view.name_length)),
+                  m_file(file)
+            {}
+
+            virtual ~_MappedAnimationClip()
+            {
+                SKANIM_DELETE_T_CATEGORY(AssetFile, m_file,
+                    MEMORY_CATEGORY_ANIMATION_CLIP);
+            }
+
+        private:
+            AssetFile *m_file;
+        };
+    }
+
+    struct ClipHandle::_Entry
+    {
+        ClipCache *cache;
+        IAnimationClip *clip;
+        // The loader which created the clip, or nullptr if it's inserted.
+        IClipLoader *loader;
+        size_t memory_size;
+        std::atomic<size_t> ref_count;
+        // The key in the entry map, for removing the entry on eviction.
+        String key;
+    };
+
+    IAnimationClip *AssetClipLoader::loadClip(const String &key,
+        size_t *memory_size)
+    {
+        assert(memory_size != nullptr && "memory_size must not be nullptr");
+
+        AssetFile *file = SKANIM_NEW_T_CATEGORY(AssetFile,
+            MEMORY_CATEGORY_ANIMATION_CLIP);
+        BinaryAsset::AnimationClipView view;
+
+        if (!file->open(key) ||
+            BinaryAsset::readAnimationClip(file->getData(), file->getSize(),
+                &view) != BinaryAsset::STATUS_OK) {
+            SKANIM_DELETE_T_CATEGORY(AssetFile, file,
+                MEMORY_CATEGORY_ANIMATION_CLIP);
+            return nullptr;
+        }
+
+        *memory_size = file->getSize();
+
+        // The clip is deleted through IAnimationClip, so it must not need
+        // an aligned allocation.
+        static_assert(alignof(_MappedAnimationClip) <=
+            IAllocManager::DEFAULT_ALIGNMENT, "clip must not be over-aligned");
+        void *memory = SKANIM_ALLOCATE_T_CATEGORY(_MappedAnimationClip, 1,
+            MEMORY_CATEGORY_ANIMATION_CLIP);
+        return new (memory) _MappedAnimationClip(file, view);
+    }
+
+    void AssetClipLoader::unloadClip(IAnimationClip *clip)
+    {
+        SKANIM_DELETE_T_CATEGORY(IAnimationClip, clip,
+            MEMORY_CATEGORY_ANIMATION_CLIP);
+    }
+
+    ClipHandle::ClipHandle(_Entry *entry) noexcept
+        : m_entry(entry)
+    {
+        if (m_entry != nullptr)
+            ++m_entry->ref_count;
+    }
+
+    ClipHandle::ClipHandle(const ClipHandle &other) noexcept
+        : ClipHandle(other.m_entry)
+    {}
+
+    ClipHandle::~ClipHandle()
+    {
+        reset();
+    }
+
+    ClipHandle &ClipHandle::operator=(const ClipHandle &other)
+    {
+        if (m_entry != other.m_entry) {
+            reset();
+            m_entry = other.m_entry;
+            if (m_entry != nullptr)
+                ++m_entry->ref_count;
+        }
+
+        return *this;
+    }
+
+    ClipHandle &ClipHandle::operator=(ClipHandle &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            m_entry = other.m_entry;
+            other.m_entry = nullptr;
+        }
+
+        return *this;
+    }
+
+    const IAnimationClip *ClipHandle::get() const
+    {
+        return m_entry != nullptr ? m_entry->clip : nullptr;
+    }
+
+    void ClipHandle::reset()
+    {
+        if (m_entry != nullptr) {
+            // The entry could be evicted as soon as it's unreferenced, so the
+            // cache is read before.
+            ClipCache *cache = m_entry->cache;
+            size_t ref_count = --m_entry->ref_count;
+            m_entry = nullptr;
+
+            if (ref_count == 0)
+                cache->_onEntryReleased();
+        }
+    }
+
+    ClipCache::ClipCache(size_t memory_budget, IClipLoader *loader) noexcept
+        : m_loader(loader != nullptr ? loader : &m_asset_loader),
+          m_memory_budget(memory_budget),
+          m_memory_usage(0),
+          m_hit_count(0),
+          m_miss_count(0),
+          m_eviction_count(0)
+    {}
+
+    ClipCache::~ClipCache()
+    {
+        for (_Entry *entry : m_entries) {
+            assert(entry->ref_count == 0 && "clip is still referenced");
+            _destroyEntry(entry);
+        }
+    }
+
+    ClipHandle ClipCache::acquire(const String &key)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto it = m_entry_map.find(key);
+            if (it != m_entry_map.end()) {
+                // Move the entry to the front as the most recently used.
+                m_entries.splice(m_entries.begin(), m_entries, it->second);
+                ++m_hit_count;
+                return ClipHandle(*it->second);
+            }
+        }
+
+        ++m_miss_count;
+
+        // Load the clip without holding the lock, so that hits on other
+        // threads don't wait for the loading.
+        size_t memory_size = 0;
+        IAnimationClip *clip = m_loader->loadClip(key, &memory_size);
+        if (clip == nullptr)
+            return ClipHandle();
+
+        return _insert(key, clip, memory_size, m_loader);
+    }
+
+    ClipHandle ClipCache::insert(const String &key, IAnimationClip *clip,
+        size_t memory_size)
+    {
+        assert(clip != nullptr && "clip must not be nullptr");
+        return _insert(key, clip, memory_size, nullptr);
+    }
+
+    bool ClipCache::contains(const String &key) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entry_map.find(key) != m_entry_map.end();
+    }
+
+    void ClipCache::setMemoryBudget(size_t memory_budget)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_memory_budget = memory_budget;
+        _evict(m_memory_budget);
+    }
+
+    size_t ClipCache::getClipCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    void ClipCache::purge()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        _evict(0);
+    }
+
+    ClipHandle ClipCache::_insert(const String &key, IAnimationClip *clip,
+        size_t memory_size, IClipLoader *loader)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_entry_map.find(key);
+        if (it != m_entry_map.end()) {
+            // Another thread loaded the same clip meanwhile, keep the one
+            // already in the cache.
+            assert(loader != nullptr && "key is already in the cache");
+            loader->unloadClip(clip);
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return ClipHandle(*it->second);
+        }
+
+        _Entry *entry = SKANIM_NEW_T(_Entry);
+        entry->cache = this;
+        entry->clip = clip;
+        entry->loader = loader;
+        entry->memory_size = memory_size;
+        entry->ref_count = 0;
+        entry->key = key;
+
+        m_entries.push_front(entry);
+        m_entry_map.emplace(key, m_entries.begin());
+        m_memory_usage += memory_size;
+
+        // The handle is taken before evicting so the new clip stays.
+        ClipHandle handle(entry);
+        _evict(m_memory_budget);
+
+        return handle;
+    }
+
+    void ClipCache::_evict(size_t memory_budget)
+    {
+        // Walk from the least recently used entry, skipping the referenced
+        // ones.
+        auto it = m_entries.end();
+        while (m_memory_usage > memory_budget && it != m_entries.begin()) {
+            --it;
+
+            _Entry *entry = *it;
+            if (entry->ref_count != 0)
+                continue;
+
+            m_entry_map.erase(entry->key);
+            it = m_entries.erase(it);
+            m_memory_usage -= entry->memory_size;
+            ++m_eviction_count;
+
+            _destroyEntry(entry);
+        }
+    }
+
+    void ClipCache::_destroyEntry(_Entry *entry)
+    {
+        if (entry->loader != nullptr)
+            entry->loader->unloadClip(entry->clip);
+        else
+            SKANIM_DELETE_T_CATEGORY(IAnimationClip, entry->clip,
+                MEMORY_CATEGORY_ANIMATION_CLIP);
+
+        SKANIM_DELETE_T(_Entry, entry);
+    }
+
+    void ClipCache::_onEntryReleased()
+    {
+        // The released clip may now be evicted if the budget is exceeded.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        _evict(m_memory_budget);
+    }
+};
\ No newline at end of file
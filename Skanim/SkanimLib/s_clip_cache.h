@@ -0,0 +1,233 @@
+#pragma once
+
+#include "s_prerequisites.h"
+
+namespace Skanim
+{
+    class ClipCache;
+    class IAnimationClip;
+
+    /** Clip loader creates the clips of a clip cache from their keys.
+     */
+    class _SKANIM_EXPORT IClipLoader
+    {
+    public:
+        virtual ~IClipLoader() = 0
+        {}
+
+        /** Load the clip of the given key and return its memory size in
+         *  memory_size. Return nullptr if it can't be loaded.
+         */
+        virtual IAnimationClip *loadClip(const String &key, size_t *memory_size) = 0;
+
+        /** Destroy a clip created by loadClip().
+         */
+        virtual void unloadClip(IAnimationClip *clip) = 0;
+    };
+
+    /** Asset clip loader loads binary animation clip assets, the key is the
+     *  path of the file. The file is mapped and used in place.
+     */
+    class _SKANIM_EXPORT AssetClipLoader : public IClipLoader
+    {
+    public:
+        virtual IAnimationClip *loadClip(const String &key,
+            size_t *memory_size) override;
+
+        virtual void unloadClip(IAnimationClip *clip) override;
+    };
+
+    /** Clip handle keeps a clip of a clip cache alive. A clip is never evicted
+     *  while there is a handle to it.
+     */
+    class _SKANIM_EXPORT ClipHandle
+    {
+    public:
+        ClipHandle() noexcept
+            : m_entry(nullptr)
+        {}
+
+        ClipHandle(const ClipHandle &other) noexcept;
+
+        ClipHandle(ClipHandle &&other) noexcept
+            : m_entry(other.m_entry)
+        {
+            other.m_entry = nullptr;
+        }
+
+        ~ClipHandle();
+
+        ClipHandle &operator=(const ClipHandle &other);
+
+        ClipHandle &operator=(ClipHandle &&other) noexcept;
+
+        /** Get the clip, or nullptr if the handle is empty.
+         */
+        const IAnimationClip *get() const;
+
+        const IAnimationClip *operator->() const
+        {
+            return get();
+        }
+
+        /** Check if the handle holds a clip.
+         */
+        explicit operator bool() const
+        {
+            return m_entry != nullptr;
+        }
+
+        /** Release the clip and make the handle empty.
+         */
+        void reset();
+
+    private:
+        friend class ClipCache;
+
+        struct _Entry;
+
+        explicit ClipHandle(_Entry *entry) noexcept;
+
+        // The cache entry of the clip.
+        _Entry *m_entry;
+    };
+
+    /** Clip cache shares clips between the animation states which play them.
+     *  Clips are keyed by name or path and handed out as reference counted
+     *  handles. A clip stays in the cache after its last handle is released,
+     *  and the least recently used unreferenced clips are evicted when the
+     *  clips take more memory than the budget. Clips which are referenced are
+     *  never evicted, so the budget could be exceeded while they are in use.
+     *  The cache could be used from several threads.
+     */
+    class _SKANIM_EXPORT ClipCache
+    {
+    public:
+        /** The default memory budget in bytes.
+         */
+        static const size_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+
+        /** Construct a clip cache.
+         *  @param loader Loads the clips which aren't in the cache. If it's
+         *  nullptr, clips are loaded from binary asset files.
+         */
+        explicit ClipCache(size_t memory_budget = DEFAULT_MEMORY_BUDGET,
+            IClipLoader *loader = nullptr) noexcept;
+
+        /** Destroy all the clips. There must be no handle left.
+         */
+        ~ClipCache();
+
+        ClipCache(const ClipCache &) = delete;
+
+        ClipCache &operator=(const ClipCache &) = delete;
+
+        /** Get the clip of a key, loading it if it's not in the cache. The
+         *  handle is empty if the clip can't be loaded.
+         */
+        ClipHandle acquire(const String &key);
+
+        /** Add a clip which is created elsewhere with SKANIM_NEW_T_CATEGORY or
+         *  SKANIM_ALLOCATE_T_CATEGORY in MEMORY_CATEGORY_ANIMATION_CLIP, and
+         *  doesn't need an aligned allocation. The cache takes the ownership
+         *  and deletes the clip when it's evicted. The key must not be in the
+         *  cache.
+         */
+        ClipHandle insert(const String &key, IAnimationClip *clip,
+            size_t memory_size);
+
+        /** Check if a key is in the cache.
+         */
+        bool contains(const String &key) const;
+
+        /** Get the memory budget in bytes.
+         */
+        size_t getMemoryBudget() const
+        {
+            return m_memory_budget;
+        }
+
+        /** Modify the memory budget, evicting clips if they take more.
+         */
+        void setMemoryBudget(size_t memory_budget);
+
+        /** Get the memory taken by the clips in the cache.
+         */
+        size_t getMemoryUsage() const
+        {
+            return m_memory_usage;
+        }
+
+        /** Get the number of clips in the cache.
+         */
+        size_t getClipCount() const;
+
+        /** Get the number of acquisitions which found their clips in the
+         *  cache.
+         */
+        size_t getHitCount() const
+        {
+            return m_hit_count;
+        }
+
+        /** Get the number of acquisitions which had to load their clips.
+         */
+        size_t getMissCount() const
+        {
+            return m_miss_count;
+        }
+
+        /** Get the number of clips evicted.
+         */
+        size_t getEvictionCount() const
+        {
+            return m_eviction_count;
+        }
+
+        /** Evict all the clips which aren't referenced.
+         */
+        void purge();
+
+    private:
+        friend class ClipHandle;
+
+        typedef ClipHandle::_Entry _Entry;
+        typedef list<_Entry*> _EntryList;
+        typedef unordered_map<String, _EntryList::iterator> _EntryMap;
+
+        // Add a loaded clip as the most recently used one.
+        ClipHandle _insert(const String &key, IAnimationClip *clip,
+            size_t memory_size, IClipLoader *loader);
+
+        // Evict the least recently used unreferenced clips until the clips
+        // take no more than memory_budget.
+        void _evict(size_t memory_budget);
+
+        // Destroy an entry and its clip.
+        void _destroyEntry(_Entry *entry);
+
+        // Called when the last handle of an entry is released.
+        void _onEntryReleased();
+
+    private:
+        // The clips, the most recently used first.
+        _EntryList m_entries;
+        // The clips by their keys.
+        _EntryMap m_entry_map;
+
+        // Guards the entries.
+        mutable std::mutex m_mutex;
+
+        // The loader of the clips not in the cache.
+        IClipLoader *m_loader;
+        AssetClipLoader m_asset_loader;
+
+        size_t m_memory_budget;
+        std::atomic<size_t> m_memory_usage;
+
+        // Statistics.
+        std::atomic<size_t> m_hit_count;
+        std::atomic<size_t> m_miss_count;
+        std::atomic<size_t> m_eviction_count;
+    };
+};
\ No newline at end of file
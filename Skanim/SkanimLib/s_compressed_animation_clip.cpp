@@ -0,0 +1,353 @@
+#include "s_precomp.h"
+#include "s_compressed_animation_clip.h"
+#include "s_animation_clip.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // The smallest three components of a unit quaternion lie in this range.
+        const float SMALLEST_THREE_RANGE = 0.707106781f;
+
+        // Quantize value in range [0, 1] to an unsigned integer with bits.
+        uint16_t _quantizeUnit(float value, int bits)
+        {
+            const float max_value = (float)((1 << bits) - 1);
+            return (uint16_t)(Math::clamp01(value) * max_value + 0.5f);
+        }
+
+        // Restore a value quantized by _quantizeUnit().
+        float _dequantizeUnit(uint16_t value, int bits)
+        {
+            return (float)value / (float)((1 << bits) - 1);
+        }
+    }
+
+    CompressedAnimationClip::CompressedAnimationClip(
+        const KeyPoseAnimationClip &source, float constant_tolerance) noexcept
+        : m_track_headers(source.getTrackCount()),
+          m_frame_size(0),
+          m_key_count(source.getKeyPoseCount()),
+          m_name(source.getName()),
+          m_key_pose_interval(source.getKeyPoseInterval())
+    {
+        const size_t track_count = m_track_headers.size();
+
+        // Gather the source keys so they're only copied out once.
+        vector<Pose> key_poses;
+        key_poses.reserve(m_key_count);
+        for (size_t i_key = 0; i_key < m_key_count; ++i_key)
+            key_poses.push_back(source.getKeyPose(i_key));
+
+        // Find constant components and value ranges of each track, and
+        // assign the data offset of animated components in a key frame.
+        for (size_t i_track = 0; i_track < track_count; ++i_track) {
+            _TrackHeader &header = m_track_headers[i_track];
+
+            const Transform first = m_key_count > 0 ?
+                key_poses[0].getJointTransform(i_track) : Transform::IDENTITY();
+            const Quaternion &first_rotation = first.getRotation();
+            Vector3 first_translation = first.getTranslation();
+
+            float rotation_deviation = 0.0f;
+            float translation_deviation = 0.0f;
+            float scale_deviation = 0.0f;
+            float translation_max[3];
+
+            for (int i = 0; i < 3; ++i) {
+                header.translation_min[i] = first_translation[i];
+                translation_max[i] = header.translation_min[i];
+            }
+            header.scale_min = first.getScale();
+            float scale_max = first.getScale();
+
+            for (size_t i_key = 1; i_key < m_key_count; ++i_key) {
+                const Transform key = key_poses[i_key].getJointTransform(i_track);
+                Vector3 translation = key.getTranslation();
+
+                // q and -q are the same rotation.
+                Quaternion rotation = key.getRotation();
+                if (Quaternion::dot(rotation, first_rotation) < 0.0f)
+                    rotation = -rotation;
+                rotation_deviation = std::max(rotation_deviation, std::max(
+                    std::max(std::fabs(rotation.getW() - first_rotation.getW()),
+                        std::fabs(rotation.getX() - first_rotation.getX())),
+                    std::max(std::fabs(rotation.getY() - first_rotation.getY()),
+                        std::fabs(rotation.getZ() - first_rotation.getZ()))));
+
+                for (int i = 0; i < 3; ++i) {
+                    const float value = translation[i];
+                    translation_deviation = std::max(translation_deviation,
+                        std::fabs(value - first_translation[i]));
+                    header.translation_min[i] = std::min(header.translation_min[i], value);
+                    translation_max[i] = std::max(translation_max[i], value);
+                }
+
+                scale_deviation = std::max(scale_deviation,
+                    std::fabs(key.getScale() - first.getScale()));
+                header.scale_min = std::min(header.scale_min, key.getScale());
+                scale_max = std::max(scale_max, key.getScale());
+            }
+
+            header.flags = 0;
+            header.data_offset = (uint32_t)m_frame_size;
+
+            if (rotation_deviation <= constant_tolerance) {
+                header.flags |= _TRACK_FLAG_CONSTANT_ROTATION;
+                const Quaternion rotation = first_rotation.normalized();
+                header.constant_rotation[0] = rotation.getW();
+                header.constant_rotation[1] = rotation.getX();
+                header.constant_rotation[2] = rotation.getY();
+                header.constant_rotation[3] = rotation.getZ();
+            }
+            else {
+                m_frame_size += 3;
+            }
+
+            if (translation_deviation <= constant_tolerance) {
+                header.flags |= _TRACK_FLAG_CONSTANT_TRANSLATION;
+                for (int i = 0; i < 3; ++i) {
+                    header.translation_min[i] = first_translation[i];
+                    header.translation_extent[i] = 0.0f;
+                }
+            }
+            else {
+                for (int i = 0; i < 3; ++i)
+                    header.translation_extent[i] = translation_max[i] - header.translation_min[i];
+                m_frame_size += 3;
+            }
+
+            if (scale_deviation <= constant_tolerance) {
+                header.flags |= _TRACK_FLAG_CONSTANT_SCALE;
+                header.scale_min = first.getScale();
+                header.scale_extent = 0.0f;
+            }
+            else {
+                header.scale_extent = scale_max - header.scale_min;
+                m_frame_size += 1;
+            }
+        }
+
+        // Quantize the animated components frame by frame.
+        m_key_data.resize(m_frame_size * m_key_count);
+
+        for (size_t i_key = 0; i_key < m_key_count; ++i_key) {
+            uint16_t *frame = m_key_data.data() + m_frame_size * i_key;
+
+            for (size_t i_track = 0; i_track < track_count; ++i_track) {
+                const _TrackHeader &header = m_track_headers[i_track];
+                const Transform key = key_poses[i_key].getJointTransform(i_track);
+                Vector3 translation = key.getTranslation();
+                uint16_t *words = frame + header.data_offset;
+
+                if ((header.flags & _TRACK_FLAG_CONSTANT_ROTATION) == 0) {
+                    _encodeRotation(key.getRotation().normalized(), words);
+                    words += 3;
+                }
+
+                if ((header.flags & _TRACK_FLAG_CONSTANT_TRANSLATION) == 0) {
+                    for (int i = 0; i < 3; ++i) {
+                        const float extent = header.translation_extent[i];
+                        const float value = translation[i];
+                        words[i] = extent > 0.0f ? _quantizeUnit(
+                            (value - header.translation_min[i]) / extent, 16) : 0;
+                    }
+                    words += 3;
+                }
+
+                if ((header.flags & _TRACK_FLAG_CONSTANT_SCALE) == 0) {
+                    words[0] = _quantizeUnit((key.getScale() - header.scale_min) /
+                        header.scale_extent, 16);
+                }
+            }
+        }
+    }
+
+    void CompressedAnimationClip::extractPose(long local_time,
+        Pose *extracted_pose) const
+    {
+        assert(local_time >= 0 && local_time <= getLength() &&
+            "local time out of range");
+        assert(m_key_count > 0 && "no key pose in the clip");
+
+        const size_t track_count = m_track_headers.size();
+        extracted_pose->resize(track_count);
+
+        const JointRange range = { 0, track_count };
+        _extractTracks(local_time, range, extracted_pose);
+    }
+
+    void CompressedAnimationClip::extractPose(long local_time,
+        const JointRange *ranges, size_t range_count, Pose *extracted_pose) const
+    {
+        assert(local_time >= 0 && local_time <= getLength() &&
+            "local time out of range");
+        assert(m_key_count > 0 && "no key pose in the clip");
+
+        extracted_pose->resize(m_track_headers.size());
+
+        for (size_t i_range = 0; i_range < range_count; ++i_range)
+            _extractTracks(local_time, ranges[i_range], extracted_pose);
+    }
+
+    void CompressedAnimationClip::_extractTracks(long local_time,
+        const JointRange &range, Pose *extracted_pose) const
+    {
+        assert(range.begin <= range.end && range.end <= m_track_headers.size() &&
+            "joint range out of range");
+
+        size_t key_index = 0;
+        float t = 0.0f;
+        if (m_key_pose_interval > 0) {
+            key_index = local_time / m_key_pose_interval;
+            t = (float)local_time / m_key_pose_interval - key_index;
+        }
+        // The last key has no key next to it, interpolate it with itself.
+        const size_t next_key_index = std::min(key_index + 1, m_key_count - 1);
+
+        const uint16_t *frame = m_key_data.data() + m_frame_size * key_index;
+        const uint16_t *next_frame = m_key_data.data() + m_frame_size * next_key_index;
+
+        float *translation_x = extracted_pose->getStream(Pose::STREAM_TRANSLATION_X);
+        float *translation_y = extracted_pose->getStream(Pose::STREAM_TRANSLATION_Y);
+        float *translation_z = extracted_pose->getStream(Pose::STREAM_TRANSLATION_Z);
+        float *scale = extracted_pose->getStream(Pose::STREAM_SCALE);
+
+        // Decompress the rotations of a block of tracks onto the stack, then
+        // interpolate them directly into the pose.
+        const size_t BLOCK_SIZE = 64;
+        float from_rotations[4][BLOCK_SIZE];
+        float to_rotations[4][BLOCK_SIZE];
+
+        for (size_t i_begin = range.begin; i_begin < range.end;
+            i_begin += BLOCK_SIZE) {
+            const size_t block_count = std::min(BLOCK_SIZE, range.end - i_begin);
+
+            for (size_t i = 0; i < block_count; ++i) {
+                const size_t i_track = i_begin + i;
+                const _TrackHeader &header = m_track_headers[i_track];
+
+                Quaternion rotation, next_rotation;
+                Vector3 translation, next_translation;
+                float key_scale, next_key_scale;
+                _decodeTrack(header, frame, &rotation, &translation, &key_scale);
+                _decodeTrack(header, next_frame, &next_rotation, &next_translation,
+                    &next_key_scale);
+
+                from_rotations[0][i] = rotation.getX();
+                from_rotations[1][i] = rotation.getY();
+                from_rotations[2][i] = rotation.getZ();
+                from_rotations[3][i] = rotation.getW();
+                to_rotations[0][i] = next_rotation.getX();
+                to_rotations[1][i] = next_rotation.getY();
+                to_rotations[2][i] = next_rotation.getZ();
+                to_rotations[3][i] = next_rotation.getW();
+
+                translation_x[i_track] = Math::lerp(t, translation.getX(), next_translation.getX());
+                translation_y[i_track] = Math::lerp(t, translation.getY(), next_translation.getY());
+                translation_z[i_track] = Math::lerp(t, translation.getZ(), next_translation.getZ());
+                scale[i_track] = Math::lerp(t, key_scale, next_key_scale);
+            }
+
+            const QuaternionBatch::ConstStreams from = {
+                from_rotations[0], from_rotations[1], from_rotations[2], from_rotations[3] };
+            const QuaternionBatch::ConstStreams to = {
+                to_rotations[0], to_rotations[1], to_rotations[2], to_rotations[3] };
+            const QuaternionBatch::Streams result = {
+                extracted_pose->getStream(Pose::STREAM_ROTATION_X) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_Y) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_Z) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_W) + i_begin };
+            QuaternionBatch::slerp(t, block_count, from, to, result);
+        }
+    }
+
+    void CompressedAnimationClip::_encodeRotation(const Quaternion &q,
+        uint16_t *words)
+    {
+        // Find the component with the largest magnitude. It's dropped and
+        // restored from the others since the quaternion has unit length.
+        const float c[4] = { q.getW(), q.getX(), q.getY(), q.getZ() };
+        int largest = 0;
+        for (int i = 1; i < 4; ++i) {
+            if (std::fabs(c[i]) > std::fabs(c[largest]))
+                largest = i;
+        }
+
+        // Make the dropped component positive, q and -q are the same rotation.
+        const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+        uint16_t quantized[3];
+        for (int i = 0, i_small = 0; i < 4; ++i) {
+            if (i == largest)
+                continue;
+            const float unit = (c[i] * sign / SMALLEST_THREE_RANGE) * 0.5f + 0.5f;
+            // The first two components take 15 bits, the highest bit of their
+            // words holds the index of the largest component.
+            quantized[i_small] = _quantizeUnit(unit, i_small < 2 ? 15 : 16);
+            ++i_small;
+        }
+
+        words[0] = (uint16_t)(((largest >> 1) << 15) | quantized[0]);
+        words[1] = (uint16_t)(((largest & 1) << 15) | quantized[1]);
+        words[2] = quantized[2];
+    }
+
+    Quaternion CompressedAnimationClip::_decodeRotation(const uint16_t *words)
+    {
+        const int largest = ((words[0] >> 15) << 1) | (words[1] >> 15);
+
+        const float small[3] = {
+            (_dequantizeUnit(words[0] & 0x7fff, 15) * 2.0f - 1.0f) * SMALLEST_THREE_RANGE,
+            (_dequantizeUnit(words[1] & 0x7fff, 15) * 2.0f - 1.0f) * SMALLEST_THREE_RANGE,
+            (_dequantizeUnit(words[2], 16) * 2.0f - 1.0f) * SMALLEST_THREE_RANGE
+        };
+
+        float c[4];
+        float sum = 0.0f;
+        for (int i = 0, i_small = 0; i < 4; ++i) {
+            if (i == largest)
+                continue;
+            c[i] = small[i_small++];
+            sum += c[i] * c[i];
+        }
+        c[largest] = sqrtf(std::max(0.0f, 1.0f - sum));
+
+        return Quaternion(c[0], c[1], c[2], c[3]);
+    }
+
+    void CompressedAnimationClip::_decodeTrack(const _TrackHeader &header,
+        const uint16_t *frame, Quaternion *rotation, Vector3 *translation,
+        float *scale) const
+    {
+        const uint16_t *words = frame + header.data_offset;
+
+        if (header.flags & _TRACK_FLAG_CONSTANT_ROTATION) {
+            *rotation = Quaternion(header.constant_rotation[0],
+                header.constant_rotation[1], header.constant_rotation[2],
+                header.constant_rotation[3]);
+        }
+        else {
+            *rotation = _decodeRotation(words);
+            words += 3;
+        }
+
+        if (header.flags & _TRACK_FLAG_CONSTANT_TRANSLATION) {
+            *translation = Vector3(header.translation_min[0],
+                header.translation_min[1], header.translation_min[2]);
+        }
+        else {
+            *translation = Vector3(
+                header.translation_min[0] + _dequantizeUnit(words[0], 16) * header.translation_extent[0],
+                header.translation_min[1] + _dequantizeUnit(words[1], 16) * header.translation_extent[1],
+                header.translation_min[2] + _dequantizeUnit(words[2], 16) * header.translation_extent[2]);
+            words += 3;
+        }
+
+        if (header.flags & _TRACK_FLAG_CONSTANT_SCALE)
+            *scale = header.scale_min;
+        else
+            *scale = header.scale_min + _dequantizeUnit(words[0], 16) * header.scale_extent;
+    }
+
+};
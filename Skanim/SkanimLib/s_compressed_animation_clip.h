@@ -0,0 +1,157 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_ianimation_clip.h"
+#include "s_pose.h"
+
+namespace Skanim
+{
+    class KeyPoseAnimationClip;
+
+    /** Compressed animation clip stores the same key pose sequence as a key
+     *  pose animation clip in a much smaller memory footprint.
+     *  Rotations are stored as smallest-three quantized quaternions in 48 bits.
+     *  Translations and scales are quantized to 16 bits per component within
+     *  the range of each track. Tracks that never change are collapsed to a
+     *  single value and take no room in the key data.
+     */
+    class _SKANIM_EXPORT CompressedAnimationClip : public IAnimationClip
+    {
+    public:
+        /** Compress a key pose animation clip.
+         *  @param constant_tolerance A track component is considered constant
+         *  if it never differs from its first key by more than this value.
+         */
+        explicit CompressedAnimationClip(const KeyPoseAnimationClip &source,
+            float constant_tolerance = Math::EPSILON()) noexcept;
+
+        /** Get the time length.
+         */
+        virtual long getLength() const override
+        {
+            return m_key_count > 0 ? (m_key_count - 1) * m_key_pose_interval : 0;
+        }
+
+        /** Get the number of tracks
+         */
+        virtual size_t getTrackCount() const override
+        {
+            return m_track_headers.size();
+        }
+
+        /** Extract pose from this clip with local time. The keys are
+         *  decompressed on the fly, nothing is allocated unless the extracted
+         *  pose has to grow.
+         */
+        virtual void extractPose(long local_time, Pose *extracted_pose)
+            const override;
+
+        /** Extract the joints in the given ranges from this clip with local
+         *  time. Only the tracks in the ranges are decompressed.
+         */
+        virtual void extractPose(long local_time, const JointRange *ranges,
+            size_t range_count, Pose *extracted_pose) const override;
+
+        /** Get the number of key poses.
+         */
+        size_t getKeyPoseCount() const
+        {
+            return m_key_count;
+        }
+
+        /** Get key interval.
+         */
+        long getKeyPoseInterval() const
+        {
+            return m_key_pose_interval;
+        }
+
+        /** Get the name of this clip.
+         */
+        const String &getName() const
+        {
+            return m_name;
+        }
+
+        /** Get the size in bytes of the compressed track headers and key data.
+         */
+        size_t getCompressedSize() const
+        {
+            return m_track_headers.size() * sizeof(_TrackHeader) +
+                m_key_data.size() * sizeof(uint16_t);
+        }
+
+    private:
+        // Flags which indicate the constant components of a track.
+        enum _TrackFlag
+        {
+            _TRACK_FLAG_CONSTANT_ROTATION = 1 << 0,
+            _TRACK_FLAG_CONSTANT_TRANSLATION = 1 << 1,
+            _TRACK_FLAG_CONSTANT_SCALE = 1 << 2
+        };
+
+        // Per track information needed to decompress its keys.
+        struct _TrackHeader
+        {
+            // Combination of _TrackFlag.
+            uint32_t flags;
+
+            // The offset of this track's data in a key frame, in words.
+            uint32_t data_offset;
+
+            // Rotation of a constant rotation track, in w, x, y, z order.
+            float constant_rotation[4];
+
+            // The translation of a constant translation track or the minimum
+            // translation of an animated one.
+            float translation_min[3];
+
+            // The translation range of an animated translation track.
+            float translation_extent[3];
+
+            // The scale of a constant scale track or the minimum scale of an
+            // animated one.
+            float scale_min;
+
+            // The scale range of an animated scale track.
+            float scale_extent;
+        };
+
+        // Quantize a unit quaternion into three words with smallest-three
+        // encoding.
+        static void _encodeRotation(const Quaternion &q, uint16_t *words);
+
+        // Restore a unit quaternion from three words.
+        static Quaternion _decodeRotation(const uint16_t *words);
+
+        // Decompress the tracks in a range at local time into the pose.
+        void _extractTracks(long local_time, const JointRange &range,
+            Pose *extracted_pose) const;
+
+        // Decode one track of a key frame.
+        void _decodeTrack(const _TrackHeader &header, const uint16_t *frame,
+            Quaternion *rotation, Vector3 *translation, float *scale) const;
+
+    private:
+        typedef vector<_TrackHeader> _TrackHeaderVector;
+
+        // Track headers.
+        _TrackHeaderVector m_track_headers;
+
+        // Quantized key data. Keys are stored frame by frame. Each frame
+        // contains the animated components of all the tracks.
+        std::vector<uint16_t, Allocator<uint16_t, MEMORY_CATEGORY_ANIMATION_CLIP>> m_key_data;
+
+        // The number of words of a key frame.
+        size_t m_frame_size;
+
+        // The number of key poses.
+        size_t m_key_count;
+
+        // The name of this clip
+        String m_name;
+
+        // The time interval between key poses.
+        long m_key_pose_interval;
+    };
+};
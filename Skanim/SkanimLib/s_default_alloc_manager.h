@@ -31,5 +31,31 @@ namespace Skanim
         {
             return std::numeric_limits<size_t>::max();
         }
+
+        virtual void *allocateAlignedBytes(size_t count, size_t alignment,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr) override
+        {
+            assert(alignment > 0 && (alignment & (alignment - 1)) == 0 &&
+                "alignment isn't a power of two");
+#ifdef _WIN32
+            void *ptr = _aligned_malloc(count, alignment);
+#else
+            void *ptr = nullptr;
+            if (posix_memalign(&ptr, std::max(alignment, sizeof(void*)), count) != 0)
+                ptr = nullptr;
+#endif
+            assert(ptr);
+            return ptr;
+        }
+
+        virtual void deallocateAlignedBytes(void *ptr) override
+        {
+#ifdef _WIN32
+            _aligned_free(ptr);
+#else
+            free(ptr);
+#endif
+        }
     };
 };
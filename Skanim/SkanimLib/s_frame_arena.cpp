@@ -0,0 +1,76 @@
+#include "s_precomp.h"
+#include "s_frame_arena.h"
+#include "s_memory_config.h"
+
+namespace Skanim
+{
+    FrameArena::FrameArena(size_t capacity) noexcept
+        : m_current(0),
+          m_end(0),
+          m_used_size(0),
+          m_capacity(0)
+    {
+        if (capacity > 0)
+            _addBlock(capacity);
+    }
+
+    FrameArena::~FrameArena()
+    {
+        _releaseBlocks();
+    }
+
+    void *FrameArena::allocate(size_t n_bytes, size_t alignment)
+    {
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0 &&
+            "alignment isn't a power of two");
+
+        uintptr_t address = (m_current + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (m_blocks.empty() || address + n_bytes > m_end) {
+            // The current block is full, continue in a new one. Make it at
+            // least as large as everything allocated so far, so the number of
+            // blocks grows logarithmically in a single frame.
+            _addBlock(std::max(n_bytes + alignment - 1, m_capacity));
+            address = (m_current + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        }
+
+        m_used_size += address + n_bytes - m_current;
+        m_current = address + n_bytes;
+
+        return reinterpret_cast<void*>(address);
+    }
+
+    void FrameArena::reset()
+    {
+        // Merge the blocks into a single one which could hold a whole frame.
+        if (m_blocks.size() > 1) {
+            const size_t capacity = m_capacity;
+            _releaseBlocks();
+            _addBlock(capacity);
+        }
+
+        m_current = m_blocks.empty() ? 0 : reinterpret_cast<uintptr_t>(m_blocks.back());
+        m_used_size = 0;
+    }
+
+    void FrameArena::_addBlock(size_t n_bytes)
+    {
+        void *block = SKANIM_MALLOC(n_bytes);
+        m_blocks.push_back(block);
+
+        m_current = reinterpret_cast<uintptr_t>(block);
+        m_end = m_current + n_bytes;
+        m_capacity += n_bytes;
+    }
+
+    void FrameArena::_releaseBlocks()
+    {
+        for (auto block : m_blocks)
+            SKANIM_FREE(block);
+
+        m_blocks.clear();
+        m_current = 0;
+        m_end = 0;
+        m_capacity = 0;
+    }
+
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "s_prerequisites.h"
+
+namespace Skanim
+{
+    /** Frame arena is a linear allocator for scratch memory that only lives
+     *  during one frame. Allocations just bump a pointer and nothing is freed
+     *  individually, everything is released at once by reset().
+     *  If a frame needs more memory than the arena's capacity, extra blocks are
+     *  allocated. They are merged into one block at the next reset, so after
+     *  a few frames the arena doesn't touch the alloc manager anymore.
+     */
+    class _SKANIM_EXPORT FrameArena
+    {
+    public:
+        /** Construct a frame arena.
+         *  @param capacity The initial capacity in bytes.
+         */
+        explicit FrameArena(size_t capacity = 0) noexcept;
+
+        ~FrameArena();
+
+        FrameArena(const FrameArena &) = delete;
+
+        FrameArena &operator=(const FrameArena &) = delete;
+
+        /** Allocate bytes with the given alignment, which must be a power of
+         *  two. The memory is valid until the next reset().
+         */
+        void *allocate(size_t n_bytes, size_t alignment = sizeof(void*));
+
+        /** Allocate an array of n objects of type T without constructing them.
+         */
+        template <typename T>
+        T *allocateArray(size_t n, size_t alignment = alignof(T))
+        {
+            return static_cast<T*>(allocate(sizeof(T) * n, alignment));
+        }
+
+        /** Release all the allocations at once.
+         */
+        void reset();
+
+        /** Get the number of bytes allocated since the last reset, including
+         *  the alignment padding.
+         */
+        size_t getUsedSize() const
+        {
+            return m_used_size;
+        }
+
+        /** Get the total capacity of all the blocks in bytes.
+         */
+        size_t getCapacity() const
+        {
+            return m_capacity;
+        }
+
+    private:
+        // Allocate a new block which holds at least n_bytes and make it the
+        // current block.
+        void _addBlock(size_t n_bytes);
+
+        // Free all the blocks.
+        void _releaseBlocks();
+
+    private:
+        // The memory blocks owned by this arena. The last one is the current
+        // block.
+        vector<void*> m_blocks;
+
+        // The begin and the end of the free space in the current block.
+        uintptr_t m_current;
+        uintptr_t m_end;
+
+        // The bytes allocated since the last reset.
+        size_t m_used_size;
+
+        // The total size of all blocks.
+        size_t m_capacity;
+    };
+};
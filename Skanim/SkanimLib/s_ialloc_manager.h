@@ -10,10 +10,15 @@ namespace Skanim
     class _SKANIM_EXPORT IAllocManager
     {
     public:
+        /** The alignment of the memory returned by allocateBytes().
+         */
+        static const size_t DEFAULT_ALIGNMENT = alignof(std::max_align_t);
+
         virtual ~IAllocManager() = 0
         {}
 
-        /** Allocate bytes and return the allocated memory pointer.
+        /** Allocate bytes and return the allocated memory pointer. The memory
+         *  is aligned to DEFAULT_ALIGNMENT.
          */
         virtual void *allocateBytes(size_t count, 
             const wchar_t *file = nullptr, 
@@ -27,5 +32,38 @@ namespace Skanim
         /** Get the maximum size of a single allocation. 
          */
         virtual size_t getMaxAllocationSize() = 0;
+
+        /** Allocate bytes aligned to alignment, which must be a power of two.
+         *  The memory must be freed by deallocateAlignedBytes(). By default
+         *  more bytes are allocated with allocateBytes() and the pointer to
+         *  them is kept in front of the aligned memory.
+         */
+        virtual void *allocateAlignedBytes(size_t count, size_t alignment,
+            const wchar_t *file = nullptr,
+            int line = 0,
+            const wchar_t *func = nullptr)
+        {
+            assert(alignment > 0 && (alignment & (alignment - 1)) == 0 &&
+                "alignment isn't a power of two");
+
+            alignment = std::max(alignment, sizeof(void*));
+            void *ptr = allocateBytes(count + alignment - 1 + sizeof(void*),
+                file, line, func);
+
+            const uintptr_t aligned_address =
+                ((uintptr_t)ptr + sizeof(void*) + alignment - 1) &
+                ~(uintptr_t)(alignment - 1);
+            reinterpret_cast<void**>(aligned_address)[-1] = ptr;
+
+            return reinterpret_cast<void*>(aligned_address);
+        }
+
+        /** Deallocate bytes allocated by allocateAlignedBytes().
+         */
+        virtual void deallocateAlignedBytes(void *ptr)
+        {
+            if (ptr)
+                deallocateBytes(static_cast<void**>(ptr)[-1]);
+        }
     };
 };
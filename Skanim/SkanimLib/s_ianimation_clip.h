@@ -24,5 +24,13 @@ namespace Skanim
         /** Extract the pose at local time t.
          */
         virtual void extractPose(long t, Pose *extracted_pose) const = 0;
+
+        /** Extract the pose at local time t, only the tracks of the joints in
+         *  the given ranges are decoded. The extracted pose is resized to the
+         *  track count and the joints out of the ranges are left unchanged.
+         *  The ranges must not overlap.
+         */
+        virtual void extractPose(long t, const JointRange *ranges,
+            size_t range_count, Pose *extracted_pose) const = 0;
     };
 };
@@ -0,0 +1,156 @@
+#include "s_precomp.h"
+#include "s_interleaved_animation_clip.h"
+#include "s_animation_clip.h"
+
+namespace Skanim
+{
+    InterleavedAnimationClip::InterleavedAnimationClip(
+        const KeyPoseAnimationClip &source) noexcept
+        : m_key_data(nullptr),
+          m_track_count(source.getTrackCount()),
+          m_key_count(source.getKeyPoseCount()),
+          m_segment_count(getSegmentCount(source.getKeyPoseCount())),
+          m_name(source.getName()),
+          m_key_pose_interval(source.getKeyPoseInterval())
+    {
+        if (m_key_count == 0)
+            return;
+
+        const size_t segment_size = getSegmentSize(m_track_count);
+        m_owned_key_data.resize(segment_size * m_segment_count);
+        m_key_data = m_owned_key_data.data();
+
+        Pose key_pose = source.getKeyPose(0);
+        for (size_t i_segment = 0; i_segment < m_segment_count; ++i_segment) {
+            const Pose next_key_pose = source.getKeyPose(
+                std::min(i_segment + 1, m_key_count - 1));
+            float *joint = m_owned_key_data.data() + segment_size * i_segment;
+
+            for (size_t i_track = 0; i_track < m_track_count; ++i_track) {
+                for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+                    joint[i_stream] =
+                        key_pose.getStream((Pose::Stream)i_stream)[i_track];
+                    joint[_TRANSFORM_SIZE + i_stream] =
+                        next_key_pose.getStream((Pose::Stream)i_stream)[i_track];
+                }
+                joint += _JOINT_SIZE;
+            }
+
+            key_pose = next_key_pose;
+        }
+    }
+
+    InterleavedAnimationClip::InterleavedAnimationClip(const float *key_data,
+        size_t track_count, size_t key_count, long key_pose_interval,
+        const String &name) noexcept
+        : m_key_data(key_data),
+          m_track_count(track_count),
+          m_key_count(key_count),
+          m_segment_count(getSegmentCount(key_count)),
+          m_name(name),
+          m_key_pose_interval(key_pose_interval)
+    {
+        assert((key_data || key_count == 0) && "key data can't be nullptr");
+    }
+
+    void InterleavedAnimationClip::extractPose(long local_time,
+        Pose *extracted_pose) const
+    {
+        assert(local_time >= 0 && local_time <= getLength() &&
+            "local time out of range");
+        assert(m_key_count > 0 && "no key pose in the clip");
+
+        extracted_pose->resize(m_track_count);
+
+        const JointRange range = { 0, m_track_count };
+        _extractTracks(local_time, range, extracted_pose);
+    }
+
+    void InterleavedAnimationClip::extractPose(long local_time,
+        const JointRange *ranges, size_t range_count, Pose *extracted_pose) const
+    {
+        assert(local_time >= 0 && local_time <= getLength() &&
+            "local time out of range");
+        assert(m_key_count > 0 && "no key pose in the clip");
+
+        extracted_pose->resize(m_track_count);
+
+        for (size_t i_range = 0; i_range < range_count; ++i_range)
+            _extractTracks(local_time, ranges[i_range], extracted_pose);
+    }
+
+    void InterleavedAnimationClip::_extractTracks(long local_time,
+        const JointRange &range, Pose *extracted_pose) const
+    {
+        assert(range.begin <= range.end && range.end <= m_track_count &&
+            "joint range out of range");
+
+        // Find the segment. The time of the last key pose falls at the end of
+        // the last segment.
+        size_t i_segment = 0;
+        float t = 0.0f;
+        if (m_key_pose_interval > 0) {
+            i_segment = local_time / m_key_pose_interval;
+            t = (float)local_time / m_key_pose_interval - i_segment;
+            if (i_segment >= m_segment_count) {
+                i_segment = m_segment_count - 1;
+                t = m_key_count > 1 ? 1.0f : 0.0f;
+            }
+        }
+
+        const float *joint = m_key_data +
+            _JOINT_SIZE * (m_track_count * i_segment + range.begin);
+
+        float *translation_x = extracted_pose->getStream(Pose::STREAM_TRANSLATION_X);
+        float *translation_y = extracted_pose->getStream(Pose::STREAM_TRANSLATION_Y);
+        float *translation_z = extracted_pose->getStream(Pose::STREAM_TRANSLATION_Z);
+        float *scale = extracted_pose->getStream(Pose::STREAM_SCALE);
+
+        // Walk the segment linearly. The rotations of a block of tracks are
+        // gathered onto the stack and interpolated together.
+        const size_t BLOCK_SIZE = 64;
+        float from_rotations[4][BLOCK_SIZE];
+        float to_rotations[4][BLOCK_SIZE];
+
+        for (size_t i_begin = range.begin; i_begin < range.end;
+            i_begin += BLOCK_SIZE) {
+            const size_t block_count = std::min(BLOCK_SIZE, range.end - i_begin);
+
+            for (size_t i = 0; i < block_count; ++i) {
+                const size_t i_track = i_begin + i;
+                const float *from = joint;
+                const float *to = joint + _TRANSFORM_SIZE;
+
+                for (int i_component = 0; i_component < 4; ++i_component) {
+                    from_rotations[i_component][i] =
+                        from[Pose::STREAM_ROTATION_X + i_component];
+                    to_rotations[i_component][i] =
+                        to[Pose::STREAM_ROTATION_X + i_component];
+                }
+
+                translation_x[i_track] = Math::lerp(t,
+                    from[Pose::STREAM_TRANSLATION_X], to[Pose::STREAM_TRANSLATION_X]);
+                translation_y[i_track] = Math::lerp(t,
+                    from[Pose::STREAM_TRANSLATION_Y], to[Pose::STREAM_TRANSLATION_Y]);
+                translation_z[i_track] = Math::lerp(t,
+                    from[Pose::STREAM_TRANSLATION_Z], to[Pose::STREAM_TRANSLATION_Z]);
+                scale[i_track] = Math::lerp(t, from[Pose::STREAM_SCALE],
+                    to[Pose::STREAM_SCALE]);
+
+                joint += _JOINT_SIZE;
+            }
+
+            const QuaternionBatch::ConstStreams from = {
+                from_rotations[0], from_rotations[1], from_rotations[2], from_rotations[3] };
+            const QuaternionBatch::ConstStreams to = {
+                to_rotations[0], to_rotations[1], to_rotations[2], to_rotations[3] };
+            const QuaternionBatch::Streams result = {
+                extracted_pose->getStream(Pose::STREAM_ROTATION_X) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_Y) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_Z) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_W) + i_begin };
+            QuaternionBatch::slerp(t, block_count, from, to, result);
+        }
+    }
+
+};
\ No newline at end of file
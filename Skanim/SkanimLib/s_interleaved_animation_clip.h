@@ -0,0 +1,152 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_ianimation_clip.h"
+#include "s_pose.h"
+
+namespace Skanim
+{
+    class KeyPoseAnimationClip;
+
+    /** Interleaved animation clip stores the same key pose sequence as a key
+     *  pose animation clip in one contiguous block, laid out for sampling.
+     *  The block is split into segments, one per pair of adjacent key poses.
+     *  Within segment k the transforms of key k and key k + 1 are interleaved
+     *  joint by joint, so extracting a pose reads a single linear run of
+     *  memory. Every inner key is stored twice, which takes about twice the
+     *  memory of the key poses themselves.
+     */
+    class _SKANIM_EXPORT InterleavedAnimationClip : public IAnimationClip
+    {
+    public:
+        /** Convert a key pose animation clip into the interleaved layout.
+         */
+        explicit InterleavedAnimationClip(const KeyPoseAnimationClip &source) noexcept;
+
+        /** Use key data in the interleaved layout which is stored elsewhere,
+         *  for example in a memory mapped asset. Nothing is copied, so the key
+         *  data must outlive the clip. It holds getSegmentCount(key_count)
+         *  segments of getSegmentSize(track_count) floats.
+         */
+        InterleavedAnimationClip(const float *key_data, size_t track_count,
+            size_t key_count, long key_pose_interval, const String &name) noexcept;
+
+        InterleavedAnimationClip(const InterleavedAnimationClip &) = delete;
+
+        InterleavedAnimationClip &operator=(const InterleavedAnimationClip &) = delete;
+
+        /** Get the time length.
+         */
+        virtual long getLength() const override
+        {
+            return m_key_count > 0 ? (m_key_count - 1) * m_key_pose_interval : 0;
+        }
+
+        /** Get the number of tracks
+         */
+        virtual size_t getTrackCount() const override
+        {
+            return m_track_count;
+        }
+
+        /** Extract pose from this clip with local time.
+         */
+        virtual void extractPose(long local_time, Pose *extracted_pose)
+            const override;
+
+        /** Extract the joints in the given ranges from this clip with local
+         *  time.
+         */
+        virtual void extractPose(long local_time, const JointRange *ranges,
+            size_t range_count, Pose *extracted_pose) const override;
+
+        /** Get the number of key poses.
+         */
+        size_t getKeyPoseCount() const
+        {
+            return m_key_count;
+        }
+
+        /** Get key interval.
+         */
+        long getKeyPoseInterval() const
+        {
+            return m_key_pose_interval;
+        }
+
+        /** Get the name of this clip.
+         */
+        const String &getName() const
+        {
+            return m_name;
+        }
+
+        /** Get the key data.
+         */
+        const float *getKeyData() const
+        {
+            return m_key_data;
+        }
+
+        /** Get the number of floats of the key data.
+         */
+        size_t getKeyDataSize() const
+        {
+            return getSegmentCount(m_key_count) * getSegmentSize(m_track_count);
+        }
+
+        /** Get the number of segments of a clip with key_count key poses.
+         */
+        static size_t getSegmentCount(size_t key_count)
+        {
+            // A clip with a single key pose still has one segment, whose both
+            // keys are that key pose.
+            return key_count > 0 ? std::max(key_count - 1, (size_t)1) : 0;
+        }
+
+        /** Get the number of floats of a segment of a clip with track_count
+         *  tracks.
+         */
+        static size_t getSegmentSize(size_t track_count)
+        {
+            return _JOINT_SIZE * track_count;
+        }
+
+    private:
+        // Interpolate the tracks in a range at local time into the pose.
+        void _extractTracks(long local_time, const JointRange &range,
+            Pose *extracted_pose) const;
+
+    private:
+        // The number of floats of a joint transform in the key data, one per
+        // stream of Pose in the same order.
+        static const size_t _TRANSFORM_SIZE = Pose::STREAM_COUNT;
+
+        // The number of floats of a joint in a segment, the transform of the
+        // segment's first key followed by the transform of its second key.
+        static const size_t _JOINT_SIZE = _TRANSFORM_SIZE * 2;
+
+        // The key data owned by this clip. It's empty if the key data is
+        // stored elsewhere.
+        std::vector<float, Allocator<float, MEMORY_CATEGORY_ANIMATION_CLIP>> m_owned_key_data;
+
+        // The key data. Segments are stored one after another, each of them
+        // holds _JOINT_SIZE floats per track.
+        const float *m_key_data;
+
+        // The number of joint tracks.
+        size_t m_track_count;
+
+        // The number of key poses.
+        size_t m_key_count;
+
+        // The number of segments.
+        size_t m_segment_count;
+
+        // The name of this clip
+        String m_name;
+
+        // The time interval between key poses.
+        long m_key_pose_interval;
+    };
+};
\ No newline at end of file
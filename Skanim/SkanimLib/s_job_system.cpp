@@ -0,0 +1,306 @@
+#include "s_precomp.h"
+#include "s_job_system.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // The index of the worker that the current thread belongs to.
+        thread_local size_t _current_worker_index = 0;
+
+        // The number of times an idle worker looks for jobs before it sleeps.
+        const int IDLE_SPIN_COUNT = 256;
+
+        // Keep data written by different threads on different cache lines.
+        const size_t CACHE_LINE_SIZE = 64;
+    }
+
+    // A group of jobs created by a parallelFor() call.
+    struct JobSystem::_JobGroup
+    {
+        _JobFunction function;
+        void *data;
+        size_t grain_size;
+
+        // The number of elements not processed yet.
+        std::atomic<size_t> remaining_count;
+    };
+
+    // A job processes the range [begin, end) of its group.
+    struct JobSystem::_Job
+    {
+        _JobGroup *group;
+        size_t begin;
+        size_t end;
+    };
+
+    // A worker owns a work stealing deque (Chase and Lev, "Dynamic Circular
+    // Work-Stealing Deque", with the memory orders of Le et al., "Correct and
+    // Efficient Work-Stealing for Weak Memory Models"). The owner pushes and
+    // pops at the bottom, other workers steal from the top.
+    struct JobSystem::_Worker
+    {
+        // The maximum number of jobs in a deque. Ranges which don't fit are
+        // run directly instead of being split.
+        static const int64_t CAPACITY = 1024;
+
+        // A deque slot. The fields are atomic since a thief may read a slot
+        // while the owner writes it. The thief discards what it read in that
+        // case because its compare-and-swap on the top fails.
+        struct Slot
+        {
+            std::atomic<_JobGroup*> group;
+            std::atomic<size_t> begin;
+            std::atomic<size_t> end;
+        };
+
+        // Thieves write the top and the owner writes the bottom, pad them
+        // apart.
+        std::atomic<int64_t> top;
+        char top_padding[CACHE_LINE_SIZE];
+        std::atomic<int64_t> bottom;
+        char bottom_padding[CACHE_LINE_SIZE];
+        Slot slots[CAPACITY];
+
+        // The state of the random number generator which picks the victim to
+        // steal from.
+        uint32_t random_state;
+
+        std::thread thread;
+
+        bool push(const _Job &job)
+        {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= CAPACITY)
+                return false;
+
+            Slot &slot = slots[b & (CAPACITY - 1)];
+            slot.group.store(job.group, std::memory_order_relaxed);
+            slot.begin.store(job.begin, std::memory_order_relaxed);
+            slot.end.store(job.end, std::memory_order_relaxed);
+            // Publish the slot and the job group it points to.
+            bottom.store(b + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(_Job *job)
+        {
+            const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+
+            if (t > b) {
+                // The deque is empty.
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            _read(b, job);
+            if (t == b) {
+                // The last job, race against thieves for it.
+                const bool is_won = top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return is_won;
+            }
+            return true;
+        }
+
+        bool steal(_Job *job)
+        {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t b = bottom.load(std::memory_order_acquire);
+
+            if (t >= b)
+                return false;
+
+            _read(t, job);
+            return top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        void _read(int64_t index, _Job *job) const
+        {
+            const Slot &slot = slots[index & (CAPACITY - 1)];
+            job->group = slot.group.load(std::memory_order_relaxed);
+            job->begin = slot.begin.load(std::memory_order_relaxed);
+            job->end = slot.end.load(std::memory_order_relaxed);
+        }
+    };
+
+    JobSystem::JobSystem(size_t worker_thread_count) noexcept
+        : m_is_running(true),
+          m_wake_epoch(0),
+          m_sleeping_count(0)
+    {
+        if (worker_thread_count == AUTO_WORKER_THREAD_COUNT) {
+            const size_t hardware_thread_count = std::thread::hardware_concurrency();
+            worker_thread_count = hardware_thread_count > 1 ?
+                hardware_thread_count - 1 : 0;
+        }
+
+        m_workers.resize(worker_thread_count + 1);
+        for (size_t i_worker = 0; i_worker < m_workers.size(); ++i_worker) {
+            _Worker *worker = new _Worker;
+            worker->top.store(0, std::memory_order_relaxed);
+            worker->bottom.store(0, std::memory_order_relaxed);
+            worker->random_state = (uint32_t)i_worker * 2654435761u + 1;
+            m_workers[i_worker] = worker;
+        }
+
+        // Start the threads after all the workers exist, since they steal
+        // from each other right away.
+        for (size_t i_worker = 1; i_worker < m_workers.size(); ++i_worker) {
+            m_workers[i_worker]->thread =
+                std::thread(&JobSystem::_workerMain, this, i_worker);
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        m_is_running.store(false);
+        _wakeWorkers();
+
+        for (size_t i_worker = 1; i_worker < m_workers.size(); ++i_worker)
+            m_workers[i_worker]->thread.join();
+
+        for (auto worker : m_workers)
+            delete worker;
+    }
+
+    size_t JobSystem::getCurrentWorkerIndex()
+    {
+        return _current_worker_index;
+    }
+
+    void JobSystem::_parallelFor(size_t count, size_t grain_size,
+        _JobFunction function, void *data)
+    {
+        if (count == 0)
+            return;
+
+        grain_size = std::max<size_t>(grain_size, 1);
+
+        // Don't bother scheduling a range that wouldn't be split.
+        if (count <= grain_size || m_workers.size() == 1) {
+            function(data, 0, count);
+            return;
+        }
+
+        _JobGroup group;
+        group.function = function;
+        group.data = data;
+        group.grain_size = grain_size;
+        group.remaining_count.store(count, std::memory_order_relaxed);
+
+        _wakeWorkers();
+
+        _Worker *worker = m_workers[_current_worker_index];
+        const _Job root_job = { &group, 0, count };
+        _execute(worker, root_job);
+
+        // Help with any job, not only the ones of this group, until the group
+        // is done. Jobs of other groups are usually the parents of a nested
+        // parallelFor() which would be blocked otherwise.
+        while (group.remaining_count.load(std::memory_order_acquire) > 0) {
+            _Job job;
+            if (_findJob(worker, &job))
+                _execute(worker, job);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void JobSystem::_execute(_Worker *worker, const _Job &job)
+    {
+        _JobGroup *group = job.group;
+
+        // Keep the first half and push the second half so idle workers could
+        // steal it.
+        _Job current_job = job;
+        while (current_job.end - current_job.begin > group->grain_size) {
+            const size_t middle = current_job.begin +
+                (current_job.end - current_job.begin) / 2;
+            const _Job second_half = { group, middle, current_job.end };
+            if (!worker->push(second_half))
+                break;
+            current_job.end = middle;
+        }
+
+        group->function(group->data, current_job.begin, current_job.end);
+
+        group->remaining_count.fetch_sub(current_job.end - current_job.begin,
+            std::memory_order_acq_rel);
+    }
+
+    bool JobSystem::_findJob(_Worker *worker, _Job *job)
+    {
+        if (worker->pop(job))
+            return true;
+
+        // Steal from the others, starting from a random one.
+        const size_t worker_count = m_workers.size();
+        uint32_t &random_state = worker->random_state;
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+
+        const size_t first_victim = random_state % worker_count;
+        for (size_t i = 0; i < worker_count; ++i) {
+            _Worker *victim = m_workers[(first_victim + i) % worker_count];
+            if (victim != worker && victim->steal(job))
+                return true;
+        }
+        return false;
+    }
+
+    void JobSystem::_workerMain(size_t worker_index)
+    {
+        _current_worker_index = worker_index;
+
+        _Worker *worker = m_workers[worker_index];
+
+        while (m_is_running.load(std::memory_order_relaxed)) {
+            const uint32_t wake_epoch = m_wake_epoch.load();
+
+            _Job job;
+            bool is_job_found = false;
+            for (int i_spin = 0; i_spin < IDLE_SPIN_COUNT; ++i_spin) {
+                is_job_found = _findJob(worker, &job);
+                if (is_job_found)
+                    break;
+                std::this_thread::yield();
+            }
+
+            if (is_job_found) {
+                _execute(worker, job);
+                continue;
+            }
+
+            // Sleep until the next parallelFor() or the destruction.
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            ++m_sleeping_count;
+            m_sleep_condition.wait(lock, [&]() {
+                return m_wake_epoch.load() != wake_epoch ||
+                    !m_is_running.load();
+            });
+            --m_sleeping_count;
+        }
+    }
+
+    void JobSystem::_wakeWorkers()
+    {
+        ++m_wake_epoch;
+
+        // Only take the lock if someone is sleeping, so the hot path stays
+        // lock free.
+        if (m_sleeping_count.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_sleep_condition.notify_all();
+        }
+    }
+
+};
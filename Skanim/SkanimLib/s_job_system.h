@@ -0,0 +1,115 @@
+#pragma once
+
+#include "s_prerequisites.h"
+
+namespace Skanim
+{
+    /** Job system runs jobs on a pool of worker threads with work stealing.
+     *  Every thread has its own job deque. A thread pushes and pops jobs at the
+     *  bottom of its own deque, and idle threads steal jobs from the top of the
+     *  others' deques. The deques are lock free, so scheduling a job never
+     *  takes a lock. Idle workers go to sleep after a while and are woken up
+     *  by the next parallelFor().
+     *  The thread which creates the job system takes part in the work as
+     *  worker 0. Only that thread and the jobs themselves may call
+     *  parallelFor(), so parallelFor() could be nested.
+     *  Jobs allocate from the global alloc manager like any other code. Install
+     *  a ThreadCachingAllocManager as the global alloc manager to keep the
+     *  workers from contending for it.
+     */
+    class _SKANIM_EXPORT JobSystem
+    {
+    public:
+        /** Use one worker thread per hardware thread, except the one that the
+         *  calling thread runs on.
+         */
+        static const size_t AUTO_WORKER_THREAD_COUNT = (size_t)-1;
+
+        /** Construct a job system and start its worker threads.
+         *  @param worker_thread_count The number of threads created besides
+         *  the calling thread. With 0 every job runs on the calling thread.
+         */
+        explicit JobSystem(size_t worker_thread_count = AUTO_WORKER_THREAD_COUNT) noexcept;
+
+        /** Stop and join all the worker threads.
+         */
+        ~JobSystem();
+
+        JobSystem(const JobSystem &) = delete;
+
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        /** Get the number of workers, including the thread that created the
+         *  job system.
+         */
+        size_t getWorkerCount() const
+        {
+            return m_workers.size();
+        }
+
+        /** Get the index of the worker which the calling thread belongs to.
+         *  Threads which aren't worker threads get 0.
+         */
+        static size_t getCurrentWorkerIndex();
+
+        /** Call function(begin, end) on sub-ranges of [0, count) in parallel
+         *  and wait until all of them are done. Ranges are split in halves
+         *  until they are no larger than grain_size, and the calling thread
+         *  runs jobs while waiting.
+         */
+        template <typename F>
+        void parallelFor(size_t count, size_t grain_size, const F &function)
+        {
+            _parallelFor(count, grain_size, &_invoke<F>,
+                const_cast<void*>(static_cast<const void*>(&function)));
+        }
+
+    private:
+        struct _Worker;
+        struct _JobGroup;
+        struct _Job;
+
+        typedef void (*_JobFunction)(void *data, size_t begin, size_t end);
+
+        template <typename F>
+        static void _invoke(void *data, size_t begin, size_t end)
+        {
+            (*static_cast<const F*>(data))(begin, end);
+        }
+
+        // Run a parallel for over [0, count) and wait for it.
+        void _parallelFor(size_t count, size_t grain_size, _JobFunction function,
+            void *data);
+
+        // Run a job on a worker. The job's range is split and the halves are
+        // pushed to the worker's deque until it's small enough.
+        void _execute(_Worker *worker, const _Job &job);
+
+        // Find a job in the worker's own deque or steal one from the others.
+        bool _findJob(_Worker *worker, _Job *job);
+
+        // The loop of the worker threads.
+        void _workerMain(size_t worker_index);
+
+        // Wake up all the sleeping workers.
+        void _wakeWorkers();
+
+    private:
+        // All the workers. Worker 0 is the thread that created the job system
+        // and has no thread of its own.
+        vector<_Worker*> m_workers;
+
+        // Whether the worker threads should keep running.
+        std::atomic<bool> m_is_running;
+
+        // Increased every time sleeping workers are woken up.
+        std::atomic<uint32_t> m_wake_epoch;
+
+        // The number of sleeping workers.
+        std::atomic<uint32_t> m_sleeping_count;
+
+        // Sleeping workers wait on this condition variable.
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_sleep_condition;
+    };
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "s_precomp.h"
+#include "s_prerequisites.h"
+
+namespace Skanim
+{
+    /** Joint id is the hash of a joint's name, which looks up a joint in a
+     *  skeleton definition without hashing the name again. Ids of string
+     *  literals are computed at compile time:
+     *
+     *      constexpr JointId HAND_ID(L"hand_r");
+     *
+     *  The hash is 32-bit FNV-1a over the name's characters. The names of the
+     *  joints in a definition must have distinct ids.
+     */
+    class JointId
+    {
+    public:
+
+        /** Construct the id of an empty name.
+         */
+        constexpr JointId() noexcept
+            : m_hash(FNV_OFFSET_BASIS)
+        {}
+
+        /** Construct the id of a null terminated name.
+         */
+        constexpr explicit JointId(const wchar_t *name) noexcept
+            : m_hash(_hash(name, FNV_OFFSET_BASIS))
+        {}
+
+        /** Construct the id of a name.
+         */
+        explicit JointId(const String &name) noexcept
+            : JointId(name.data(), name.size())
+        {}
+
+        /** Construct the id of a name of length characters, which needn't be
+         *  null terminated.
+         */
+        JointId(const String::value_type *name, size_t length) noexcept
+            : m_hash(FNV_OFFSET_BASIS)
+        {
+            for (size_t i = 0; i < length; ++i)
+                m_hash = (m_hash ^ (uint32_t)name[i]) * FNV_PRIME;
+        }
+
+        /** Get the hash of the name.
+         */
+        constexpr uint32_t getHash() const
+        {
+            return m_hash;
+        }
+
+        constexpr bool operator==(const JointId &other) const
+        {
+            return m_hash == other.m_hash;
+        }
+
+        constexpr bool operator!=(const JointId &other) const
+        {
+            return m_hash != other.m_hash;
+        }
+
+    private:
+
+        static constexpr uint32_t FNV_OFFSET_BASIS = 2166136261u;
+        static constexpr uint32_t FNV_PRIME = 16777619u;
+
+        // Hash the rest of a name, it's recursive to be a C++11 constexpr.
+        static constexpr uint32_t _hash(const wchar_t *name, uint32_t hash)
+        {
+            return *name == 0 ? hash :
+                _hash(name + 1, (hash ^ (uint32_t)*name) * FNV_PRIME);
+        }
+
+    private:
+        uint32_t m_hash;
+    };
+};
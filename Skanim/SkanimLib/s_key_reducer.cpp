@@ -0,0 +1,161 @@
+#include "s_precomp.h"
+#include "s_key_reducer.h"
+#include "s_animation_clip.h"
+#include "s_joint.h"
+#include "s_skeleton_definition.h"
+
+namespace Skanim
+{
+    KeyReducer::KeyReducer(const SkeletonDefinition &skeleton, float tolerance,
+        float min_shell_distance) noexcept
+        : m_parent_indices(skeleton.getJointCount()),
+          m_joint_tolerances(skeleton.getJointCount(), tolerance),
+          m_min_shell_distance(min_shell_distance)
+    {
+        assert(tolerance >= 0.0f && "tolerance is negative");
+
+        for (size_t i_joint = 0; i_joint < m_parent_indices.size(); ++i_joint)
+            m_parent_indices[i_joint] = skeleton.getParentIndex(i_joint);
+    }
+
+    VariableRateAnimationClip KeyReducer::reduce(
+        const KeyPoseAnimationClip &source) const
+    {
+        const size_t track_count = source.getTrackCount();
+        const size_t key_count = source.getKeyPoseCount();
+        const long interval = source.getKeyPoseInterval();
+
+        assert(track_count <= m_parent_indices.size() &&
+            "the clip has more tracks than the skeleton's joints");
+        assert(key_count > 0 && "no key pose in the clip");
+
+        VariableRateAnimationClip reduced(track_count, source.getName(),
+            source.getLength());
+
+        // Unpack the key poses and calculate the exact global transforms of
+        // every key. Joints are stored in pre-order, so parents always come
+        // before their children.
+        vector<Transform> lcl_transforms(key_count * track_count);
+        vector<Transform> glb_transforms(key_count * track_count);
+        for (size_t i_key = 0; i_key < key_count; ++i_key) {
+            const Pose key_pose = source.getKeyPose(i_key);
+            Transform *lcl_key = &lcl_transforms[i_key * track_count];
+            Transform *glb_key = &glb_transforms[i_key * track_count];
+
+            for (size_t i_track = 0; i_track < track_count; ++i_track) {
+                lcl_key[i_track] = key_pose.getJointTransform(i_track);
+
+                const int parent_index = m_parent_indices[i_track];
+                glb_key[i_track] = parent_index == Joint::INDEX_NULL ?
+                    lcl_key[i_track] :
+                    Transform::combine(lcl_key[i_track], glb_key[parent_index]);
+            }
+        }
+
+        vector<float> shell_distances;
+        _calculateShellDistances(glb_transforms.data(), track_count,
+            &shell_distances);
+
+        vector<Transform> keys;
+        vector<long> key_times;
+        for (size_t i_track = 0; i_track < track_count; ++i_track) {
+            const int parent_index = m_parent_indices[i_track];
+            const float tolerance = m_joint_tolerances[i_track];
+            const float shell_distance = shell_distances[i_track];
+
+            // Check if the keys between first_key and last_key could be removed
+            // and replaced with the interpolation of those two keys.
+            auto is_segment_valid = [&](size_t first_key, size_t last_key)
+            {
+                const Transform &from = lcl_transforms[first_key * track_count + i_track];
+                const Transform &to = lcl_transforms[last_key * track_count + i_track];
+
+                for (size_t i_key = first_key + 1; i_key < last_key; ++i_key) {
+                    const float t = (float)(i_key - first_key) / (last_key - first_key);
+                    // Interpolate the same way as the reduced clip does.
+                    const Transform lcl_reduced = Transform::lerp(t, from, to,
+                        QuaternionBatch::MODE_SLERP_FAST);
+
+                    const size_t i_transform = i_key * track_count + i_track;
+                    // The error of this joint alone, measured under its exact
+                    // parent.
+                    const Transform glb_reduced = parent_index == Joint::INDEX_NULL ?
+                        lcl_reduced :
+                        Transform::combine(lcl_reduced,
+                            glb_transforms[i_key * track_count + parent_index]);
+
+                    if (_measureError(glb_transforms[i_transform], glb_reduced,
+                        shell_distance) > tolerance)
+                        return false;
+                }
+                return true;
+            };
+
+            keys.clear();
+            key_times.clear();
+            keys.push_back(lcl_transforms[i_track]);
+            key_times.push_back(0);
+
+            // Extend each segment greedily as far as the tolerance allows, then
+            // start the next segment from its end key.
+            const size_t last_key = key_count - 1;
+            size_t segment_begin = 0;
+            while (segment_begin < last_key) {
+                size_t segment_end = segment_begin + 1;
+                while (segment_end < last_key &&
+                    is_segment_valid(segment_begin, segment_end + 1))
+                    ++segment_end;
+
+                keys.push_back(lcl_transforms[segment_end * track_count + i_track]);
+                key_times.push_back((long)segment_end * interval);
+                segment_begin = segment_end;
+            }
+
+            reduced.setTrack(i_track, Track(keys, key_times));
+        }
+
+        return reduced;
+    }
+
+    void KeyReducer::_calculateShellDistances(const Transform *glb_transforms,
+        size_t joint_count, vector<float> *shell_distances) const
+    {
+        // Visit children before their parents and accumulate the distance to
+        // the farthest descendant.
+        vector<float> &distances = *shell_distances;
+        distances.assign(joint_count, 0.0f);
+        for (size_t i_joint = joint_count; i_joint-- > 0;) {
+            const int parent_index = m_parent_indices[i_joint];
+            if (parent_index == Joint::INDEX_NULL)
+                continue;
+
+            const float distance = (glb_transforms[i_joint].getTranslation() -
+                glb_transforms[parent_index].getTranslation()).magnitude();
+            distances[parent_index] = std::max(distances[parent_index],
+                distance + distances[i_joint]);
+        }
+
+        for (auto &distance : distances)
+            distance = std::max(distance, m_min_shell_distance);
+    }
+
+    float KeyReducer::_measureError(const Transform &exact, const Transform &reduced,
+        float shell_distance)
+    {
+        // Shell points are given in the joint's space, so divide out its scale
+        // to keep the shell radius in world units.
+        const float radius = shell_distance / exact.getScale();
+
+        float max_error = (exact.getTranslation() - reduced.getTranslation()).magnitude();
+        for (int i_axis = 0; i_axis < 3; ++i_axis) {
+            Vector3 point = Vector3::ZERO();
+            point[i_axis] = radius;
+
+            const float error = (exact.transformPoint(point) -
+                reduced.transformPoint(point)).magnitude();
+            max_error = std::max(max_error, error);
+        }
+        return max_error;
+    }
+
+};
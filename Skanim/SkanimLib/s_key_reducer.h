@@ -0,0 +1,85 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_transform.h"
+#include "s_variable_rate_animation_clip.h"
+
+namespace Skanim
+{
+    class KeyPoseAnimationClip;
+    class SkeletonDefinition;
+
+    /** Key reducer removes keys from a key pose animation clip and produces a
+     *  variable rate animation clip which keeps each joint within its error
+     *  tolerance. The error is measured in world space through the skeleton's
+     *  hierarchy. Each joint is surrounded by a shell which contains all of its
+     *  descendants, and the error of a key is the largest distance between the
+     *  exact and the reduced positions of the joint and its shell points. So a
+     *  small rotation error on a joint with a long chain of children is weighted
+     *  by the length of that chain.
+     *  The reduction is an offline process.
+     */
+    class _SKANIM_EXPORT KeyReducer
+    {
+    public:
+        /** Construct a key reducer for clips of the given skeleton.
+         *  @param tolerance The default error tolerance of all joints, in world
+         *  space units.
+         *  @param min_shell_distance The minimum radius of a joint's shell in
+         *  world space units. It keeps the rotations of leaf joints from being
+         *  reduced without limit, a value near the size of a skinned vertex's
+         *  distance from its joint works well.
+         */
+        KeyReducer(const SkeletonDefinition &skeleton, float tolerance,
+            float min_shell_distance) noexcept;
+
+        /** Get the error tolerance of a joint.
+         */
+        float getJointTolerance(size_t joint_index) const
+        {
+            assert(joint_index < m_joint_tolerances.size() &&
+                "joint index out of range");
+
+            return m_joint_tolerances[joint_index];
+        }
+
+        /** Modify the error tolerance of a joint. Joints which need to be
+         *  precise like hands and the head could have smaller tolerances.
+         */
+        void setJointTolerance(size_t joint_index, float tolerance)
+        {
+            assert(joint_index < m_joint_tolerances.size() &&
+                "joint index out of range");
+            assert(tolerance >= 0.0f && "tolerance is negative");
+
+            m_joint_tolerances[joint_index] = tolerance;
+        }
+
+        /** Reduce the keys of a key pose animation clip. The first and the last
+         *  key poses are always kept. The track count of the source clip can't
+         *  exceed the joint count of the skeleton, and track i animates joint i.
+         */
+        VariableRateAnimationClip reduce(const KeyPoseAnimationClip &source) const;
+
+    private:
+        // Calculate the world space shell radius of every joint from a pose of
+        // exact global transforms.
+        void _calculateShellDistances(const Transform *glb_transforms,
+            size_t joint_count, vector<float> *shell_distances) const;
+
+        // Get the largest world space distance between the shell points of two
+        // global transforms.
+        static float _measureError(const Transform &exact, const Transform &reduced,
+            float shell_distance);
+
+    private:
+        // The parent index of each joint.
+        vector<int> m_parent_indices;
+
+        // The error tolerance of each joint.
+        vector<float> m_joint_tolerances;
+
+        // The minimum shell radius.
+        float m_min_shell_distance;
+    };
+};
@@ -3,12 +3,14 @@
 #include "s_precomp.h"
 #include "s_prerequisites.h"
 #include "s_quaternion.h"
+#include "s_simd.h"
 #include "s_vector3.h"
 #include "s_vector4.h"
 
 namespace Skanim
 {
 	/** 4x4 row major uniform scale affine transform matrix class.
+	 *  Matrices are 16 bytes aligned so each row fits in a SSE register.
 	 */
 	class _SKANIM_EXPORT MatrixUA4
 	{
@@ -46,6 +48,58 @@ namespace Skanim
 		 */
 		MatrixUA4 operator*(const MatrixUA4 &rhs) const
 		{
+#if defined(SKANIM_SIMD_AVX)
+			// Two rows at a time. Each row of the result is the sum of rhs's
+			// rows weighted by this row's elements.
+			const __m256 rhs_row0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(rhs.m_a[0]));
+			const __m256 rhs_row1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(rhs.m_a[1]));
+			const __m256 rhs_row2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(rhs.m_a[2]));
+			const __m256 rhs_row3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(rhs.m_a[3]));
+			const __m256 mask_xyz = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+
+			const __m256 rows01 = _mm256_loadu_ps(m_a[0]);
+			const __m256 rows23 = _mm256_loadu_ps(m_a[2]);
+
+			__m256 result01 = _mm256_mul_ps(_mm256_shuffle_ps(rows01, rows01, _MM_SHUFFLE(0, 0, 0, 0)), rhs_row0);
+			result01 = _mm256_add_ps(result01, _mm256_mul_ps(_mm256_shuffle_ps(rows01, rows01, _MM_SHUFFLE(1, 1, 1, 1)), rhs_row1));
+			result01 = _mm256_add_ps(result01, _mm256_mul_ps(_mm256_shuffle_ps(rows01, rows01, _MM_SHUFFLE(2, 2, 2, 2)), rhs_row2));
+			result01 = _mm256_and_ps(result01, mask_xyz);
+
+			__m256 result23 = _mm256_mul_ps(_mm256_shuffle_ps(rows23, rows23, _MM_SHUFFLE(0, 0, 0, 0)), rhs_row0);
+			result23 = _mm256_add_ps(result23, _mm256_mul_ps(_mm256_shuffle_ps(rows23, rows23, _MM_SHUFFLE(1, 1, 1, 1)), rhs_row1));
+			result23 = _mm256_add_ps(result23, _mm256_mul_ps(_mm256_shuffle_ps(rows23, rows23, _MM_SHUFFLE(2, 2, 2, 2)), rhs_row2));
+			// Only the last row takes rhs's translation.
+			result23 = _mm256_add_ps(result23, _mm256_blend_ps(_mm256_setzero_ps(), rhs_row3, 0xf0));
+			result23 = _mm256_and_ps(result23, mask_xyz);
+			result23 = _mm256_or_ps(result23, _mm256_setr_ps(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f));
+
+			MatrixUA4 result;
+			_mm256_storeu_ps(result.m_a[0], result01);
+			_mm256_storeu_ps(result.m_a[2], result23);
+			return result;
+#elif defined(SKANIM_SIMD_SSE)
+			// Each row of the result is the sum of rhs's rows weighted by this
+			// row's elements.
+			const __m128 rhs_row0 = _mm_loadu_ps(rhs.m_a[0]);
+			const __m128 rhs_row1 = _mm_loadu_ps(rhs.m_a[1]);
+			const __m128 rhs_row2 = _mm_loadu_ps(rhs.m_a[2]);
+			const __m128 rhs_row3 = _mm_loadu_ps(rhs.m_a[3]);
+			const __m128 mask_xyz = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+
+			MatrixUA4 result;
+			for (int r = 0; r < 4; ++r) {
+				const __m128 row = _mm_loadu_ps(m_a[r]);
+				__m128 result_row = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), rhs_row0);
+				result_row = _mm_add_ps(result_row, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), rhs_row1));
+				result_row = _mm_add_ps(result_row, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), rhs_row2));
+				_mm_storeu_ps(result.m_a[r], _mm_and_ps(result_row, mask_xyz));
+			}
+
+			// Only the last row takes rhs's translation.
+			const __m128 row3 = _mm_add_ps(_mm_loadu_ps(result.m_a[3]), _mm_and_ps(rhs_row3, mask_xyz));
+			_mm_storeu_ps(result.m_a[3], _mm_or_ps(row3, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f)));
+			return result;
+#else
 			return MatrixUA4(
 				m_a[0][0] * rhs.m_a[0][0] + m_a[0][1] * rhs.m_a[1][0] + m_a[0][2] * rhs.m_a[2][0],
 				m_a[0][0] * rhs.m_a[0][1] + m_a[0][1] * rhs.m_a[1][1] + m_a[0][2] * rhs.m_a[2][1],
@@ -67,6 +121,7 @@ namespace Skanim
 				m_a[3][0] * rhs.m_a[0][2] + m_a[3][1] * rhs.m_a[1][2] + m_a[3][2] * rhs.m_a[2][2] + rhs.m_a[3][2],
 				1.0f
 				);
+#endif
 		}
 
 		/** Affine transform matrices multiplication.
@@ -346,7 +401,7 @@ namespace Skanim
 				float m_30, m_31, m_32, m_33;
 			};
 
-			float m_a[4][4];
+			alignas(16) float m_a[4][4];
 		};
 	};
 };
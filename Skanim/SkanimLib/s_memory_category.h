@@ -0,0 +1,24 @@
+#pragma once
+
+namespace Skanim
+{
+    /** Memory categories group the allocations of a subsystem, so that each
+     *  subsystem could use its own alloc manager.
+     *  @see MemoryConfig::setCategoryAllocManager()
+     */
+    enum MemoryCategory
+    {
+        // Everything not in another category.
+        MEMORY_CATEGORY_GENERAL,
+        // The transform streams of poses.
+        MEMORY_CATEGORY_POSE,
+        // The joints of skeletons.
+        MEMORY_CATEGORY_SKELETON,
+        // Strings.
+        MEMORY_CATEGORY_STRING,
+        // The key data of animation clips.
+        MEMORY_CATEGORY_ANIMATION_CLIP,
+
+        MEMORY_CATEGORY_COUNT
+    };
+};
\ No newline at end of file
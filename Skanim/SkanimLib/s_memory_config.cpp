@@ -5,4 +5,7 @@ namespace Skanim
 {
     // Initialize the global alloc manager to nullptr.
     IAllocManager *MemoryConfig::_alloc_manager = nullptr;
+
+    // No category has its own alloc manager initially.
+    IAllocManager *MemoryConfig::_category_alloc_managers[MEMORY_CATEGORY_COUNT] = {};
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "s_ialloc_manager.h"
+#include "s_memory_category.h"
 
 namespace Skanim
 {
@@ -17,19 +18,93 @@ namespace Skanim
         */
         MemoryConfig(const MemoryConfig &) = delete;
 
-        /** Allocate a block of memory.
+        /** Allocate a block of memory of the general category.
          */
         static void *_malloc(size_t n_bytes, const wchar_t *file = nullptr, 
             int line = 0, const wchar_t *func = nullptr)
         {
-            return _alloc_manager->allocateBytes(n_bytes, file, line, func);
+            return _malloc(n_bytes, MEMORY_CATEGORY_GENERAL, file, line, func);
         }
 
         /** Free the memory allocated by _malloc()
          */
         static void _free(void *ptr)
         {
-            _alloc_manager->deallocateBytes(ptr);
+            _free(ptr, MEMORY_CATEGORY_GENERAL);
+        }
+
+        /** Allocate a block of memory of the general category aligned to
+         *  alignment.
+         */
+        static void *_mallocAligned(size_t n_bytes, size_t alignment,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr)
+        {
+            return _mallocAligned(n_bytes, alignment, MEMORY_CATEGORY_GENERAL,
+                file, line, func);
+        }
+
+        /** Free the memory allocated by _mallocAligned()
+         */
+        static void _freeAligned(void *ptr)
+        {
+            _freeAligned(ptr, MEMORY_CATEGORY_GENERAL);
+        }
+
+        /** Allocate a block of memory of a category.
+         */
+        static void *_malloc(size_t n_bytes, MemoryCategory category,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr)
+        {
+            return getAllocManager(category)->allocateBytes(n_bytes, file, line, func);
+        }
+
+        /** Free the memory allocated by _malloc() with a category.
+         */
+        static void _free(void *ptr, MemoryCategory category)
+        {
+            getAllocManager(category)->deallocateBytes(ptr);
+        }
+
+        /** Allocate a block of memory of a category aligned to alignment.
+         */
+        static void *_mallocAligned(size_t n_bytes, size_t alignment,
+            MemoryCategory category, const wchar_t *file = nullptr,
+            int line = 0, const wchar_t *func = nullptr)
+        {
+            return getAllocManager(category)->allocateAlignedBytes(n_bytes,
+                alignment, file, line, func);
+        }
+
+        /** Free the memory allocated by _mallocAligned() with a category.
+         */
+        static void _freeAligned(void *ptr, MemoryCategory category)
+        {
+            getAllocManager(category)->deallocateAlignedBytes(ptr);
+        }
+
+        /** Allocate memory for n objects of type T, aligned to alignof(T).
+         */
+        template <typename T>
+        static void *_allocate_T(size_t n, const wchar_t *file = nullptr,
+            int line = 0, const wchar_t *func = nullptr)
+        {
+            if (alignof(T) > IAllocManager::DEFAULT_ALIGNMENT)
+                return _mallocAligned(sizeof(T) * n, alignof(T), file, line, func);
+            else
+                return _malloc(sizeof(T) * n, file, line, func);
+        }
+
+        /** Free the memory allocated by _allocate_T().
+         */
+        template <typename T>
+        static void _deallocate_T(void *ptr)
+        {
+            if (alignof(T) > IAllocManager::DEFAULT_ALIGNMENT)
+                _freeAligned(ptr);
+            else
+                _free(ptr);
         }
 
         /** Allocate memory and construct object T.
@@ -38,7 +113,7 @@ namespace Skanim
         static void *_new_T(const wchar_t *file = nullptr, int line = 0, 
             const wchar_t *func = nullptr)
         {
-            return new (_alloc_manager->allocateBytes(sizeof(T), file, line, func)) T;
+            return new (_allocate_T<T>(1, file, line, func)) T;
         }
 
         /** Destroy object T and deallocate memory.
@@ -48,7 +123,54 @@ namespace Skanim
         {
             if (ptr) {
                 static_cast<T*>(ptr)->~T();
-                _alloc_manager->deallocateBytes(ptr);
+                _deallocate_T<T>(ptr);
+            }
+        }
+
+        /** Allocate memory of a category for n objects of type T, aligned to
+         *  alignof(T).
+         */
+        template <typename T>
+        static void *_allocate_T(size_t n, MemoryCategory category,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr)
+        {
+            if (alignof(T) > IAllocManager::DEFAULT_ALIGNMENT)
+                return _mallocAligned(sizeof(T) * n, alignof(T), category,
+                    file, line, func);
+            else
+                return _malloc(sizeof(T) * n, category, file, line, func);
+        }
+
+        /** Free the memory allocated by _allocate_T() with a category.
+         */
+        template <typename T>
+        static void _deallocate_T(void *ptr, MemoryCategory category)
+        {
+            if (alignof(T) > IAllocManager::DEFAULT_ALIGNMENT)
+                _freeAligned(ptr, category);
+            else
+                _free(ptr, category);
+        }
+
+        /** Allocate memory of a category and construct object T.
+         */
+        template <typename T>
+        static void *_new_T(MemoryCategory category,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr)
+        {
+            return new (_allocate_T<T>(1, category, file, line, func)) T;
+        }
+
+        /** Destroy object T and deallocate memory of a category.
+         */
+        template <typename T>
+        static void _delete_T(void *ptr, MemoryCategory category)
+        {
+            if (ptr) {
+                static_cast<T*>(ptr)->~T();
+                _deallocate_T<T>(ptr, category);
             }
         }
 
@@ -58,7 +180,7 @@ namespace Skanim
         static void *_new_array_T(size_t n, const wchar_t *file = nullptr, 
             int line = 0, const wchar_t *func = nullptr)
         {
-            void *ptr = _alloc_manager->allocateBytes(sizeof(T) * n, file, line, func);
+            void *ptr = _allocate_T<T>(n, file, line, func);
             T *ptrT = static_cast<T*>(ptr);
             // Construct all the objects with placement new.
             for (size_t i = 0; i < n; ++i)
@@ -77,7 +199,7 @@ namespace Skanim
                 for (size_t i = 0; i < n; ++i)
                     (ptrT + i)->~T();
 
-                _alloc_manager->deallocateBytes(ptr);
+                _deallocate_T<T>(ptr);
             }
         }
 
@@ -97,12 +219,53 @@ namespace Skanim
             return _alloc_manager;
         }
 
+        /** Get the alloc manager used by the allocations without a category
+         *  manager, which is the global alloc manager.
+         */
+        static IAllocManager *getAllocManager()
+        {
+            return _alloc_manager;
+        }
+
+        /** Set the alloc manager of a memory category, which overrides the
+         *  global alloc manager for the allocations of that category. Set it
+         *  to nullptr to use the global one again. It must not change while
+         *  memory of the category is allocated.
+         */
+        static void setCategoryAllocManager(MemoryCategory category,
+            IAllocManager *manager)
+        {
+            assert(category < MEMORY_CATEGORY_COUNT && "category out of range");
+            _category_alloc_managers[category] = manager;
+        }
+
+        /** Get the alloc manager of a memory category, or nullptr if the
+         *  category uses the global alloc manager.
+         */
+        static IAllocManager *getCategoryAllocManager(MemoryCategory category)
+        {
+            assert(category < MEMORY_CATEGORY_COUNT && "category out of range");
+            return _category_alloc_managers[category];
+        }
+
+        /** Get the alloc manager used by a memory category.
+         */
+        static IAllocManager *getAllocManager(MemoryCategory category)
+        {
+            IAllocManager *category_manager = getCategoryAllocManager(category);
+            return category_manager ? category_manager : getAllocManager();
+        }
+
     private:
 
         // The alloc manager that be used globally to allocate and free 
         // physical memory.
         static IAllocManager *_alloc_manager;
 
+        // The alloc managers of the memory categories, nullptr for the
+        // categories which don't have their own.
+        static IAllocManager *_category_alloc_managers[MEMORY_CATEGORY_COUNT];
+
     };
 };
 
@@ -112,23 +275,66 @@ namespace Skanim
 
 /** Allocate a block of memory.
  */
-#   define SKANIM_MALLOC(n) Skanim::MemoryConfig::_malloc(n, __FILEW__, __LINE__, __FUNCTIONW__)
+#   define SKANIM_MALLOC(n) Skanim::MemoryConfig::_malloc(n, _SKANIM_CALL_SITE)
 
 /** Free a block of memory allocated by SKANIM_MALLOC
  */
 #   define SKANIM_FREE(p) Skanim::MemoryConfig::_free(p)
 
+/** Allocate a block of memory aligned to alignment, which must be a power of
+ *  two.
+ */
+#   define SKANIM_MALLOC_ALIGNED(n, alignment) Skanim::MemoryConfig::_mallocAligned(n, alignment, _SKANIM_CALL_SITE)
+
+/** Free a block of memory allocated by SKANIM_MALLOC_ALIGNED
+ */
+#   define SKANIM_FREE_ALIGNED(p) Skanim::MemoryConfig::_freeAligned(p)
+
+/** Allocate a block of memory of a memory category.
+ */
+#   define SKANIM_MALLOC_CATEGORY(n, category) Skanim::MemoryConfig::_malloc(n, category, _SKANIM_CALL_SITE)
+
+/** Free a block of memory allocated by SKANIM_MALLOC_CATEGORY
+ */
+#   define SKANIM_FREE_CATEGORY(p, category) Skanim::MemoryConfig::_free(p, category)
+
+/** Allocate a block of memory of a memory category aligned to alignment.
+ */
+#   define SKANIM_MALLOC_ALIGNED_CATEGORY(n, alignment, category) Skanim::MemoryConfig::_mallocAligned(n, alignment, category, _SKANIM_CALL_SITE)
+
+/** Free a block of memory allocated by SKANIM_MALLOC_ALIGNED_CATEGORY
+ */
+#   define SKANIM_FREE_ALIGNED_CATEGORY(p, category) Skanim::MemoryConfig::_freeAligned(p, category)
+
 /** Allocate and construct object of type T.
  */
-#   define SKANIM_NEW_T(T) static_cast<T*>(Skanim::MemoryConfig::_new_T<T>(__FILEW__, __LINE__, __FUNCTIONW__))
+#   define SKANIM_NEW_T(T) static_cast<T*>(Skanim::MemoryConfig::_new_T<T>(_SKANIM_CALL_SITE))
 
 /** Destroy object of type T and free the memory.
  */
 #   define SKANIM_DELETE_T(T, p) Skanim::MemoryConfig::_delete_T<T>(p)
 
+/** Allocate memory of a memory category for n objects of type T without
+ *  constructing them, for objects constructed with placement new.
+ */
+#   define SKANIM_ALLOCATE_T_CATEGORY(T, n, category) Skanim::MemoryConfig::_allocate_T<T>(n, category, _SKANIM_CALL_SITE)
+
+/** Free the memory allocated by SKANIM_ALLOCATE_T_CATEGORY
+ */
+#   define SKANIM_DEALLOCATE_T_CATEGORY(T, p, category) Skanim::MemoryConfig::_deallocate_T<T>(p, category)
+
+/** Allocate and construct object of type T in a memory category.
+ */
+#   define SKANIM_NEW_T_CATEGORY(T, category) static_cast<T*>(Skanim::MemoryConfig::_new_T<T>(category, _SKANIM_CALL_SITE))
+
+/** Destroy object of type T and free the memory allocated by
+ *  SKANIM_NEW_T_CATEGORY
+ */
+#   define SKANIM_DELETE_T_CATEGORY(T, p, category) Skanim::MemoryConfig::_delete_T<T>(p, category)
+
 /** Allocate a block of memory for array and construct n object of type T
  */
-#   define SKANIM_NEW_ARRAY_T(T, n) static_cast<T*>(Skanim::MemoryConfig::_new_array_T<T>(n, __FILEW__, __LINE__, __FUNCTIONW__))
+#   define SKANIM_NEW_ARRAY_T(T, n) static_cast<T*>(Skanim::MemoryConfig::_new_array_T<T>(n, _SKANIM_CALL_SITE))
 
 /** Destroy n objects of type T and free the memory.
  */
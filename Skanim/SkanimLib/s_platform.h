@@ -17,3 +17,23 @@
 #define _SKANIM_EXPORT
 
 #endif
+
+
+// Switch that controlls if allocations pass their call sites to the alloc
+// managers, and if the skanim manager tracks the memory. It's on in debug
+// builds by default.
+#ifndef SKANIM_MEMORY_TRACKING
+#if defined(DEBUG) || defined(_DEBUG)
+#define SKANIM_MEMORY_TRACKING 1
+#else
+#define SKANIM_MEMORY_TRACKING 0
+#endif
+#endif
+
+// The call site arguments passed to the alloc managers, which are empty
+// when the memory isn't tracked.
+#if SKANIM_MEMORY_TRACKING == 1
+#define _SKANIM_CALL_SITE __FILEW__, __LINE__, __FUNCTIONW__
+#else
+#define _SKANIM_CALL_SITE nullptr, 0, nullptr
+#endif
\ No newline at end of file
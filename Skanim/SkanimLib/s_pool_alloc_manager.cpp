@@ -0,0 +1,174 @@
+#include "s_precomp.h"
+#include "s_pool_alloc_manager.h"
+
+namespace Skanim
+{
+    PoolAllocManager::PoolAllocManager(IAllocManager *upstream) noexcept
+        : m_upstream(upstream ? upstream : &m_default_upstream),
+          m_chunk_count(0)
+    {
+        // Make the block sizes, 16 to 128 step by 16 and then four classes
+        // between each power of two.
+        size_t block_size = 0;
+        size_t power_of_two = 128;
+        for (uint32_t i_class = 0; i_class < _SIZE_CLASS_COUNT; ++i_class) {
+            if (block_size >= power_of_two * 2)
+                power_of_two *= 2;
+            block_size += block_size < 128 ? 16 : power_of_two / 4;
+            m_size_classes[i_class].free_list = nullptr;
+            m_size_classes[i_class].chunks = nullptr;
+            m_size_classes[i_class].block_size = block_size;
+        }
+        assert(block_size == MAX_POOLED_SIZE &&
+            "the largest size class must be MAX_POOLED_SIZE");
+
+        // Map the granule counts to the smallest class which fits them.
+        uint32_t size_class = 0;
+        for (size_t i_granule = 0; i_granule <= MAX_POOLED_SIZE / 16; ++i_granule) {
+            while (m_size_classes[size_class].block_size < i_granule * 16)
+                ++size_class;
+            m_granule_size_classes[i_granule] = (uint8_t)size_class;
+        }
+    }
+
+    PoolAllocManager::~PoolAllocManager()
+    {
+        for (auto &size_class : m_size_classes) {
+            void *chunk = size_class.chunks;
+            while (chunk) {
+                void *next = _getNextBlock(chunk);
+                m_upstream->deallocateBytes(chunk);
+                chunk = next;
+            }
+        }
+    }
+
+    void *PoolAllocManager::allocateBytes(size_t count, const wchar_t *file,
+        int line, const wchar_t *func)
+    {
+        const uint32_t size_class = _getSizeClass(count);
+        if (size_class == _LARGE_SIZE_CLASS)
+            return _allocateLarge(count, file, line, func);
+
+        void *ptr;
+        _popBlocks(size_class, 1, &ptr);
+        return ptr;
+    }
+
+    void PoolAllocManager::deallocateBytes(void *ptr)
+    {
+        if (ptr == nullptr)
+            return;
+
+        const uint32_t size_class = _getBlockSizeClass(ptr);
+        if (size_class >= _SIZE_CLASS_COUNT)
+            _deallocateUnpooled(ptr, size_class);
+        else
+            _pushBlocks(size_class, ptr, ptr, 1);
+    }
+
+    void *PoolAllocManager::allocateAlignedBytes(size_t count,
+        size_t alignment, const wchar_t *file, int line, const wchar_t *func)
+    {
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0 &&
+            "alignment isn't a power of two");
+
+        // Blocks are aligned to the header size already.
+        if (alignment <= _HEADER_SIZE)
+            return allocateBytes(count, file, line, func);
+
+        // Leave a whole alignment in front for the header, which records the
+        // alignment as well.
+        unsigned char *ptr = static_cast<unsigned char*>(
+            m_upstream->allocateAlignedBytes(count + alignment, alignment,
+                file, line, func)) + alignment;
+        unsigned char *header = ptr - _HEADER_SIZE;
+        *reinterpret_cast<uint32_t*>(header) = _ALIGNED_SIZE_CLASS;
+        *reinterpret_cast<size_t*>(header + sizeof(size_t)) = alignment;
+
+        return ptr;
+    }
+
+    size_t PoolAllocManager::_popBlocks(uint32_t size_class, size_t count,
+        void **first)
+    {
+        assert(size_class < _SIZE_CLASS_COUNT && count > 0 &&
+            "size class out of range or no blocks");
+
+        _SizeClass &pool = m_size_classes[size_class];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        if (pool.free_list == nullptr)
+            _addChunk(&pool, size_class);
+
+        // Cut the first count blocks off the free list.
+        void *last = pool.free_list;
+        size_t popped_count = 1;
+        while (popped_count < count && _getNextBlock(last) != nullptr) {
+            last = _getNextBlock(last);
+            ++popped_count;
+        }
+
+        *first = pool.free_list;
+        pool.free_list = _getNextBlock(last);
+        _setNextBlock(last, nullptr);
+
+        return popped_count;
+    }
+
+    void PoolAllocManager::_pushBlocks(uint32_t size_class, void *first,
+        void *last, size_t count)
+    {
+        assert(size_class < _SIZE_CLASS_COUNT && count > 0 &&
+            "size class out of range or no blocks");
+
+        _SizeClass &pool = m_size_classes[size_class];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        _setNextBlock(last, pool.free_list);
+        pool.free_list = first;
+    }
+
+    void *PoolAllocManager::_allocateLarge(size_t count, const wchar_t *file,
+        int line, const wchar_t *func)
+    {
+        unsigned char *header = static_cast<unsigned char*>(
+            m_upstream->allocateBytes(count + _HEADER_SIZE, file, line, func));
+        *reinterpret_cast<uint32_t*>(header) = _LARGE_SIZE_CLASS;
+        return header + _HEADER_SIZE;
+    }
+
+    void PoolAllocManager::_deallocateUnpooled(void *ptr, uint32_t size_class)
+    {
+        unsigned char *header = static_cast<unsigned char*>(ptr) - _HEADER_SIZE;
+        if (size_class == _LARGE_SIZE_CLASS) {
+            m_upstream->deallocateBytes(header);
+        }
+        else {
+            assert(size_class == _ALIGNED_SIZE_CLASS && "corrupted block header");
+            const size_t alignment = *reinterpret_cast<size_t*>(header + sizeof(size_t));
+            m_upstream->deallocateAlignedBytes(static_cast<unsigned char*>(ptr) - alignment);
+        }
+    }
+
+    void PoolAllocManager::_addChunk(_SizeClass *size_class, uint32_t index)
+    {
+        unsigned char *chunk = static_cast<unsigned char*>(
+            m_upstream->allocateBytes(CHUNK_SIZE));
+        _setNextBlock(chunk, size_class->chunks);
+        size_class->chunks = chunk;
+        ++m_chunk_count;
+
+        // The first header slot holds the chunk link. The blocks follow,
+        // each after its header.
+        const size_t stride = _HEADER_SIZE + size_class->block_size;
+        unsigned char *end = chunk + CHUNK_SIZE;
+        for (unsigned char *header = chunk + _HEADER_SIZE;
+             header + stride <= end; header += stride) {
+            *reinterpret_cast<uint32_t*>(header) = index;
+            void *block = header + _HEADER_SIZE;
+            _setNextBlock(block, size_class->free_list);
+            size_class->free_list = block;
+        }
+    }
+};
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_default_alloc_manager.h"
+#include "s_ialloc_manager.h"
+
+namespace Skanim
+{
+    /** Pool alloc manager serves small allocations from pools of fixed size
+     *  blocks, one pool for each size class. The pools grow by chunks taken
+     *  from an upstream alloc manager and never shrink, freed blocks are kept
+     *  for reuse until the manager is destroyed. Allocations larger than
+     *  MAX_POOLED_SIZE go to the upstream alloc manager directly.
+     *  Each block is preceded by a small header which records its size class,
+     *  so the blocks keep the alignment of the upstream memory. Allocations
+     *  aligned to more than that go to the upstream alloc manager as well.
+     *  The manager is thread safe, each size class has its own lock. Memory
+     *  must be freed by the manager which allocated it, so a pool alloc
+     *  manager must not be replaced while its memory is alive.
+     */
+    class _SKANIM_EXPORT PoolAllocManager : public IAllocManager
+    {
+    public:
+        /** The largest allocation served from the pools.
+         */
+        static const size_t MAX_POOLED_SIZE = 4096;
+
+        /** The size of the chunks taken from the upstream alloc manager.
+         */
+        static const size_t CHUNK_SIZE = 64 * 1024;
+
+        /** Construct a pool alloc manager.
+         *  @param upstream The alloc manager of the chunks and of the large
+         *  allocations. If it's nullptr malloc() and free() are used.
+         */
+        explicit PoolAllocManager(IAllocManager *upstream = nullptr) noexcept;
+
+        /** Free all the chunks. Any memory allocated by the manager is invalid
+         *  after that.
+         */
+        virtual ~PoolAllocManager();
+
+        PoolAllocManager(const PoolAllocManager &) = delete;
+
+        PoolAllocManager &operator=(const PoolAllocManager &) = delete;
+
+        virtual void *allocateBytes(size_t count,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr) override;
+
+        virtual void deallocateBytes(void *ptr) override;
+
+        virtual size_t getMaxAllocationSize() override
+        {
+            return m_upstream->getMaxAllocationSize() - _HEADER_SIZE;
+        }
+
+        virtual void *allocateAlignedBytes(size_t count, size_t alignment,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr) override;
+
+        virtual void deallocateAlignedBytes(void *ptr) override
+        {
+            // The block header tells how the memory was allocated.
+            deallocateBytes(ptr);
+        }
+
+        /** Get the number of bytes taken from the upstream alloc manager for
+         *  the chunks.
+         */
+        size_t getChunkSize() const
+        {
+            return m_chunk_count * CHUNK_SIZE;
+        }
+
+    protected:
+        // The size of the block header, which keeps 16 byte alignment.
+        static const size_t _HEADER_SIZE = 16;
+
+        // The size classes grow by 16 bytes up to 128, then by a quarter of
+        // the power of two below.
+        static const size_t _SIZE_CLASS_COUNT = 28;
+
+        // The size classes of large allocations and of allocations aligned
+        // to more than the header size, which aren't pooled.
+        static const uint32_t _LARGE_SIZE_CLASS = UINT32_MAX;
+        static const uint32_t _ALIGNED_SIZE_CLASS = UINT32_MAX - 1;
+
+        // Get the size class of an allocation of count bytes.
+        uint32_t _getSizeClass(size_t count) const
+        {
+            return count <= MAX_POOLED_SIZE ?
+                m_granule_size_classes[(count + 15) / 16] : _LARGE_SIZE_CLASS;
+        }
+
+        // Get the size class of an allocated block.
+        static uint32_t _getBlockSizeClass(void *ptr)
+        {
+            return *reinterpret_cast<uint32_t*>(
+                static_cast<unsigned char*>(ptr) - _HEADER_SIZE);
+        }
+
+        // Get and set the next block of a free block.
+        static void *_getNextBlock(void *ptr)
+        {
+            return *static_cast<void**>(ptr);
+        }
+
+        static void _setNextBlock(void *ptr, void *next)
+        {
+            *static_cast<void**>(ptr) = next;
+        }
+
+        // Take up to count free blocks of a size class as a list and return
+        // the number of them, which is at least 1.
+        size_t _popBlocks(uint32_t size_class, size_t count, void **first);
+
+        // Give back a list of count blocks of a size class.
+        void _pushBlocks(uint32_t size_class, void *first, void *last,
+            size_t count);
+
+        // Allocate allocations larger than MAX_POOLED_SIZE.
+        void *_allocateLarge(size_t count, const wchar_t *file, int line,
+            const wchar_t *func);
+
+        // Free the memory of a size class which isn't pooled.
+        void _deallocateUnpooled(void *ptr, uint32_t size_class);
+
+        // The upstream alloc manager.
+        IAllocManager *m_upstream;
+
+    private:
+        struct _SizeClass
+        {
+            std::mutex mutex;
+            // The free blocks linked through their first bytes.
+            void *free_list;
+            // The chunks of this size class linked through their first bytes.
+            void *chunks;
+            size_t block_size;
+        };
+
+        // Take a new chunk for a size class and put its blocks into the free
+        // list. The lock of the size class must be held.
+        void _addChunk(_SizeClass *size_class, uint32_t index);
+
+    private:
+        // Used as the upstream if none is given.
+        DefaultAllocManager m_default_upstream;
+
+        _SizeClass m_size_classes[_SIZE_CLASS_COUNT];
+
+        // The size class of each 16 byte granule count up to MAX_POOLED_SIZE.
+        uint8_t m_granule_size_classes[MAX_POOLED_SIZE / 16 + 1];
+
+        std::atomic<size_t> m_chunk_count;
+    };
+};
\ No newline at end of file
@@ -1,24 +1,333 @@
 #include "s_precomp.h"
 #include "s_pose.h"
+#include "s_frame_arena.h"
+#include "s_simd.h"
 
 namespace Skanim
 {
-    void Pose::lerp(float t, const Pose &a, const Pose &b, Pose *lerped_pose)
+    Pose::Pose() noexcept
+        : m_buffer(nullptr),
+          m_joint_count(0),
+          m_capacity(0)
+    {
+        for (int i_stream = 0; i_stream < STREAM_COUNT; ++i_stream)
+            m_streams[i_stream] = nullptr;
+    }
+
+    Pose::Pose(size_t joint_count) noexcept
+        : Pose()
+    {
+        resize(joint_count);
+    }
+
+    Pose::Pose(const TransformVector &joint_transforms_array) noexcept
+        : Pose()
+    {
+        resize(joint_transforms_array.size());
+
+        for (size_t i_joint = 0; i_joint < m_joint_count; ++i_joint)
+            setJointTransform(i_joint, joint_transforms_array[i_joint]);
+    }
+
+    Pose::Pose(size_t joint_count, FrameArena *arena) noexcept
+        : Pose()
+    {
+        const size_t padded_count = Simd::padCount(joint_count);
+        if (padded_count > 0) {
+            _setStreams(arena->allocate(sizeof(float) * padded_count * STREAM_COUNT,
+                SKANIM_SIMD_ALIGNMENT), padded_count);
+        }
+        resize(joint_count);
+    }
+
+    Pose::Pose(const Pose &other) noexcept
+        : Pose()
+    {
+        *this = other;
+    }
+
+    Pose::Pose(Pose &&other) noexcept
+        : Pose()
+    {
+        *this = std::move(other);
+    }
+
+    Pose::~Pose()
+    {
+        _release();
+    }
+
+    Pose &Pose::operator=(const Pose &other)
+    {
+        if (this == &other)
+            return *this;
+
+        // Reuse the buffer if it's large enough, so copying poses of the same
+        // joint count every frame won't touch the allocator.
+        const size_t padded_count = Simd::padCount(other.m_joint_count);
+        if (m_capacity < padded_count)
+            _allocate(padded_count);
+
+        for (int i_stream = 0; i_stream < STREAM_COUNT; ++i_stream) {
+            if (padded_count > 0) {
+                std::memcpy(m_streams[i_stream], other.m_streams[i_stream],
+                    sizeof(float) * padded_count);
+            }
+        }
+        m_joint_count = other.m_joint_count;
+
+        return *this;
+    }
+
+    Pose &Pose::operator=(Pose &&other) noexcept
+    {
+        if (this == &other)
+            return *this;
+
+        _release();
+
+        m_buffer = other.m_buffer;
+        for (int i_stream = 0; i_stream < STREAM_COUNT; ++i_stream)
+            m_streams[i_stream] = other.m_streams[i_stream];
+        m_joint_count = other.m_joint_count;
+        m_capacity = other.m_capacity;
+
+        other.m_buffer = nullptr;
+        for (int i_stream = 0; i_stream < STREAM_COUNT; ++i_stream)
+            other.m_streams[i_stream] = nullptr;
+        other.m_joint_count = 0;
+        other.m_capacity = 0;
+
+        return *this;
+    }
+
+    void Pose::resize(size_t joint_count)
+    {
+        const size_t padded_count = Simd::padCount(joint_count);
+
+        if (m_capacity < padded_count) {
+            // Keep the old content while growing.
+            Pose old_pose(std::move(*this));
+            _allocate(padded_count);
+
+            for (int i_stream = 0; i_stream < STREAM_COUNT; ++i_stream) {
+                if (old_pose.m_joint_count > 0) {
+                    std::memcpy(m_streams[i_stream], old_pose.m_streams[i_stream],
+                        sizeof(float) * old_pose.m_joint_count);
+                }
+            }
+            m_joint_count = old_pose.m_joint_count;
+        }
+
+        // New joints and the padding after the last joint are identity.
+        if (joint_count > m_joint_count)
+            _fillIdentity(m_joint_count, padded_count);
+        else
+            _fillIdentity(joint_count, padded_count);
+
+        m_joint_count = joint_count;
+    }
+
+    void Pose::lerp(float t, const Pose &a, const Pose &b, Pose *lerped_pose,
+        QuaternionBatch::Mode rotation_mode)
     {
         assert(a.getJointCount() == b.getJointCount() && "joint count differs");
 
         const size_t joint_count = a.getJointCount();
 
-        lerped_pose->m_joint_transforms_array.resize(joint_count);
+        lerped_pose->resize(joint_count);
+
+        // Translations and scales are linearly interpolated, several joints at
+        // a time. The streams are padded so there is no remainder loop.
+        const size_t padded_count = Simd::padCount(joint_count);
+        const Simd::Float t_simd = Simd::set1(t);
+
+        for (int i_stream = STREAM_TRANSLATION_X; i_stream <= STREAM_SCALE;
+            ++i_stream) {
+            const float *stream_a = a.m_streams[i_stream];
+            const float *stream_b = b.m_streams[i_stream];
+            float *lerped_stream = lerped_pose->m_streams[i_stream];
 
-        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint) {
-            const Transform &ref_joint_transform_a = 
-                a.m_joint_transforms_array[i_joint];
-            const Transform &ref_joint_transform_b = 
-                b.m_joint_transforms_array[i_joint];
-            lerped_pose->m_joint_transforms_array[i_joint] =
-                Transform::lerp(t, ref_joint_transform_a, ref_joint_transform_b);
+            for (size_t i_joint = 0; i_joint < padded_count;
+                i_joint += Simd::WIDTH) {
+                Simd::store(lerped_stream + i_joint, Simd::lerp(t_simd,
+                    Simd::load(stream_a + i_joint), Simd::load(stream_b + i_joint)));
+            }
+        }
+
+        // Rotations are interpolated by the batch kernel, which runs over the
+        // padding as well since it's filled with identity.
+        const QuaternionBatch::ConstStreams from = {
+            a.m_streams[STREAM_ROTATION_X], a.m_streams[STREAM_ROTATION_Y],
+            a.m_streams[STREAM_ROTATION_Z], a.m_streams[STREAM_ROTATION_W] };
+        const QuaternionBatch::ConstStreams to = {
+            b.m_streams[STREAM_ROTATION_X], b.m_streams[STREAM_ROTATION_Y],
+            b.m_streams[STREAM_ROTATION_Z], b.m_streams[STREAM_ROTATION_W] };
+        const QuaternionBatch::Streams result = {
+            lerped_pose->m_streams[STREAM_ROTATION_X],
+            lerped_pose->m_streams[STREAM_ROTATION_Y],
+            lerped_pose->m_streams[STREAM_ROTATION_Z],
+            lerped_pose->m_streams[STREAM_ROTATION_W] };
+
+        QuaternionBatch::interpolate(rotation_mode, t, padded_count, from, to,
+            result);
+    }
+
+    void Pose::lerp(const float *t, const Pose &a, const Pose &b,
+        Pose *lerped_pose, QuaternionBatch::Mode rotation_mode)
+    {
+        assert(a.getJointCount() == b.getJointCount() && "joint count differs");
+
+        const size_t joint_count = a.getJointCount();
+
+        lerped_pose->resize(joint_count);
+
+        // The factor array isn't padded, so the last few joints are
+        // interpolated one by one.
+        for (int i_stream = STREAM_TRANSLATION_X; i_stream <= STREAM_SCALE;
+            ++i_stream) {
+            const float *stream_a = a.m_streams[i_stream];
+            const float *stream_b = b.m_streams[i_stream];
+            float *lerped_stream = lerped_pose->m_streams[i_stream];
+
+            size_t i_joint = 0;
+            for (; i_joint + Simd::WIDTH <= joint_count; i_joint += Simd::WIDTH) {
+                Simd::store(lerped_stream + i_joint, Simd::lerp(
+                    Simd::loadUnaligned(t + i_joint), Simd::load(stream_a + i_joint),
+                    Simd::load(stream_b + i_joint)));
+            }
+            for (; i_joint < joint_count; ++i_joint) {
+                lerped_stream[i_joint] = Math::lerp(t[i_joint], stream_a[i_joint],
+                    stream_b[i_joint]);
+            }
+        }
+
+        const QuaternionBatch::ConstStreams from = {
+            a.m_streams[STREAM_ROTATION_X], a.m_streams[STREAM_ROTATION_Y],
+            a.m_streams[STREAM_ROTATION_Z], a.m_streams[STREAM_ROTATION_W] };
+        const QuaternionBatch::ConstStreams to = {
+            b.m_streams[STREAM_ROTATION_X], b.m_streams[STREAM_ROTATION_Y],
+            b.m_streams[STREAM_ROTATION_Z], b.m_streams[STREAM_ROTATION_W] };
+        const QuaternionBatch::Streams result = {
+            lerped_pose->m_streams[STREAM_ROTATION_X],
+            lerped_pose->m_streams[STREAM_ROTATION_Y],
+            lerped_pose->m_streams[STREAM_ROTATION_Z],
+            lerped_pose->m_streams[STREAM_ROTATION_W] };
+
+        QuaternionBatch::interpolate(rotation_mode, t, joint_count, from, to,
+            result);
+    }
+
+    void Pose::lerp(float t, const Pose &a, const Pose &b,
+        const JointRange &range, Pose *lerped_pose,
+        QuaternionBatch::Mode rotation_mode)
+    {
+        assert(a.getJointCount() == b.getJointCount() && "joint count differs");
+        assert(lerped_pose->getJointCount() == a.getJointCount() &&
+            "lerped pose's joint count differs");
+        assert(range.begin <= range.end && range.end <= a.getJointCount() &&
+            "joint range out of range");
+
+        // The range doesn't start at an aligned joint and the joints around it
+        // must be kept, so unaligned loads and stores are used and the last few
+        // joints are interpolated one by one.
+        const Simd::Float t_simd = Simd::set1(t);
+
+        for (int i_stream = STREAM_TRANSLATION_X; i_stream <= STREAM_SCALE;
+            ++i_stream) {
+            const float *stream_a = a.m_streams[i_stream];
+            const float *stream_b = b.m_streams[i_stream];
+            float *lerped_stream = lerped_pose->m_streams[i_stream];
+
+            size_t i_joint = range.begin;
+            for (; i_joint + Simd::WIDTH <= range.end; i_joint += Simd::WIDTH) {
+                Simd::storeUnaligned(lerped_stream + i_joint, Simd::lerp(t_simd,
+                    Simd::loadUnaligned(stream_a + i_joint),
+                    Simd::loadUnaligned(stream_b + i_joint)));
+            }
+            for (; i_joint < range.end; ++i_joint) {
+                lerped_stream[i_joint] = Math::lerp(t, stream_a[i_joint],
+                    stream_b[i_joint]);
+            }
+        }
+
+        const size_t i_begin = range.begin;
+        const QuaternionBatch::ConstStreams from = {
+            a.m_streams[STREAM_ROTATION_X] + i_begin,
+            a.m_streams[STREAM_ROTATION_Y] + i_begin,
+            a.m_streams[STREAM_ROTATION_Z] + i_begin,
+            a.m_streams[STREAM_ROTATION_W] + i_begin };
+        const QuaternionBatch::ConstStreams to = {
+            b.m_streams[STREAM_ROTATION_X] + i_begin,
+            b.m_streams[STREAM_ROTATION_Y] + i_begin,
+            b.m_streams[STREAM_ROTATION_Z] + i_begin,
+            b.m_streams[STREAM_ROTATION_W] + i_begin };
+        const QuaternionBatch::Streams result = {
+            lerped_pose->m_streams[STREAM_ROTATION_X] + i_begin,
+            lerped_pose->m_streams[STREAM_ROTATION_Y] + i_begin,
+            lerped_pose->m_streams[STREAM_ROTATION_Z] + i_begin,
+            lerped_pose->m_streams[STREAM_ROTATION_W] + i_begin };
+
+        QuaternionBatch::interpolate(rotation_mode, t, range.end - range.begin,
+            from, to, result);
+    }
+
+    void Pose::setIdentity()
+    {
+        _fillIdentity(0, Simd::padCount(m_joint_count));
+    }
+
+    void Pose::_allocate(size_t capacity)
+    {
+        assert(capacity % SKANIM_SIMD_PADDING == 0 && "capacity isn't padded");
+
+        _release();
+
+        const size_t stream_bytes = sizeof(float) * capacity;
+        m_buffer = SKANIM_MALLOC_ALIGNED_CATEGORY(stream_bytes * STREAM_COUNT,
+            SKANIM_SIMD_ALIGNMENT, MEMORY_CATEGORY_POSE);
+
+        _setStreams(m_buffer, capacity);
+    }
+
+    void Pose::_setStreams(void *aligned_buffer, size_t capacity)
+    {
+        // Streams are laid out one after another. The stream size is a
+        // multiple of the alignment so every stream is aligned.
+        const size_t stream_bytes = sizeof(float) * capacity;
+        for (int i_stream = 0; i_stream < STREAM_COUNT; ++i_stream) {
+            m_streams[i_stream] = reinterpret_cast<float*>(
+                reinterpret_cast<uintptr_t>(aligned_buffer) + stream_bytes * i_stream);
+        }
+
+        m_capacity = capacity;
+        m_joint_count = 0;
+    }
+
+    void Pose::_release()
+    {
+        if (m_buffer)
+            SKANIM_FREE_ALIGNED_CATEGORY(m_buffer, MEMORY_CATEGORY_POSE);
+
+        m_buffer = nullptr;
+        for (int i_stream = 0; i_stream < STREAM_COUNT; ++i_stream)
+            m_streams[i_stream] = nullptr;
+        m_joint_count = 0;
+        m_capacity = 0;
+    }
+
+    void Pose::_fillIdentity(size_t begin, size_t end)
+    {
+        for (size_t i_joint = begin; i_joint < end; ++i_joint) {
+            m_streams[STREAM_ROTATION_X][i_joint] = 0.0f;
+            m_streams[STREAM_ROTATION_Y][i_joint] = 0.0f;
+            m_streams[STREAM_ROTATION_Z][i_joint] = 0.0f;
+            m_streams[STREAM_ROTATION_W][i_joint] = 1.0f;
+            m_streams[STREAM_TRANSLATION_X][i_joint] = 0.0f;
+            m_streams[STREAM_TRANSLATION_Y][i_joint] = 0.0f;
+            m_streams[STREAM_TRANSLATION_Z][i_joint] = 0.0f;
+            m_streams[STREAM_SCALE][i_joint] = 1.0f;
         }
     }
 
-};
\ No newline at end of file
+};
@@ -6,79 +6,199 @@
 
 namespace Skanim
 {
+    /** A range of joint indices [begin, end). Joints are stored in pre-order,
+     *  so the joints of a sub hierarchy always form a single range.
+     */
+    struct JointRange
+    {
+        size_t begin;
+        size_t end;
+    };
+
     /** A pose class stores each joint's transform in pre-order.
+     *  The transforms are stored in structure-of-arrays layout. Every component
+     *  of the transform (rotation x, y, z, w, translation x, y, z and scale)
+     *  has its own aligned and padded array so poses could be processed by SIMD
+     *  instructions several joints at a time.
      */
     class _SKANIM_EXPORT Pose
     {
     public:
-        Pose() = default;
+        /** Components of a joint transform, each of them is stored in its own
+         *  array.
+         */
+        enum Stream
+        {
+            STREAM_ROTATION_X,
+            STREAM_ROTATION_Y,
+            STREAM_ROTATION_Z,
+            STREAM_ROTATION_W,
+            STREAM_TRANSLATION_X,
+            STREAM_TRANSLATION_Y,
+            STREAM_TRANSLATION_Z,
+            STREAM_SCALE,
+            STREAM_COUNT
+        };
 
         typedef vector<Transform> TransformVector;
 
-        explicit Pose(size_t joint_count) noexcept
-            : m_joint_transforms_array(joint_count)
-        {}
+        Pose() noexcept;
+
+        /** Construct a pose with joint count. All joint transforms are
+         *  initialized to identity.
+         */
+        explicit Pose(size_t joint_count) noexcept;
+
+        /** Construct a pose from an array of joint transforms.
+         */
+        explicit Pose(const TransformVector &joint_transforms_array) noexcept;
+
+        /** Construct a pose with joint count whose transforms are stored in a
+         *  frame arena. All joint transforms are initialized to identity. The
+         *  pose must not be used after the arena is reset, unless it has grown
+         *  into its own memory by resize().
+         */
+        Pose(size_t joint_count, FrameArena *arena) noexcept;
+
+        Pose(const Pose &other) noexcept;
+
+        Pose(Pose &&other) noexcept;
+
+        ~Pose();
 
-        explicit Pose(const TransformVector &joint_transforms_array) noexcept
-            : m_joint_transforms_array(joint_transforms_array)
-        {}
+        Pose &operator=(const Pose &other);
+
+        Pose &operator=(Pose &&other) noexcept;
 
         /** Get joint count of this pose.
          */
         size_t getJointCount() const
         {
-            return m_joint_transforms_array.size();
+            return m_joint_count;
         }
 
-        /** Get the i'th joint's transform.
+        /** Change the joint count of this pose. Existing joint transforms are
+         *  kept and new joint transforms are initialized to identity. Memory
+         *  is only reallocated if the pose grows beyond its capacity.
          */
-        Transform &getJointTransform(size_t i)
-        {
-            assert(i < m_joint_transforms_array.size() && "i out of range");
-            return m_joint_transforms_array[i];
-        }
+        void resize(size_t joint_count);
 
         /** Get the i'th joint's transform.
          */
-        const Transform &getJointTransform(size_t i) const
+        Transform getJointTransform(size_t i) const
         {
-            assert(i < m_joint_transforms_array.size() && "i out of range");
-            return m_joint_transforms_array[i];
+            assert(i < m_joint_count && "i out of range");
+            return Transform(m_streams[STREAM_SCALE][i],
+                Quaternion(m_streams[STREAM_ROTATION_W][i],
+                    m_streams[STREAM_ROTATION_X][i],
+                    m_streams[STREAM_ROTATION_Y][i],
+                    m_streams[STREAM_ROTATION_Z][i]),
+                Vector3(m_streams[STREAM_TRANSLATION_X][i],
+                    m_streams[STREAM_TRANSLATION_Y][i],
+                    m_streams[STREAM_TRANSLATION_Z][i]));
         }
 
         /** Set the i'th joint's transform
          */
         void setJointTransform(size_t i, const Transform &transform)
         {
-            assert(i < m_joint_transforms_array.size() && "i out of range");
-            m_joint_transforms_array[i] = transform;
+            assert(i < m_joint_count && "i out of range");
+            const Quaternion &rotation = transform.getRotation();
+            const Vector3 &translation = transform.getTranslation();
+            m_streams[STREAM_ROTATION_X][i] = rotation.getX();
+            m_streams[STREAM_ROTATION_Y][i] = rotation.getY();
+            m_streams[STREAM_ROTATION_Z][i] = rotation.getZ();
+            m_streams[STREAM_ROTATION_W][i] = rotation.getW();
+            m_streams[STREAM_TRANSLATION_X][i] = translation.getX();
+            m_streams[STREAM_TRANSLATION_Y][i] = translation.getY();
+            m_streams[STREAM_TRANSLATION_Z][i] = translation.getZ();
+            m_streams[STREAM_SCALE][i] = transform.getScale();
         }
 
-        /** Get the i'th joint's transform by subscript. 
+        /** Get the i'th joint's transform by subscript.
          */
-        Transform &operator[](size_t i)
+        Transform operator[](size_t i) const
         {
             return getJointTransform(i);
         }
 
-        /** Get the i'th joint's transform by subscript.
+        /** Get the array of a transform component. The array is aligned to
+         *  SKANIM_SIMD_ALIGNMENT and padded to a multiple of SKANIM_SIMD_PADDING
+         *  elements. Padding elements hold the identity transform.
          */
-        const Transform &operator[](size_t i) const
+        float *getStream(Stream stream)
         {
-            return getJointTransform(i);
+            assert(stream < STREAM_COUNT && "stream out of range");
+            return m_streams[stream];
+        }
+
+        /** Get the array of a transform component.
+         */
+        const float *getStream(Stream stream) const
+        {
+            assert(stream < STREAM_COUNT && "stream out of range");
+            return m_streams[stream];
         }
 
         /** Interpolate between two pose.
          *  Pose a and b must have the same joint count.
+         *  @param rotation_mode How the rotations are interpolated. Exact
+         *  slerp is used by default.
          */
-        static void lerp(float t, const Pose &a, const Pose &b, Pose *lerped_pose);
+        static void lerp(float t, const Pose &a, const Pose &b, Pose *lerped_pose,
+            QuaternionBatch::Mode rotation_mode = QuaternionBatch::MODE_SLERP_EXACT);
+
+        /** Interpolate between two pose with a factor per joint, t[i] is the
+         *  factor of the i'th joint. Pose a and b must have the same joint
+         *  count, and lerped_pose could be a or b.
+         */
+        static void lerp(const float *t, const Pose &a, const Pose &b,
+            Pose *lerped_pose,
+            QuaternionBatch::Mode rotation_mode = QuaternionBatch::MODE_SLERP_EXACT);
+
+        /** Interpolate between two pose in a range of joints. Pose a and b must
+         *  have the same joint count, and lerped_pose must already have that
+         *  joint count. Joints out of the range are left unchanged in
+         *  lerped_pose, which could be a or b.
+         */
+        static void lerp(float t, const Pose &a, const Pose &b,
+            const JointRange &range, Pose *lerped_pose,
+            QuaternionBatch::Mode rotation_mode = QuaternionBatch::MODE_SLERP_EXACT);
+
+        /** Set all the joint transforms to identity.
+         */
+        void setIdentity();
 
 
     private:
-        typedef TransformVector::iterator _TransformVectorItor;
-        typedef TransformVector::const_iterator _TransformVectorConstItor;
+        // Point the streams to a buffer which is large enough for capacity
+        // joints and is aligned to SKANIM_SIMD_ALIGNMENT.
+        void _setStreams(void *aligned_buffer, size_t capacity);
+
+        // Allocate the buffer which is large enough for capacity joints.
+        // The old buffer is released and its content is lost.
+        void _allocate(size_t capacity);
+
+        // Release the buffer.
+        void _release();
+
+        // Fill the transforms in range [begin, end) with identity.
+        void _fillIdentity(size_t begin, size_t end);
+
+    private:
+        // The memory block which holds all the streams, aligned to
+        // SKANIM_SIMD_ALIGNMENT. It's nullptr if the streams are stored in a
+        // frame arena.
+        void *m_buffer;
+
+        // Pointers to each transform component array.
+        float *m_streams[STREAM_COUNT];
+
+        // The number of joints in this pose.
+        size_t m_joint_count;
 
-        // A vector stores joint transform in pre-order.
-        TransformVector m_joint_transforms_array;
+        // The number of elements each stream could hold. It's always a multiple
+        // of SKANIM_SIMD_PADDING.
+        size_t m_capacity;
     };
 };
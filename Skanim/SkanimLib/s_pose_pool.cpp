@@ -0,0 +1,45 @@
+#include "s_precomp.h"
+#include "s_pose_pool.h"
+
+namespace Skanim
+{
+    PosePool::PosePool() noexcept
+    {}
+
+    PosePool::~PosePool()
+    {
+        assert(m_free_poses.size() == m_poses.size() &&
+            "some poses are not released");
+
+        for (Pose *pose : m_poses)
+            SKANIM_DELETE_T(Pose, pose);
+    }
+
+    Pose *PosePool::acquire(size_t joint_count)
+    {
+        Pose *pose;
+        if (m_free_poses.empty()) {
+            pose = SKANIM_NEW_T(Pose);
+            m_poses.push_back(pose);
+            // Make room for the pose so releasing it never reallocates.
+            m_free_poses.reserve(m_poses.size());
+        }
+        else {
+            pose = m_free_poses.back();
+            m_free_poses.pop_back();
+        }
+
+        pose->resize(joint_count);
+        return pose;
+    }
+
+    void PosePool::release(Pose *pose)
+    {
+        assert(pose && "pose is nullptr");
+        assert(m_free_poses.size() < m_poses.size() &&
+            "more poses released than acquired");
+
+        m_free_poses.push_back(pose);
+    }
+
+};
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_pose.h"
+
+namespace Skanim
+{
+    /** Pose pool recycles scratch poses. Released poses keep their buffers, so
+     *  once the pool has handed out as many poses as a frame needs, acquiring
+     *  poses of the same joint count never touches the alloc manager again.
+     */
+    class _SKANIM_EXPORT PosePool
+    {
+    public:
+        PosePool() noexcept;
+
+        ~PosePool();
+
+        PosePool(const PosePool &) = delete;
+
+        PosePool &operator=(const PosePool &) = delete;
+
+        /** Get a pose with the given joint count. The content of the pose is
+         *  undefined. Return it with release() when it's not needed anymore.
+         */
+        Pose *acquire(size_t joint_count);
+
+        /** Give a pose acquired from this pool back.
+         */
+        void release(Pose *pose);
+
+        /** Get the number of poses created by this pool.
+         */
+        size_t getPoseCount() const
+        {
+            return m_poses.size();
+        }
+
+        /** Get the number of poses which are acquired and not released yet.
+         */
+        size_t getAcquiredPoseCount() const
+        {
+            return m_poses.size() - m_free_poses.size();
+        }
+
+    private:
+        // All the poses created by this pool.
+        vector<Pose*> m_poses;
+
+        // The poses which could be acquired. The most recently released pose
+        // is reused first since its memory is most likely still in cache.
+        vector<Pose*> m_free_poses;
+    };
+};
\ No newline at end of file
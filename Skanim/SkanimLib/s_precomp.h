@@ -1,10 +1,20 @@
 #pragma once
 
 #include <cassert>
+#include <cfloat>
 #include <climits>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <list>
 #include <map>
 #include <memory>
@@ -8,12 +8,14 @@ namespace Skanim
 {
     // Pre-declaration for classes.
     // Decrease dependencies between files.
+    class FrameArena;
     class IAnimationClip;
     class Joint;
     class MatrixUA4;
     class Pose;
     class Quaternion;
     class Skeleton;
+    class SkeletonDefinition;
     class Transform;
     class Vector3;
     class Vector4;
@@ -37,8 +39,8 @@ namespace Skanim
 #if SKANIM_USE_WCHAR_T == 1
 
 #if SKANIM_STRING_USE_CUSTOM_ALLOCATOR == 1
-    typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, Allocator<wchar_t>> _BasicString;
-    typedef std::basic_stringstream<wchar_t, std::char_traits<wchar_t>, Allocator<wchar_t>> _BasicStringStream;
+    typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, Allocator<wchar_t, MEMORY_CATEGORY_STRING>> _BasicString;
+    typedef std::basic_stringstream<wchar_t, std::char_traits<wchar_t>, Allocator<wchar_t, MEMORY_CATEGORY_STRING>> _BasicStringStream;
 #else
     typedef std::basic_string<wchar_t, std::char_traits<wchar_t>> _BasicString;
     typedef std::basic_stringstream<wchar_t, std::char_traits<wchar_t>> _BasicStringStream;
@@ -47,8 +49,8 @@ namespace Skanim
 #else
 
 #if SKANIM_STRING_USE_CUSTOM_ALLOCATOR == 1
-    typedef std::basic_string<char, std::char_traits<char>, Allocator<char>> _BasicString;
-    typedef std::basic_stringstream<char, std::char_traits<char>, Allocator<char>> _BasicStringStream;
+    typedef std::basic_string<char, std::char_traits<char>, Allocator<char, MEMORY_CATEGORY_STRING>> _BasicString;
+    typedef std::basic_stringstream<char, std::char_traits<char>, Allocator<char, MEMORY_CATEGORY_STRING>> _BasicStringStream;
 #else
     typedef std::basic_string<char, std::char_traits<char>> _BasicString;
     typedef std::basic_stringstream<char, std::char_traits<char>> _BasicStringStream;
@@ -0,0 +1,253 @@
+#include "s_precomp.h"
+#include "s_quaternion_batch.h"
+#include "s_simd.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // The nlerp error of the half angle is at most NLERP_ERROR_FACTOR *
+        // angle^3 for half angles in [0, PI/2]. The factor is doubled here so
+        // the error is measured as rotation angle.
+        const float NLERP_ERROR_FACTOR = 2.0f * 0.01835f;
+
+        // Pairs whose cosine is above this threshold are interpolated linearly,
+        // the same as Quaternion::slerp() does.
+        const float LINEAR_THRESHOLD = 1.0f - 1e-04f;
+
+        // acos(x) = sqrt(1 - x) * P(x) for x in [0, 1].
+        // Abramowitz and Stegun 4.4.46, the absolute error is below 2e-8.
+        Simd::Float _acos01(Simd::Float x)
+        {
+            Simd::Float p = Simd::set1(-0.0012624911f);
+            p = Simd::madd(p, x, Simd::set1(0.0066700901f));
+            p = Simd::madd(p, x, Simd::set1(-0.0170881256f));
+            p = Simd::madd(p, x, Simd::set1(0.0308918810f));
+            p = Simd::madd(p, x, Simd::set1(-0.0501743046f));
+            p = Simd::madd(p, x, Simd::set1(0.0889789874f));
+            p = Simd::madd(p, x, Simd::set1(-0.2145988016f));
+            p = Simd::madd(p, x, Simd::set1(1.5707963050f));
+            return Simd::mul(Simd::sqrt(Simd::sub(Simd::set1(1.0f), x)), p);
+        }
+
+        // sin(x) for x in [0, PI/2] with Taylor series up to x^11.
+        // The absolute error is below 6e-8.
+        Simd::Float _sin0HalfPi(Simd::Float x)
+        {
+            const Simd::Float x2 = Simd::mul(x, x);
+            Simd::Float p = Simd::set1(-1.0f / 39916800.0f);
+            p = Simd::madd(p, x2, Simd::set1(1.0f / 362880.0f));
+            p = Simd::madd(p, x2, Simd::set1(-1.0f / 5040.0f));
+            p = Simd::madd(p, x2, Simd::set1(1.0f / 120.0f));
+            p = Simd::madd(p, x2, Simd::set1(-1.0f / 6.0f));
+            p = Simd::madd(p, x2, Simd::set1(1.0f));
+            return Simd::mul(p, x);
+        }
+
+        // Interpolate Simd::WIDTH pairs of quaternions.
+        // Pairs with cosine not less than nlerp_threshold are linearly
+        // interpolated and all results are normalized.
+        void _interpolateBlock(Simd::Float t, float nlerp_threshold,
+            const float *ax, const float *ay, const float *az, const float *aw,
+            const float *bx, const float *by, const float *bz, const float *bw,
+            float *rx, float *ry, float *rz, float *rw)
+        {
+            const Simd::Float one = Simd::set1(1.0f);
+
+            const Simd::Float qax = Simd::loadUnaligned(ax);
+            const Simd::Float qay = Simd::loadUnaligned(ay);
+            const Simd::Float qaz = Simd::loadUnaligned(az);
+            const Simd::Float qaw = Simd::loadUnaligned(aw);
+            Simd::Float qbx = Simd::loadUnaligned(bx);
+            Simd::Float qby = Simd::loadUnaligned(by);
+            Simd::Float qbz = Simd::loadUnaligned(bz);
+            Simd::Float qbw = Simd::loadUnaligned(bw);
+
+            Simd::Float fcos = Simd::mul(qax, qbx);
+            fcos = Simd::madd(qay, qby, fcos);
+            fcos = Simd::madd(qaz, qbz, fcos);
+            fcos = Simd::madd(qaw, qbw, fcos);
+
+            // If the angle between two quaternions is larger than 90, inverse
+            // the second quaternion.
+            const Simd::Float sign = Simd::select(Simd::cmpLess(fcos, Simd::zero()),
+                Simd::set1(-1.0f), one);
+            fcos = Simd::mul(fcos, sign);
+            qbx = Simd::mul(qbx, sign);
+            qby = Simd::mul(qby, sign);
+            qbz = Simd::mul(qbz, sign);
+            qbw = Simd::mul(qbw, sign);
+
+            // Linear interpolation coefficients.
+            Simd::Float t0 = Simd::sub(one, t);
+            Simd::Float t1 = t;
+
+            const Simd::Float linear_mask = Simd::cmpGreaterEqual(fcos,
+                Simd::set1(nlerp_threshold));
+
+            // Only evaluate the polynomials if there is a pair which needs to
+            // be spherically interpolated.
+            if (Simd::moveMask(linear_mask) != (1 << Simd::WIDTH) - 1) {
+                const Simd::Float clamped_cos = Simd::min(fcos,
+                    Simd::set1(LINEAR_THRESHOLD));
+                const Simd::Float angle = _acos01(clamped_cos);
+                const Simd::Float inv_sin = Simd::div(one, Simd::sqrt(
+                    Simd::sub(one, Simd::mul(clamped_cos, clamped_cos))));
+
+                const Simd::Float slerp_t0 = Simd::mul(
+                    _sin0HalfPi(Simd::mul(t0, angle)), inv_sin);
+                const Simd::Float slerp_t1 = Simd::mul(
+                    _sin0HalfPi(Simd::mul(t1, angle)), inv_sin);
+
+                t0 = Simd::select(linear_mask, t0, slerp_t0);
+                t1 = Simd::select(linear_mask, t1, slerp_t1);
+            }
+
+            Simd::Float qrx = Simd::madd(qax, t0, Simd::mul(qbx, t1));
+            Simd::Float qry = Simd::madd(qay, t0, Simd::mul(qby, t1));
+            Simd::Float qrz = Simd::madd(qaz, t0, Simd::mul(qbz, t1));
+            Simd::Float qrw = Simd::madd(qaw, t0, Simd::mul(qbw, t1));
+
+            Simd::Float norm = Simd::mul(qrx, qrx);
+            norm = Simd::madd(qry, qry, norm);
+            norm = Simd::madd(qrz, qrz, norm);
+            norm = Simd::madd(qrw, qrw, norm);
+            const Simd::Float inv_norm = Simd::div(one, Simd::sqrt(norm));
+
+            Simd::storeUnaligned(rx, Simd::mul(qrx, inv_norm));
+            Simd::storeUnaligned(ry, Simd::mul(qry, inv_norm));
+            Simd::storeUnaligned(rz, Simd::mul(qrz, inv_norm));
+            Simd::storeUnaligned(rw, Simd::mul(qrw, inv_norm));
+        }
+
+        // Interpolate count pairs of quaternions. Each pair has its own factor
+        // if t_array isn't nullptr, otherwise they all use t.
+        void _interpolateStreams(QuaternionBatch::Mode mode, float t,
+            const float *t_array, size_t count,
+            const QuaternionBatch::ConstStreams &from,
+            const QuaternionBatch::ConstStreams &to,
+            const QuaternionBatch::Streams &result, float max_nlerp_error)
+        {
+            if (mode == QuaternionBatch::MODE_SLERP_EXACT) {
+                for (size_t i = 0; i < count; ++i) {
+                    Quaternion q = Quaternion::slerp(t_array ? t_array[i] : t,
+                        Quaternion(from.w[i], from.x[i], from.y[i], from.z[i]),
+                        Quaternion(to.w[i], to.x[i], to.y[i], to.z[i]));
+                    result.x[i] = q.getX();
+                    result.y[i] = q.getY();
+                    result.z[i] = q.getZ();
+                    result.w[i] = q.getW();
+                }
+                return;
+            }
+
+            // Find the cosine threshold above which nlerp is accurate enough.
+            float nlerp_threshold = LINEAR_THRESHOLD;
+            if (mode == QuaternionBatch::MODE_NLERP) {
+                const float max_angle = std::cbrt(max_nlerp_error / NLERP_ERROR_FACTOR);
+                nlerp_threshold = max_angle < Math::HALF_PI() ? cosf(max_angle) : 0.0f;
+            }
+
+            const Simd::Float t_simd = Simd::set1(t);
+
+            size_t i = 0;
+            for (; i + Simd::WIDTH <= count; i += Simd::WIDTH) {
+                _interpolateBlock(t_array ? Simd::loadUnaligned(t_array + i) : t_simd,
+                    nlerp_threshold, from.x + i, from.y + i, from.z + i, from.w + i,
+                    to.x + i, to.y + i, to.z + i, to.w + i,
+                    result.x + i, result.y + i, result.z + i, result.w + i);
+            }
+
+            // Copy the remaining quaternions into a block padded with identity.
+            if (i < count) {
+                float block[13][Simd::WIDTH];
+                for (size_t i_lane = 0; i_lane < Simd::WIDTH; ++i_lane) {
+                    const bool valid = i + i_lane < count;
+                    block[0][i_lane] = valid ? from.x[i + i_lane] : 0.0f;
+                    block[1][i_lane] = valid ? from.y[i + i_lane] : 0.0f;
+                    block[2][i_lane] = valid ? from.z[i + i_lane] : 0.0f;
+                    block[3][i_lane] = valid ? from.w[i + i_lane] : 1.0f;
+                    block[4][i_lane] = valid ? to.x[i + i_lane] : 0.0f;
+                    block[5][i_lane] = valid ? to.y[i + i_lane] : 0.0f;
+                    block[6][i_lane] = valid ? to.z[i + i_lane] : 0.0f;
+                    block[7][i_lane] = valid ? to.w[i + i_lane] : 1.0f;
+                    block[12][i_lane] = valid && t_array ? t_array[i + i_lane] : t;
+                }
+
+                _interpolateBlock(Simd::loadUnaligned(block[12]), nlerp_threshold,
+                    block[0], block[1], block[2], block[3],
+                    block[4], block[5], block[6], block[7],
+                    block[8], block[9], block[10], block[11]);
+
+                for (size_t i_lane = 0; i + i_lane < count; ++i_lane) {
+                    result.x[i + i_lane] = block[8][i_lane];
+                    result.y[i + i_lane] = block[9][i_lane];
+                    result.z[i + i_lane] = block[10][i_lane];
+                    result.w[i + i_lane] = block[11][i_lane];
+                }
+            }
+        }
+    }
+
+    void QuaternionBatch::interpolate(Mode mode, float t, size_t count,
+        const ConstStreams &from, const ConstStreams &to, const Streams &result,
+        float max_nlerp_error)
+    {
+        _interpolateStreams(mode, t, nullptr, count, from, to, result,
+            max_nlerp_error);
+    }
+
+    void QuaternionBatch::interpolate(Mode mode, const float *t, size_t count,
+        const ConstStreams &from, const ConstStreams &to, const Streams &result,
+        float max_nlerp_error)
+    {
+        _interpolateStreams(mode, 0.0f, t, count, from, to, result,
+            max_nlerp_error);
+    }
+
+    void QuaternionBatch::interpolate(Mode mode, float t, size_t count,
+        const Quaternion *from, const Quaternion *to, Quaternion *result,
+        float max_nlerp_error)
+    {
+        // Quaternion stores its components in w, x, y, z order, so an array of
+        // quaternions could be viewed as strided streams. Transpose them into
+        // SoA blocks on the stack and interpolate block by block.
+        const size_t BLOCK_SIZE = 64;
+        float block[12][BLOCK_SIZE];
+
+        for (size_t i_begin = 0; i_begin < count; i_begin += BLOCK_SIZE) {
+            const size_t block_count = std::min(BLOCK_SIZE, count - i_begin);
+
+            for (size_t i = 0; i < block_count; ++i) {
+                const Quaternion &qa = from[i_begin + i];
+                const Quaternion &qb = to[i_begin + i];
+                block[0][i] = qa.getX();
+                block[1][i] = qa.getY();
+                block[2][i] = qa.getZ();
+                block[3][i] = qa.getW();
+                block[4][i] = qb.getX();
+                block[5][i] = qb.getY();
+                block[6][i] = qb.getZ();
+                block[7][i] = qb.getW();
+            }
+
+            const ConstStreams from_streams = { block[0], block[1], block[2], block[3] };
+            const ConstStreams to_streams = { block[4], block[5], block[6], block[7] };
+            const Streams result_streams = { block[8], block[9], block[10], block[11] };
+            interpolate(mode, t, block_count, from_streams, to_streams,
+                result_streams, max_nlerp_error);
+
+            for (size_t i = 0; i < block_count; ++i) {
+                result[i_begin + i] = Quaternion(block[11][i], block[8][i],
+                    block[9][i], block[10][i]);
+            }
+        }
+    }
+
+    float QuaternionBatch::getNlerpMaxError(float cos_half_angle)
+    {
+        const float angle = acosf(Math::clamp(std::fabs(cos_half_angle), 0.0f, 1.0f));
+        return NLERP_ERROR_FACTOR * angle * angle * angle;
+    }
+
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_quaternion.h"
+
+namespace Skanim
+{
+    /** Batch operations on quaternion arrays. Quaternions are processed
+     *  several at a time with SIMD instructions. Arrays could be given in
+     *  structure-of-arrays layout (one array per component, which is how Pose
+     *  stores rotations) or as plain Quaternion arrays.
+     */
+    class _SKANIM_EXPORT QuaternionBatch
+    {
+    public:
+        /** Rotation interpolation modes.
+         */
+        enum Mode
+        {
+            // Quaternion::slerp() for every pair. Exact but slow.
+            MODE_SLERP_EXACT,
+            // Slerp with polynomial approximations of acos and sin. The
+            // error of each component is below 4e-7.
+            MODE_SLERP_FAST,
+            // Normalized linear interpolation. Pairs which would exceed the
+            // given error bound are interpolated with fast slerp instead.
+            MODE_NLERP
+        };
+
+        /** Read only quaternion arrays in structure-of-arrays layout.
+         */
+        struct ConstStreams
+        {
+            const float *x;
+            const float *y;
+            const float *z;
+            const float *w;
+        };
+
+        /** Writable quaternion arrays in structure-of-arrays layout.
+         */
+        struct Streams
+        {
+            float *x;
+            float *y;
+            float *z;
+            float *w;
+        };
+
+        /** Interpolate count pairs of quaternions with the given mode.
+         *  Result arrays could be the same as the from or to arrays.
+         *  @param max_nlerp_error The maximum rotation angle error in radians
+         *  that MODE_NLERP is allowed to produce. Ignored by other modes.
+         */
+        static void interpolate(Mode mode, float t, size_t count,
+            const ConstStreams &from, const ConstStreams &to,
+            const Streams &result, float max_nlerp_error = DEFAULT_NLERP_MAX_ERROR());
+
+        /** Interpolate count pairs of quaternions with the given mode. Each
+         *  pair has its own interpolation factor in array t.
+         */
+        static void interpolate(Mode mode, const float *t, size_t count,
+            const ConstStreams &from, const ConstStreams &to,
+            const Streams &result, float max_nlerp_error = DEFAULT_NLERP_MAX_ERROR());
+
+        /** Interpolate count pairs of quaternions with the given mode.
+         */
+        static void interpolate(Mode mode, float t, size_t count,
+            const Quaternion *from, const Quaternion *to, Quaternion *result,
+            float max_nlerp_error = DEFAULT_NLERP_MAX_ERROR());
+
+        /** Fast spherical interpolation of count quaternion pairs.
+         */
+        static void slerp(float t, size_t count, const ConstStreams &from,
+            const ConstStreams &to, const Streams &result)
+        {
+            interpolate(MODE_SLERP_FAST, t, count, from, to, result);
+        }
+
+        /** Normalized linear interpolation of count quaternion pairs. The
+         *  rotation angle error of each result never exceeds max_error.
+         */
+        static void nlerp(float t, size_t count, const ConstStreams &from,
+            const ConstStreams &to, const Streams &result,
+            float max_error = DEFAULT_NLERP_MAX_ERROR())
+        {
+            interpolate(MODE_NLERP, t, count, from, to, result, max_error);
+        }
+
+        /** Get the upper bound of the rotation angle error in radians that
+         *  nlerp produces between two unit quaternions whose dot product is
+         *  cos_half_angle.
+         */
+        static float getNlerpMaxError(float cos_half_angle);
+
+        /** The default nlerp error bound, which is about 0.06 degree.
+         */
+        static float DEFAULT_NLERP_MAX_ERROR()
+        {
+            static const float DEFAULT_NLERP_MAX_ERROR = 1e-03f;
+            return DEFAULT_NLERP_MAX_ERROR;
+        }
+    };
+};
@@ -0,0 +1,118 @@
+#include "s_precomp.h"
+#include "s_root_motion_track.h"
+#include "s_animation_clip.h"
+#include "s_ianimation_clip.h"
+#include "s_pose.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // Combine a transform with itself count times by repeated squaring.
+        // The powers of a transform commute, so the order of the combinations
+        // doesn't matter.
+        Transform _power(const Transform &transform, unsigned int count)
+        {
+            Transform result = Transform::IDENTITY();
+            Transform square = transform;
+            while (count > 0) {
+                if (count & 1)
+                    result = Transform::combine(square, result);
+                square = Transform::combine(square, square);
+                count >>= 1;
+            }
+            return result;
+        }
+    }
+
+    RootMotionTrack::RootMotionTrack() noexcept
+        : m_sample_interval(1),
+          m_length(0),
+          m_cycle_delta(Transform::IDENTITY()),
+          m_inv_cycle_delta(Transform::IDENTITY())
+    {
+        m_track.addKey(0, Transform::IDENTITY());
+    }
+
+    RootMotionTrack::RootMotionTrack(const IAnimationClip &clip,
+        long sample_interval)
+        : m_sample_interval(sample_interval),
+          m_length(clip.getLength())
+    {
+        assert(sample_interval > 0 && "sample_interval must be positive");
+
+        // Sample the root joint only, the last sample is at the end of the
+        // clip even if the length isn't a multiple of the interval.
+        Pose root_pose;
+        const JointRange root_range = { 0, 1 };
+        for (long time = 0; ; time += sample_interval) {
+            const long sample_time = std::min(time, m_length);
+            clip.extractPose(sample_time, &root_range, 1, &root_pose);
+            m_track.addKey(sample_time, root_pose.getJointTransform(0));
+
+            if (sample_time == m_length)
+                break;
+        }
+
+        const Transform &begin_root_transform = m_track.getKey(0);
+        const Transform &end_root_transform = m_track.getKey(m_track.getKeyCount() - 1);
+        m_cycle_delta = Transform::combine(end_root_transform,
+            begin_root_transform.inversed());
+        m_inv_cycle_delta = Transform::combine(begin_root_transform,
+            end_root_transform.inversed());
+    }
+
+    Transform RootMotionTrack::getRootTransform(long time) const
+    {
+        time = Math::clamp(time, 0, m_length);
+
+        // The samples are evenly spaced, so the segment is found directly.
+        const size_t key = std::min((size_t)(time / m_sample_interval),
+            m_track.getKeyCount() - 1);
+        const long key_time = m_track.getKeyTime(key);
+        if (key_time == m_length)
+            return m_track.getKey(key);
+
+        const long segment_length = m_track.getKeyTime(key + 1) - key_time;
+        return m_track.takeSample(key, (float)(time - key_time) / segment_length);
+    }
+
+    Transform RootMotionTrack::getDelta(long begin_time, long end_time,
+        int loop_count) const
+    {
+        const Transform begin_root_transform = getRootTransform(begin_time);
+        const Transform end_root_transform = getRootTransform(end_time);
+
+        if (loop_count == 0) {
+            return Transform::combine(end_root_transform,
+                begin_root_transform.inversed());
+        }
+
+        // Move to the end of the clip, pass through it a number of times and
+        // move from the beginning to end_time. It's the other way around if
+        // the playback runs backward.
+        const bool is_forward = loop_count > 0;
+        const Transform &first_root_transform = is_forward ?
+            m_track.getKey(m_track.getKeyCount() - 1) : m_track.getKey(0);
+        const Transform &last_root_transform = is_forward ?
+            m_track.getKey(0) : m_track.getKey(m_track.getKeyCount() - 1);
+        const Transform &cycle_delta = is_forward ? m_cycle_delta : m_inv_cycle_delta;
+
+        Transform delta = Transform::combine(first_root_transform,
+            begin_root_transform.inversed());
+        delta = Transform::combine(_power(cycle_delta,
+            (unsigned int)std::abs(loop_count) - 1), delta);
+
+        return Transform::combine(Transform::combine(end_root_transform,
+            last_root_transform.inversed()), delta);
+    }
+
+    void RootMotionTrack::stripRootMotion(KeyPoseAnimationClip *clip)
+    {
+        for (size_t i_key = 0; i_key < clip->getKeyPoseCount(); ++i_key) {
+            Pose key_pose = clip->getKeyPose(i_key);
+            key_pose.setJointTransform(0, Transform::IDENTITY());
+            clip->setKeyPose(i_key, key_pose);
+        }
+    }
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_track.h"
+#include "s_transform.h"
+
+namespace Skanim
+{
+    class IAnimationClip;
+    class KeyPoseAnimationClip;
+
+    /** Root motion track is the root joint's trajectory of an animation clip,
+     *  sampled at a constant interval when the clip is loaded. The root
+     *  transform at any time is found in constant time, and so is the delta
+     *  root transform between two times. When the playback looped around the
+     *  clip in between, the whole passes are combined in time logarithmic to
+     *  their number. A track could be shared by all the animation states
+     *  which play its clip.
+     */
+    class _SKANIM_EXPORT RootMotionTrack
+    {
+    public:
+        RootMotionTrack() noexcept;
+
+        /** Build a track from the root joint of a clip. Only the root joint is
+         *  extracted.
+         *  @param sample_interval The time between two samples. Sampling a
+         *  key pose clip at its key pose interval keeps its keys exactly.
+         */
+        RootMotionTrack(const IAnimationClip &clip, long sample_interval);
+
+        /** Get the time length of the track, which is the length of its clip.
+         */
+        long getLength() const
+        {
+            return m_length;
+        }
+
+        /** Get the time between two samples.
+         */
+        long getSampleInterval() const
+        {
+            return m_sample_interval;
+        }
+
+        /** Get the root transform at the given time, which is clamped to the
+         *  track's length.
+         */
+        Transform getRootTransform(long time) const;
+
+        /** Get the delta root transform from begin_time to end_time.
+         *  @param loop_count The number of times the playback passed the end
+         *  of the clip and wrapped to the beginning in between. It's negative
+         *  if the playback runs backward and passed the beginning.
+         */
+        Transform getDelta(long begin_time, long end_time, int loop_count = 0) const;
+
+        /** Get the delta root transform of a whole pass through the clip.
+         */
+        const Transform &getCycleDelta() const
+        {
+            return m_cycle_delta;
+        }
+
+        /** Remove the root motion from a clip by setting the root transforms of
+         *  all its key poses to identity, so the motion is only kept in a root
+         *  motion track built before.
+         */
+        static void stripRootMotion(KeyPoseAnimationClip *clip);
+
+    private:
+        // The root transform of every sample. The sample i is at time
+        // i * m_sample_interval, except the last one which is at m_length.
+        Track m_track;
+
+        long m_sample_interval;
+        long m_length;
+
+        // The delta root transforms of a pass through the clip forward and
+        // backward.
+        Transform m_cycle_delta;
+        Transform m_inv_cycle_delta;
+    };
+};
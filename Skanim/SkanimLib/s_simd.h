@@ -0,0 +1,133 @@
+#pragma once
+
+#include "s_precomp.h"
+#include "s_prerequisites.h"
+
+// Select the widest instruction set enabled by the compiler. AVX is picked
+// when the project is built with /arch:AVX (or -mavx), otherwise SSE is used
+// on every x86 target which supports SSE2. Other targets fall back to plain
+// scalar code.
+#if defined(__AVX__)
+#define SKANIM_SIMD_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKANIM_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define SKANIM_SIMD_SCALAR 1
+#endif
+
+// Half float conversions need F16C, which isn't part of AVX. It's enabled when
+// the compiler targets it (-mf16c, or /arch:AVX2 since every AVX2 processor
+// has it). Define SKANIM_SIMD_F16C in the project to enable it on an AVX build
+// which only runs on processors with F16C.
+#if defined(SKANIM_SIMD_AVX) && !defined(SKANIM_SIMD_F16C) && \
+    (defined(__F16C__) || defined(__AVX2__))
+#define SKANIM_SIMD_F16C 1
+#endif
+
+// The alignment of all SIMD friendly buffers in bytes. It's large enough for
+// AVX registers so buffers have the same layout whichever instruction set is
+// used.
+#define SKANIM_SIMD_ALIGNMENT 32
+
+// The number of floats that a SIMD friendly buffer is padded to.
+#define SKANIM_SIMD_PADDING 8
+
+namespace Skanim
+{
+    /** A thin wrapper over SIMD intrinsics. Kernels written with this class
+     *  process Simd::WIDTH floats at a time and compile to AVX, SSE or scalar
+     *  code depending on the target instruction set.
+     */
+    class _SKANIM_EXPORT Simd
+    {
+    public:
+#if defined(SKANIM_SIMD_AVX)
+        typedef __m256 Float;
+        static const size_t WIDTH = 8;
+
+        static Float load(const float *p) { return _mm256_load_ps(p); }
+        static Float loadUnaligned(const float *p) { return _mm256_loadu_ps(p); }
+        static void store(float *p, Float a) { _mm256_store_ps(p, a); }
+        static void storeUnaligned(float *p, Float a) { _mm256_storeu_ps(p, a); }
+        static Float set1(float s) { return _mm256_set1_ps(s); }
+        static Float zero() { return _mm256_setzero_ps(); }
+        static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+        static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+        static Float cmpLess(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Float cmpGreaterEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static Float select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+        static int moveMask(Float a) { return _mm256_movemask_ps(a); }
+#elif defined(SKANIM_SIMD_SSE)
+        typedef __m128 Float;
+        static const size_t WIDTH = 4;
+
+        static Float load(const float *p) { return _mm_load_ps(p); }
+        static Float loadUnaligned(const float *p) { return _mm_loadu_ps(p); }
+        static void store(float *p, Float a) { _mm_store_ps(p, a); }
+        static void storeUnaligned(float *p, Float a) { _mm_storeu_ps(p, a); }
+        static Float set1(float s) { return _mm_set1_ps(s); }
+        static Float zero() { return _mm_setzero_ps(); }
+        static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+        static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+        static Float cmpLess(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+        static Float cmpGreaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+        static Float select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        static int moveMask(Float a) { return _mm_movemask_ps(a); }
+#else
+        typedef float Float;
+        static const size_t WIDTH = 1;
+
+        static Float load(const float *p) { return *p; }
+        static Float loadUnaligned(const float *p) { return *p; }
+        static void store(float *p, Float a) { *p = a; }
+        static void storeUnaligned(float *p, Float a) { *p = a; }
+        static Float set1(float s) { return s; }
+        static Float zero() { return 0.0f; }
+        static Float add(Float a, Float b) { return a + b; }
+        static Float sub(Float a, Float b) { return a - b; }
+        static Float mul(Float a, Float b) { return a * b; }
+        static Float div(Float a, Float b) { return a / b; }
+        static Float min(Float a, Float b) { return a < b ? a : b; }
+        static Float max(Float a, Float b) { return a > b ? a : b; }
+        static Float sqrt(Float a) { return sqrtf(a); }
+        static Float cmpLess(Float a, Float b) { return a < b ? 1.0f : 0.0f; }
+        static Float cmpGreaterEqual(Float a, Float b) { return a >= b ? 1.0f : 0.0f; }
+        static Float select(Float mask, Float a, Float b) { return mask != 0.0f ? a : b; }
+        static int moveMask(Float a) { return a != 0.0f ? 1 : 0; }
+#endif
+
+        /** Calculate a * b + c.
+         */
+        static Float madd(Float a, Float b, Float c)
+        {
+            return add(mul(a, b), c);
+        }
+
+        /** Linear interpolation, the same as Math::lerp().
+         */
+        static Float lerp(Float t, Float from, Float to)
+        {
+            return madd(sub(to, from), t, from);
+        }
+
+        /** Round the given count up to a multiple of SKANIM_SIMD_PADDING.
+         */
+        static size_t padCount(size_t count)
+        {
+            return (count + SKANIM_SIMD_PADDING - 1) &
+                ~(size_t)(SKANIM_SIMD_PADDING - 1);
+        }
+    };
+};
@@ -5,29 +5,64 @@
 
 namespace Skanim
 {
-    bool SkanimManager::_initialize()
+    bool SkanimManager::_initialize(size_t worker_thread_count,
+        size_t clip_cache_budget)
     {
         // Create a default alloc manager.
         DefaultAllocManager *alloc_manager = new DefaultAllocManager();
         // Set the default alloc manager.
         MemoryConfig::setGlobalAllocManager(alloc_manager);
 
+        // Track everything allocated from now on.
+#if SKANIM_MEMORY_TRACKING == 1
+        m_tracking_alloc_manager = new TrackingAllocManager();
+        m_tracking_alloc_manager->install();
+#else
+        m_tracking_alloc_manager = nullptr;
+#endif
+
+        // Jobs allocate with the alloc manager, so the job system is
+        // created after it.
+        m_job_system = new JobSystem(worker_thread_count);
+
+        m_clip_cache = new ClipCache(clip_cache_budget);
+
         return true;
     }
 
-    void SkanimManager::destroy()
+    void SkanimManager::destroy(std::wostream *memory_report)
     {
+        // The clips must be released before, since the cache containers
+        // are freed by the alloc manager.
+        delete m_clip_cache;
+        m_clip_cache = nullptr;
+
+        // Stop the worker threads before their memory goes away.
+        delete m_job_system;
+        m_job_system = nullptr;
+
+        // Whatever is still alive here leaks.
+        if (m_tracking_alloc_manager) {
+            if (memory_report)
+                m_tracking_alloc_manager->writeReport(*memory_report);
+            delete m_tracking_alloc_manager;
+            m_tracking_alloc_manager = nullptr;
+        }
+
         IAllocManager *alloc_manager = MemoryConfig::getGlobalAllocManager();
         // Delete the alloc manager.
         delete alloc_manager;
         MemoryConfig::setGlobalAllocManager(nullptr);
+
+        delete this;
     }
 
-    SkanimManager* SkanimManager::create()
+    SkanimManager* SkanimManager::create(size_t worker_thread_count,
+        size_t clip_cache_budget)
     {
         SkanimManager *manager = new SkanimManager;
 
-        if (manager->_initialize())
+        if (manager->_initialize(worker_thread_count, clip_cache_budget))
             return manager;
         else
             return nullptr;
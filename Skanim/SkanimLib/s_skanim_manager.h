@@ -1,6 +1,9 @@
 #pragma once
 
 #include "s_prerequisites.h"
+#include "s_clip_cache.h"
+#include "s_job_system.h"
+#include "s_tracking_alloc_manager.h"
 
 namespace Skanim
 {
@@ -11,12 +14,42 @@ namespace Skanim
     public:
 
         /** Destroy the skanim manager.
+         *  @param memory_report If it isn't nullptr and the memory is tracked,
+         *  a report of the memory which is still allocated is written to it.
          */
-        void destroy();
+        void destroy(std::wostream *memory_report = nullptr);
 
         /** Create a skanim manager.
+         *  @param worker_thread_count The number of worker threads of the job
+         *  system besides the calling thread.
+         *  @param clip_cache_budget The memory budget of the clip cache in
+         *  bytes.
          */
-        static SkanimManager* create();
+        static SkanimManager* create(
+            size_t worker_thread_count = JobSystem::AUTO_WORKER_THREAD_COUNT,
+            size_t clip_cache_budget = ClipCache::DEFAULT_MEMORY_BUDGET);
+
+        /** Get the job system which runs parallel work on all the cores.
+         */
+        JobSystem *getJobSystem()
+        {
+            return m_job_system;
+        }
+
+        /** Get the tracking alloc manager, which records the memory when
+         *  SKANIM_MEMORY_TRACKING is on. It's nullptr otherwise.
+         */
+        TrackingAllocManager *getTrackingAllocManager()
+        {
+            return m_tracking_alloc_manager;
+        }
+
+        /** Get the clip cache which shares the animation clips.
+         */
+        ClipCache *getClipCache()
+        {
+            return m_clip_cache;
+        }
 
     private:
 
@@ -25,7 +58,18 @@ namespace Skanim
 
         /** Initialize the manager.
         */
-        bool _initialize();
+        bool _initialize(size_t worker_thread_count, size_t clip_cache_budget);
+
+    private:
+
+        // The job system owned by the manager.
+        JobSystem *m_job_system;
+
+        // The clip cache owned by the manager.
+        ClipCache *m_clip_cache;
+
+        // The tracking alloc manager, or nullptr if the memory isn't tracked.
+        TrackingAllocManager *m_tracking_alloc_manager;
 
     };
 };
@@ -2,194 +2,549 @@
 #include "s_skeleton.h"
 #include "s_joint.h"
 #include "s_pose.h"
+#include "s_job_system.h"
+#include "s_transform_batch.h"
 
 namespace Skanim
 {
+    namespace
+    {
+        // The number of joints gathered onto the stack at a time when the
+        // skinning palette is generated.
+        const size_t SKINNING_BLOCK_SIZE = 64;
+    }
+
     Skeleton::Skeleton() noexcept
-        : m_is_root_motion_enabled(true),
-          m_palette_needs_update(false)
+        : m_definition(nullptr),
+          m_is_root_motion_enabled(true),
+          m_palette_needs_update(false),
+          m_palette_dirty_begin(0),
+          m_palette_dirty_end(0),
+          m_is_depth_level_propagation_enabled(false),
+          m_lod_level(0)
     {}
 
-    Joint *Skeleton::findJoint(const String &name)
+    Skeleton::Skeleton(const SkeletonDefinition *definition)
+        : Skeleton()
+    {
+        setDefinition(definition);
+    }
+
+    Skeleton::Skeleton(const Skeleton &other)
+        : m_definition(other.m_definition),
+          m_lcl_transforms(other.m_lcl_transforms),
+          m_glb_transforms(other.m_glb_transforms),
+          m_is_root_motion_enabled(other.m_is_root_motion_enabled),
+          m_skinning_matrices_palette(other.m_skinning_matrices_palette),
+          m_palette_needs_update(other.m_palette_needs_update),
+          m_dirty_joints(other.m_dirty_joints),
+          m_palette_dirty_begin(other.m_palette_dirty_begin),
+          m_palette_dirty_end(other.m_palette_dirty_end),
+          m_is_depth_level_propagation_enabled(other.m_is_depth_level_propagation_enabled),
+          m_lod_level(other.m_lod_level)
+    {
+        if (m_definition)
+            m_definition->addReference();
+    }
+
+    Skeleton::~Skeleton()
+    {
+        if (m_definition)
+            m_definition->release();
+    }
+
+    Skeleton &Skeleton::operator=(const Skeleton &other)
+    {
+        if (this == &other)
+            return *this;
+
+        if (other.m_definition)
+            other.m_definition->addReference();
+        if (m_definition)
+            m_definition->release();
+        m_definition = other.m_definition;
+
+        m_lcl_transforms = other.m_lcl_transforms;
+        m_glb_transforms = other.m_glb_transforms;
+        m_is_root_motion_enabled = other.m_is_root_motion_enabled;
+        m_skinning_matrices_palette = other.m_skinning_matrices_palette;
+        m_palette_needs_update = other.m_palette_needs_update;
+        m_dirty_joints = other.m_dirty_joints;
+        m_palette_dirty_begin = other.m_palette_dirty_begin;
+        m_palette_dirty_end = other.m_palette_dirty_end;
+        m_is_depth_level_propagation_enabled = other.m_is_depth_level_propagation_enabled;
+        m_lod_level = other.m_lod_level;
+        return *this;
+    }
+
+    void Skeleton::setDefinition(const SkeletonDefinition *definition)
     {
-        _JointNamesMapConstIterator itor_joint = m_joint_names_map.find(name);
-        if (itor_joint != m_joint_names_map.end()) {
-            return getJoint(itor_joint->second);
+        assert((definition == nullptr || definition->isFrozen()) &&
+            "the definition isn't frozen.");
+
+        if (definition)
+            definition->addReference();
+        if (m_definition)
+            m_definition->release();
+        m_definition = definition;
+
+        const size_t joint_count = definition ? definition->getJointCount() : 0;
+        m_lcl_transforms.resize(joint_count);
+        m_glb_transforms.resize(joint_count);
+        m_dirty_joints.assign(joint_count, 1);
+        m_skinning_matrices_palette.resize(
+            definition ? definition->getSkinningMatrixCount() : 0);
+        m_palette_needs_update = joint_count > 0;
+        m_palette_dirty_begin = 0;
+        m_palette_dirty_end = 0;
+        m_lod_level = 0;
+
+        // Start in the binding pose.
+        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+            m_lcl_transforms[i_joint] = definition->getBindingLclTransform(i_joint);
+
+            const int parent_index = definition->getParentIndex(i_joint);
+            m_glb_transforms[i_joint] = parent_index == Joint::INDEX_NULL ?
+                m_lcl_transforms[i_joint] :
+                Transform::combine(m_lcl_transforms[i_joint],
+                    m_glb_transforms[parent_index]);
         }
-        return nullptr;
     }
 
-    void Skeleton::addJointPreOrder(const Joint &joint, int parent_index)
+    void Skeleton::setLodLevel(size_t level)
     {
-        assert(joint.hasParent() == false && 
-            "the joint being added already has a parent.");
-        assert(joint.getChildrenCount() == 0 && 
-            "the joint being added already has children.");
-        assert(parent_index < Joint::INDEX_NULL || parent_index >= 
-            (int)m_joint_hierarchy_array.size() && "parent_index is not valid.");
-        assert(m_joint_names_map.count(joint.getName()) == 0 &&
-            "joint name collision.");
-        
-        Joint new_joint = joint;
-        new_joint.setParentIndex(parent_index);
-        if (new_joint.getChildrenCount() > 0)
-            new_joint.removeAllChildren();
+        assert(m_definition && level < m_definition->getLodLevelCount() &&
+            "level out of range");
 
-        const int new_joint_index = m_joint_hierarchy_array.size() - 1;
-        
-        m_joint_hierarchy_array.push_back(joint);
-        m_joint_names_map.insert(std::make_pair(joint.getName(), new_joint_index));
+        if (level == m_lod_level)
+            return;
+        m_lod_level = level;
 
-        // If the added joint is not a root joint, attach it to its parent.
-        if (new_joint_index != 0) {
-            Joint &ref_parent_joint = m_joint_hierarchy_array[parent_index];
-            ref_parent_joint.addChild(new_joint_index);
+        // Joints which aren't animated return to the binding pose.
+        const unsigned char *lod_mask = m_definition->getLodJointMask(level);
+        if (lod_mask == nullptr)
+            return;
+
+        for (size_t i_joint = 0; i_joint < m_lcl_transforms.size(); ++i_joint) {
+            if (lod_mask[i_joint] == 0)
+                m_lcl_transforms[i_joint] = m_definition->getBindingLclTransform(i_joint);
         }
+        _updateSubHierarchyGlbTransform(0);
+    }
 
-        // If this joint is not a dummy one then we need to expand the room in
-        // skinning matrices malette to fit in a new skinning matrix.
-        if (new_joint.isDummy() == false) {
-            m_skinning_matrices_palette.resize(m_skinning_matrices_palette.size() + 1);
-            // Of course the palette need an update now.
-            m_palette_needs_update = true;
+    void Skeleton::setDepthLevelPropagationEnabled(bool enable)
+    {
+        m_is_depth_level_propagation_enabled = enable;
+
+        if (!enable) {
+            m_depth_level_lcl_pose = Pose();
+            m_depth_level_glb_pose = Pose();
         }
     }
 
-    void Skeleton::setPose(const Pose &local_pose)
+    void Skeleton::setPose(const Pose &local_pose, JobSystem *job_system)
     {
         const size_t joint_count_in_pose = local_pose.getJointCount();
         if (joint_count_in_pose == 0)
             return;
 
+        assert(m_definition && "the skeleton has no definition.");
+        const int *parent_indices = m_definition->getParentIndices();
+
+        // Joints which aren't animated at the level of detail keep their local
+        // transforms, like the joints which aren't in the pose.
+        const unsigned char *lod_mask = m_definition->getLodJointMask(m_lod_level);
+
+        if (m_is_depth_level_propagation_enabled) {
+            const size_t joint_count_in_skeleton = m_lcl_transforms.size();
+
+            // Joints which aren't in the pose keep their local transforms.
+            m_depth_level_lcl_pose = local_pose;
+            m_depth_level_lcl_pose.resize(joint_count_in_skeleton);
+            for (size_t i_joint = 0; i_joint < joint_count_in_skeleton; ++i_joint) {
+                if (i_joint >= joint_count_in_pose ||
+                    (lod_mask && lod_mask[i_joint] == 0)) {
+                    m_depth_level_lcl_pose.setJointTransform(i_joint,
+                        m_lcl_transforms[i_joint]);
+                }
+            }
+
+            // The root is accumulated the same way as below.
+            Transform root_transform = m_glb_transforms.front();
+            if (m_is_root_motion_enabled) {
+                root_transform = Transform::combine(
+                    local_pose.getJointTransform(0), root_transform);
+            }
+            m_depth_level_lcl_pose.setJointTransform(0, root_transform);
+
+            _updateGlbTransformsByDepthLevels(job_system);
+
+            _markAllJointsDirty();
+            return;
+        }
+
         // Accumulate the root transform if root motion is enabled.
         if (m_is_root_motion_enabled) {
-            Joint &ref_root_joint = m_joint_hierarchy_array.front();
-            const Transform &ref_delta_root_transform_in_pose =
+            const Transform delta_root_transform_in_pose =
                 local_pose.getJointTransform(0);
 
-            Transform root_accumulated_transform = ref_root_joint.getGlbTransform();
+            Transform root_accumulated_transform = m_glb_transforms.front();
             root_accumulated_transform =
-                Transform::combine(ref_delta_root_transform_in_pose,
+                Transform::combine(delta_root_transform_in_pose,
                     root_accumulated_transform);
 
-            ref_root_joint.setLclTransform(root_accumulated_transform);
-            ref_root_joint.setGlbTransform(root_accumulated_transform);
+            if (!(root_accumulated_transform == m_glb_transforms.front())) {
+                m_lcl_transforms.front() = root_accumulated_transform;
+                m_glb_transforms.front() = root_accumulated_transform;
+                _markJointDirty(0);
+            }
         }
 
         // Update other joints.
-        const size_t joint_count_in_skeleton = m_joint_hierarchy_array.size();
+        const size_t joint_count_in_skeleton = m_lcl_transforms.size();
         size_t i_joint = 1;
         for (; i_joint < joint_count_in_skeleton && i_joint < joint_count_in_pose;
         ++i_joint)
         {
-            Joint &ref_current_joint = m_joint_hierarchy_array[i_joint];
-            Joint &ref_parent_joint = 
-                m_joint_hierarchy_array[ref_current_joint.getParentIndex()];
+            const int parent_index = parent_indices[i_joint];
+
+            if (lod_mask && lod_mask[i_joint] == 0) {
+                if (m_dirty_joints[parent_index] != 0) {
+                    m_glb_transforms[i_joint] =
+                        Transform::combine(m_lcl_transforms[i_joint],
+                            m_glb_transforms[parent_index]);
+                    _markJointDirty(i_joint);
+                }
+                continue;
+            }
 
-            const Transform &ref_lcl_transform_in_pose = 
+            const Transform lcl_transform_in_pose = 
                 local_pose.getJointTransform(i_joint);
 
+            // The global transform stays the same if neither the local
+            // transform nor the parent's global transform changed.
+            if (m_dirty_joints[parent_index] == 0 &&
+                lcl_transform_in_pose == m_lcl_transforms[i_joint])
+                continue;
+
             // Combine the current joint's local transform with its parent's 
             // global transform.
-            Transform glb_transform =
-                Transform::combine(ref_lcl_transform_in_pose,
-                    ref_parent_joint.getGlbTransform());
-
-            // Update the joint.
-            ref_current_joint.setLclTransform(ref_lcl_transform_in_pose);
-            ref_current_joint.setGlbTransform(glb_transform);
+            m_lcl_transforms[i_joint] = lcl_transform_in_pose;
+            m_glb_transforms[i_joint] =
+                Transform::combine(lcl_transform_in_pose,
+                    m_glb_transforms[parent_index]);
+            _markJointDirty(i_joint);
         }
 
-        // If there are other joint left then update the sub hierarchy whos root
-        // is changed.
-        if (i_joint < joint_count_in_skeleton) {
-            _updateSubHierarchyGlbTransform(i_joint);
+        // Joints which aren't in the pose keep their local transforms, update
+        // those whose parents changed.
+        for (; i_joint < joint_count_in_skeleton; ++i_joint) {
+            const int parent_index = parent_indices[i_joint];
+            if (m_dirty_joints[parent_index] == 0)
+                continue;
+
+            m_glb_transforms[i_joint] =
+                Transform::combine(m_lcl_transforms[i_joint],
+                    m_glb_transforms[parent_index]);
+            _markJointDirty(i_joint);
         }
-
-        // The skinning matrices palette now need an update later.
-        m_palette_needs_update = true;
     }
 
     const Skeleton::MatricesVector &Skeleton::getSkinningMatricesPalette()
     {
-        if (m_palette_needs_update)
+        if (m_palette_needs_update) {
             _updateSkinningMatricesPalette();
+        }
+        else {
+            m_palette_dirty_begin = 0;
+            m_palette_dirty_end = 0;
+        }
 
         return m_skinning_matrices_palette;
     }
 
     void Skeleton::setRootJointTransform(const Transform &transform)
     {
-        m_joint_hierarchy_array.front().setLclTransform(transform);
+        m_lcl_transforms.front() = transform;
+
+        if (m_is_depth_level_propagation_enabled) {
+            const size_t joint_count = m_lcl_transforms.size();
+            m_depth_level_lcl_pose.resize(joint_count);
+            for (size_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+                m_depth_level_lcl_pose.setJointTransform(i_joint,
+                    m_lcl_transforms[i_joint]);
+            }
+
+            _updateGlbTransformsByDepthLevels(nullptr);
+
+            _markAllJointsDirty();
+            return;
+        }
 
         // Update entire hierarchy immediately
         _updateSubHierarchyGlbTransform(0);
+    }
 
-        m_palette_needs_update = true;
+    void Skeleton::setJointLclTransform(size_t joint_index,
+        const Transform &transform)
+    {
+        assert(joint_index < m_lcl_transforms.size() && "index out of range");
+
+        m_lcl_transforms[joint_index] = transform;
+        _updateSubHierarchyGlbTransform((int)joint_index);
     }
 
-    void Skeleton::_updateSkinningMatricesPalette()
+    template <typename F>
+    void Skeleton::_forEachSkinningBlock(const unsigned char *joint_filter,
+        F write_block) const
     {
-        for (size_t i_joint = 0; i_joint < m_joint_hierarchy_array.size(); ++i_joint) {
-            const Joint &ref_joint = m_joint_hierarchy_array[i_joint];
-            
-            if (ref_joint.isDummy() == false) {
-                Transform skinnig_transform =
-                    Transform::combine(ref_joint.getInvGlbBindingTransform(),
-                        ref_joint.getGlbTransform());
+        // Gather a block of non-dummy joints' transforms onto the stack in
+        // structure-of-arrays layout and combine them in one vectorized pass.
+        float inv_binding_block[Pose::STREAM_COUNT][SKINNING_BLOCK_SIZE];
+        float glb_block[Pose::STREAM_COUNT][SKINNING_BLOCK_SIZE];
+        int skinning_ids[SKINNING_BLOCK_SIZE];
+
+        TransformBatch::ConstStreams inv_binding, glb;
+        TransformBatch::Streams skinning;
+        for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+            inv_binding.streams[i_stream] = inv_binding_block[i_stream];
+            glb.streams[i_stream] = glb_block[i_stream];
+            skinning.streams[i_stream] = glb_block[i_stream];
+        }
 
-                m_skinning_matrices_palette[ref_joint.getSkinningId()] =
-                    skinnig_transform.toMatrix();
+        auto gather = [](const Transform &transform, size_t i,
+            float (*block)[SKINNING_BLOCK_SIZE])
+        {
+            const Quaternion &rotation = transform.getRotation();
+            const Vector3 &translation = transform.getTranslation();
+            block[Pose::STREAM_ROTATION_X][i] = rotation.getX();
+            block[Pose::STREAM_ROTATION_Y][i] = rotation.getY();
+            block[Pose::STREAM_ROTATION_Z][i] = rotation.getZ();
+            block[Pose::STREAM_ROTATION_W][i] = rotation.getW();
+            block[Pose::STREAM_TRANSLATION_X][i] = translation.getX();
+            block[Pose::STREAM_TRANSLATION_Y][i] = translation.getY();
+            block[Pose::STREAM_TRANSLATION_Z][i] = translation.getZ();
+            block[Pose::STREAM_SCALE][i] = transform.getScale();
+        };
+
+        const size_t joint_count = m_glb_transforms.size();
+        size_t i_joint = 0;
+        while (i_joint < joint_count) {
+            size_t block_count = 0;
+            for (; i_joint < joint_count && block_count < SKINNING_BLOCK_SIZE; ++i_joint) {
+                const int skinning_id = m_definition->getSkinningId(i_joint);
+                if (skinning_id == Joint::SKINNING_ID_NULL ||
+                    (joint_filter && joint_filter[i_joint] == 0))
+                    continue;
+
+                gather(m_definition->getInvGlbBindingTransform(i_joint), block_count,
+                    inv_binding_block);
+                gather(m_glb_transforms[i_joint], block_count, glb_block);
+                skinning_ids[block_count] = skinning_id;
+                ++block_count;
             }
+
+            if (block_count == 0)
+                break;
+
+            TransformBatch::combine(block_count, inv_binding, glb, skinning);
+            write_block(block_count, glb, skinning_ids);
+        }
+    }
+
+    void Skeleton::writeSkinningMatricesPalette(MatrixUA4 *palette) const
+    {
+        _forEachSkinningBlock(nullptr, [palette](size_t count,
+            const TransformBatch::ConstStreams &skinning, const int *skinning_ids)
+        {
+            MatrixUA4 matrices[SKINNING_BLOCK_SIZE];
+            TransformBatch::toMatrices(count, skinning, matrices);
+
+            for (size_t i = 0; i < count; ++i)
+                palette[skinning_ids[i]] = matrices[i];
+        });
+    }
+
+    void Skeleton::writeSkinningPalette(SkinningPalette::Format format,
+        void *buffer) const
+    {
+        _forEachSkinningBlock(nullptr, [format, buffer](size_t count,
+            const TransformBatch::ConstStreams &skinning, const int *skinning_ids)
+        {
+            SkinningPalette::write(format, count, skinning, skinning_ids, buffer);
+        });
+    }
+
+    void Skeleton::updateSkinningPalette(SkinningPalette::Format format,
+        void *buffer)
+    {
+        if (m_palette_needs_update) {
+            _updateSkinningMatricesPalette(format, buffer);
+        }
+        else {
+            m_palette_dirty_begin = 0;
+            m_palette_dirty_end = 0;
         }
+    }
+
+    void Skeleton::_updateSkinningMatricesPalette(SkinningPalette::Format format,
+        void *buffer)
+    {
+        // Regenerate the matrices of dirty joints only and track the range of
+        // skinning ids that they cover.
+        MatrixUA4 *palette = m_skinning_matrices_palette.data();
+        size_t dirty_begin = m_skinning_matrices_palette.size();
+        size_t dirty_end = 0;
+        _forEachSkinningBlock(m_dirty_joints.data(), [&](size_t count,
+            const TransformBatch::ConstStreams &skinning, const int *skinning_ids)
+        {
+            MatrixUA4 matrices[SKINNING_BLOCK_SIZE];
+            TransformBatch::toMatrices(count, skinning, matrices);
+
+            for (size_t i = 0; i < count; ++i) {
+                const size_t skinning_id = skinning_ids[i];
+                palette[skinning_id] = matrices[i];
+                dirty_begin = std::min(dirty_begin, skinning_id);
+                dirty_end = std::max(dirty_end, skinning_id + 1);
+            }
+
+            if (buffer)
+                SkinningPalette::write(format, count, skinning, skinning_ids, buffer);
+        });
+
+        m_palette_dirty_begin = dirty_begin < dirty_end ? dirty_begin : 0;
+        m_palette_dirty_end = dirty_begin < dirty_end ? dirty_end : 0;
 
         // The palette is up-to-date.
+        std::fill(m_dirty_joints.begin(), m_dirty_joints.end(), 0);
         m_palette_needs_update = false;
     }
 
-    void Skeleton::_updateSubHierarchyGlbTransform(int begin_root_index)
+    void Skeleton::_markAllJointsDirty()
     {
-        Joint &begin_root_joint = m_joint_hierarchy_array[begin_root_index];
+        std::fill(m_dirty_joints.begin(), m_dirty_joints.end(), 1);
+        m_palette_needs_update = true;
+    }
 
-        const int parent_index_of_root = begin_root_joint.getParentIndex();
+    void Skeleton::_updateSubHierarchyGlbTransform(int begin_root_index)
+    {
+        const int *parent_indices = m_definition->getParentIndices();
+        const int parent_index_of_root = parent_indices[begin_root_index];
 
         // Update the root joint seperately.
         if (begin_root_index == 0) {
             // The begin root is the real root joint which has no parent if the 
             // begin_root_index is 0. 
-            begin_root_joint.setGlbTransform(begin_root_joint.getLclTransform());
+            m_glb_transforms[0] = m_lcl_transforms[0];
         }
         else {
             // Otherwise derive the begin root's global transform from its parent.
-            Joint &ref_parent_joint =
-                m_joint_hierarchy_array[parent_index_of_root];
-
-            Transform glb_transform =
-                Transform::combine(begin_root_joint.getLclTransform(),
-                    ref_parent_joint.getGlbTransform());
-
-            begin_root_joint.setGlbTransform(glb_transform);
+            m_glb_transforms[begin_root_index] =
+                Transform::combine(m_lcl_transforms[begin_root_index],
+                    m_glb_transforms[parent_index_of_root]);
         }
+        _markJointDirty(begin_root_index);
 
         // Update other joints under the begin root joint.
         size_t i_joint = begin_root_index + 1;
-        for (; i_joint < m_joint_hierarchy_array.size(); ++i_joint) {
-            Joint &ref_current_joint = m_joint_hierarchy_array[i_joint];
-            const int parent_index = ref_current_joint.getParentIndex();
-
-            // If the parent index of the current joint is equal to the parent 
-            // index of the begin root joint then that means we are done traversing
-            // the entire sub hierarchy.
-            if (parent_index == parent_index_of_root)
+        for (; i_joint < m_lcl_transforms.size(); ++i_joint) {
+            const int parent_index = parent_indices[i_joint];
+
+            // Joints in the sub hierarchy are stored after the begin root, so
+            // a joint whose parent comes before the begin root is out of it and
+            // we are done traversing the entire sub hierarchy.
+            if (parent_index < begin_root_index)
                 break;
 
-            Joint &ref_parent_joint = m_joint_hierarchy_array[parent_index];
+            m_glb_transforms[i_joint] =
+                Transform::combine(m_lcl_transforms[i_joint],
+                    m_glb_transforms[parent_index]);
+            _markJointDirty(i_joint);
+        }
+    }
+
+    void Skeleton::_updateGlbTransformsByDepthLevels(JobSystem *job_system)
+    {
+        const size_t joint_count = m_lcl_transforms.size();
+        m_depth_level_glb_pose.resize(joint_count);
+
+        // Roots are the first level and their global transforms are their
+        // local transforms.
+        const size_t *level_offsets = m_definition->getDepthLevelOffsets();
+        const int *level_joints = m_definition->getDepthLevelJoints();
+        for (size_t i = level_offsets[0]; i < level_offsets[1]; ++i) {
+            const int root_index = level_joints[i];
+            m_depth_level_glb_pose.setJointTransform(root_index,
+                m_depth_level_lcl_pose.getJointTransform(root_index));
+        }
+
+        // A level only depends on the level above it. Large levels are split
+        // across the workers.
+        const size_t LEVEL_GRAIN_SIZE = 256;
+        const size_t level_count = m_definition->getDepthLevelCount();
+        for (size_t i_level = 1; i_level < level_count; ++i_level) {
+            const size_t level_begin = level_offsets[i_level];
+            const size_t level_size = level_offsets[i_level + 1] - level_begin;
+
+            if (job_system) {
+                job_system->parallelFor(level_size, LEVEL_GRAIN_SIZE,
+                    [&](size_t begin, size_t end) {
+                    _combineDepthLevelJoints(level_begin + begin, level_begin + end);
+                });
+            }
+            else {
+                _combineDepthLevelJoints(level_begin, level_begin + level_size);
+            }
+        }
+
+        // Copy the transforms back to the joints.
+        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+            m_lcl_transforms[i_joint] = m_depth_level_lcl_pose.getJointTransform(i_joint);
+            m_glb_transforms[i_joint] = m_depth_level_glb_pose.getJointTransform(i_joint);
+        }
+    }
 
-            Transform glb_transform =
-                Transform::combine(ref_current_joint.getLclTransform(),
-                    ref_parent_joint.getGlbTransform());
+    void Skeleton::_combineDepthLevelJoints(size_t begin, size_t end)
+    {
+        const float *lcl_streams[Pose::STREAM_COUNT];
+        float *glb_streams[Pose::STREAM_COUNT];
+        for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+            lcl_streams[i_stream] = m_depth_level_lcl_pose.getStream((Pose::Stream)i_stream);
+            glb_streams[i_stream] = m_depth_level_glb_pose.getStream((Pose::Stream)i_stream);
+        }
 
-            ref_current_joint.setGlbTransform(glb_transform);
+        // Gather a block of joints and their parents onto the stack, combine
+        // them and scatter the results back.
+        const size_t BLOCK_SIZE = 64;
+        float lcl_block[Pose::STREAM_COUNT][BLOCK_SIZE];
+        float parent_block[Pose::STREAM_COUNT][BLOCK_SIZE];
+
+        TransformBatch::ConstStreams lcl, parent;
+        TransformBatch::Streams glb;
+        for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+            lcl.streams[i_stream] = lcl_block[i_stream];
+            parent.streams[i_stream] = parent_block[i_stream];
+            glb.streams[i_stream] = lcl_block[i_stream];
+        }
+
+        for (size_t i_begin = begin; i_begin < end; i_begin += BLOCK_SIZE) {
+            const size_t block_count = std::min(BLOCK_SIZE, end - i_begin);
+            const int *joints = m_definition->getDepthLevelJoints() + i_begin;
+            const int *parents = m_definition->getDepthLevelParents() + i_begin;
+
+            for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+                for (size_t i = 0; i < block_count; ++i) {
+                    lcl_block[i_stream][i] = lcl_streams[i_stream][joints[i]];
+                    parent_block[i_stream][i] = glb_streams[i_stream][parents[i]];
+                }
+            }
+
+            TransformBatch::combine(block_count, lcl, parent, glb);
+
+            for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+                for (size_t i = 0; i < block_count; ++i)
+                    glb_streams[i_stream][joints[i]] = lcl_block[i_stream][i];
+            }
         }
     }
 
@@ -3,24 +3,54 @@
 #include "s_precomp.h"
 #include "s_prerequisites.h"
 #include "s_joint.h"
+#include "s_skeleton_definition.h"
 #include "s_matrixua4.h"
+#include "s_pose.h"
+#include "s_skinning_palette.h"
 
 namespace Skanim
 {
+    class JobSystem;
+
     /** A skeleton deforms a skinned mesh in games by generating a matrices 
      *  palette based on the current skeleton pose. A skeleton's pose is 
-     *  extracted from animation clips. Skeleton contains joints which are
-     *  organized in a hierarchy structure. Each joint's could be queried 
-     *  from the skeleton.
+     *  extracted from animation clips.
+     *  A skeleton is an instance of a skeleton definition, which holds the
+     *  joint hierarchy, names and binding pose and is shared by all its
+     *  instances. The skeleton itself only holds the current local and global
+     *  transforms of the joints and the palette.
      */
     class _SKANIM_EXPORT Skeleton
     {
     public:
 
-        /** Construct skeleton.
+        /** Construct a skeleton without joints.
          */
         Skeleton() noexcept;
 
+        /** Construct a skeleton as an instance of a frozen definition. The
+         *  joints are in the binding pose.
+         */
+        explicit Skeleton(const SkeletonDefinition *definition);
+
+        Skeleton(const Skeleton &other);
+
+        ~Skeleton();
+
+        Skeleton &operator=(const Skeleton &other);
+
+        /** Get the definition of this skeleton, or nullptr if it has none.
+         */
+        const SkeletonDefinition *getDefinition() const
+        {
+            return m_definition;
+        }
+
+        /** Make this skeleton an instance of another frozen definition, which
+         *  could be nullptr. The joints are reset to the binding pose.
+         */
+        void setDefinition(const SkeletonDefinition *definition);
+
         /** Check if root motion is enabled.
          */
         bool isRootMotionEnabled() const 
@@ -40,72 +70,187 @@ namespace Skanim
          */
         size_t getJointCount() const
         {
-            return m_joint_hierarchy_array.size();
+            return m_lcl_transforms.size();
+        }
+
+        /** Get the current local transform of a joint.
+         */
+        const Transform &getJointLclTransform(size_t index) const
+        {
+            assert(index < m_lcl_transforms.size() && "index out of range");
+            return m_lcl_transforms[index];
+        }
+
+        /** Get the current global transform of a joint.
+         */
+        const Transform &getJointGlbTransform(size_t index) const
+        {
+            assert(index < m_glb_transforms.size() && "index out of range");
+            return m_glb_transforms[index];
         }
 
-        /** Get a joint by its index.
+        /** Get the level of detail of this skeleton.
          */
-        Joint *getJoint(size_t index)
+        size_t getLodLevel() const
         {
-            assert(index < m_joint_hierarchy_array.size() && 
-                "index out of range");
-            return &m_joint_hierarchy_array[index];
+            return m_lod_level;
         }
 
-        /** Find a joint by its name.
+        /** Modify the level of detail of this skeleton. Only the joints which
+         *  are animated at the level are read from the poses given to
+         *  setPose(), the other joints return to their binding local
+         *  transforms and follow their parents rigidly.
          */
-        Joint *findJoint(const String &name);
+        void setLodLevel(size_t level);
 
-        /** Add a joint to this skeleton in pre-order and attach it to a parent 
-         *  joint. The name of the joint being added must be unique in a skeleton.
-         *  If the added joint has old parent or children indices then those indices 
-         *  will be ignored.
+        /** Check if global transforms are propagated by depth levels.
          */
-        void addJointPreOrder(const Joint &joint, int parent_index);
+        bool isDepthLevelPropagationEnabled() const
+        {
+            return m_is_depth_level_propagation_enabled;
+        }
+
+        /** Toggle the propagation by depth levels. Joints are grouped by their
+         *  depth in the definition, and all the joints at the same depth are
+         *  combined with their parents in SIMD batches, one level after
+         *  another. It pays off for very large skeletons, for small ones the
+         *  joint by joint propagation is faster.
+         */
+        void setDepthLevelPropagationEnabled(bool enable);
 
         /** Set the skeleton's current pose by given a local space pose.
+         *  @param job_system If it's not nullptr and the propagation by depth
+         *  levels is enabled, large levels are spread across its workers.
          */
-        void setPose(const Pose &local_pose);
+        void setPose(const Pose &local_pose, JobSystem *job_system = nullptr);
 
         typedef vector<MatrixUA4> MatricesVector;
         typedef MatricesVector::iterator MatricesVectorIterator;
         typedef MatricesVector::const_iterator MatricesVectorConstIterator;
 
         /** Get the skinning matrices palette. The skinning matrices generation is 
-         *  delayed until this function is called.
+         *  delayed until this function is called, and only the matrices of joints
+         *  whose global transforms changed are regenerated.
          */
         const MatricesVector &getSkinningMatricesPalette();
 
+        /** Get the beginning of the range of skinning matrices which changed in
+         *  the last call of getSkinningMatricesPalette() or
+         *  updateSkinningPalette(). Only the entries in
+         *  [getPaletteDirtyBegin(), getPaletteDirtyEnd()) need to be uploaded
+         *  again, the range is empty if both are equal.
+         */
+        size_t getPaletteDirtyBegin() const
+        {
+            return m_palette_dirty_begin;
+        }
+
+        /** Get the end of the range of skinning matrices which changed in the
+         *  last call of getSkinningMatricesPalette() or updateSkinningPalette().
+         */
+        size_t getPaletteDirtyEnd() const
+        {
+            return m_palette_dirty_end;
+        }
+
+        /** Get the number of skinning matrices in the palette, which is the
+         *  number of non-dummy joints.
+         */
+        size_t getSkinningMatrixCount() const
+        {
+            return m_skinning_matrices_palette.size();
+        }
+
+        /** Generate the skinning matrices palette from the current pose into
+         *  the given buffer, which must hold getSkinningMatrixCount() matrices.
+         *  The skeleton's own palette isn't touched.
+         */
+        void writeSkinningMatricesPalette(MatrixUA4 *palette) const;
+
+        /** Get the size in bytes of the skinning palette in the given format.
+         */
+        size_t getSkinningPaletteSize(SkinningPalette::Format format) const
+        {
+            return getSkinningMatrixCount() * SkinningPalette::getEntrySize(format);
+        }
+
+        /** Generate the skinning palette from the current pose in the given
+         *  format directly into the buffer, which must hold
+         *  getSkinningPaletteSize(format) bytes. The buffer could be mapped GPU
+         *  memory, it's only written. All the entries are written, use
+         *  updateSkinningPalette() to keep a buffer up to date.
+         */
+        void writeSkinningPalette(SkinningPalette::Format format, void *buffer) const;
+
+        /** Update a skinning palette in the given format which was written by
+         *  writeSkinningPalette() or by this method before. Like
+         *  getSkinningMatricesPalette(), only the entries of the joints whose
+         *  global transforms changed are written, and their range is given by
+         *  getPaletteDirtyBegin() and getPaletteDirtyEnd(). Both methods
+         *  consume the same changes, so the buffer misses those consumed by
+         *  getSkinningMatricesPalette() in between.
+         */
+        void updateSkinningPalette(SkinningPalette::Format format, void *buffer);
+
         /** Modify the root joint's global transform.
          */
         void setRootJointTransform(const Transform &transform);
 
+        /** Modify a joint's local transform, for example after IK or an
+         *  additive layer changed a limb. Only the joint's sub hierarchy is
+         *  updated and regenerated in the next palette update.
+         */
+        void setJointLclTransform(size_t joint_index, const Transform &transform);
+
     private:
 
-        // Update the skinning matrices palette.
-        void _updateSkinningMatricesPalette();
+        // Update the skinning matrices palette, and the entries of the dirty
+        // joints in a palette of the given format if buffer isn't nullptr.
+        void _updateSkinningMatricesPalette(
+            SkinningPalette::Format format = SkinningPalette::FORMAT_MATRIX_4X4,
+            void *buffer = nullptr);
+
+        // Gather the non-dummy joints in blocks, combine their inverse binding
+        // and global transforms and pass each block of skinning transforms to
+        // write_block(count, skinning_transforms, skinning_ids).
+        // Only joints whose flags in joint_filter are set are gathered if
+        // joint_filter isn't nullptr.
+        template <typename F>
+        void _forEachSkinningBlock(const unsigned char *joint_filter,
+            F write_block) const;
+
+        // Mark a joint's global transform as changed since the last palette
+        // update.
+        void _markJointDirty(size_t joint_index)
+        {
+            m_dirty_joints[joint_index] = 1;
+            m_palette_needs_update = true;
+        }
+
+        // Mark all joints' global transforms as changed.
+        void _markAllJointsDirty();
 
-        // Update sub-part of the joint hierarchy which begins with begin_root_index.
+        // Update sub-part of the joint hierarchy which begins with begin_root_index,
+        // and mark its joints dirty.
         void _updateSubHierarchyGlbTransform(int begin_root_index);
 
-    private:
+        // Update the global transforms of all joints by depth levels from the
+        // local transforms in m_depth_level_lcl_pose.
+        void _updateGlbTransformsByDepthLevels(JobSystem *job_system);
 
-        typedef vector<Joint> _JointVector;
-        typedef _JointVector::iterator _JointVectorIterator;
-        typedef _JointVector::const_iterator _JointVectorConstIterator;
+        // Combine the joints in range [begin, end) of the definition's depth
+        // level joints with their parents.
+        void _combineDepthLevelJoints(size_t begin, size_t end);
 
-        // The joint hierarchy is stored in an array.
-        // Each joint's index is the pre-order number in a tree structure.
-        _JointVector m_joint_hierarchy_array;
+    private:
 
-        typedef unordered_map<String, int> _JointNamesMap;
-        typedef _JointNamesMap::iterator _JointNamesMapIterator;
-        typedef _JointNamesMap::const_iterator _JointNamesMapConstIterator;
+        // The shared definition, which this skeleton holds a reference to.
+        const SkeletonDefinition *m_definition;
 
-        // The names map that stores joints with its name as key and its index
-        // as value. The map provides a convienient way to look up a joint by
-        // its name.
-        _JointNamesMap m_joint_names_map;
+        // The current local and global transforms of the joints, indexed like
+        // the definition's joints.
+        std::vector<Transform, Allocator<Transform, MEMORY_CATEGORY_SKELETON>> m_lcl_transforms;
+        std::vector<Transform, Allocator<Transform, MEMORY_CATEGORY_SKELETON>> m_glb_transforms;
 
         // Indicate if root motion is enabled.
         bool m_is_root_motion_enabled;
@@ -115,6 +260,24 @@ namespace Skanim
         // The skeleton delays the skinning matrices palette generation until it's
         // needed. So here is a boolean flag indicates if the palette need an update.
         bool m_palette_needs_update;
+
+        // A flag per joint which is set if the joint's global transform changed
+        // since the last palette update.
+        vector<unsigned char> m_dirty_joints;
+        // The range of skinning matrices changed by the last palette update.
+        size_t m_palette_dirty_begin;
+        size_t m_palette_dirty_end;
+
+        // Indicate if global transforms are propagated by depth levels.
+        bool m_is_depth_level_propagation_enabled;
+
+        // The level of detail of the skeleton's definition.
+        size_t m_lod_level;
+
+        // The local and the global transforms of all joints in structure-of-
+        // arrays layout, used by the propagation by depth levels.
+        Pose m_depth_level_lcl_pose;
+        Pose m_depth_level_glb_pose;
     };
 
     
@@ -0,0 +1,209 @@
+#include "s_precomp.h"
+#include "s_skeleton_definition.h"
+#include "s_memory_config.h"
+
+namespace Skanim
+{
+    SkeletonDefinition::SkeletonDefinition() noexcept
+        : m_skinning_matrix_count(0),
+          m_is_frozen(false),
+          m_ref_count(1)
+    {}
+
+    SkeletonDefinition *SkeletonDefinition::create()
+    {
+        return SKANIM_NEW_T(SkeletonDefinition);
+    }
+
+    void SkeletonDefinition::release() const
+    {
+        assert(m_ref_count > 0 && "the definition is already released");
+
+        if (--m_ref_count == 0)
+            SKANIM_DELETE_T(SkeletonDefinition, const_cast<SkeletonDefinition*>(this));
+    }
+
+    int SkeletonDefinition::findJointIndex(JointId id) const
+    {
+        if (m_joint_id_table.empty())
+            return Joint::INDEX_NULL;
+
+        // Probe linearly from the id's home slot until the id or an unused
+        // slot is found.
+        const size_t mask = m_joint_id_table.size() - 1;
+        for (size_t i_slot = id.getHash() & mask; ; i_slot = (i_slot + 1) & mask) {
+            const int joint_index = m_joint_id_table[i_slot];
+            if (joint_index == Joint::INDEX_NULL || m_joint_ids[joint_index] == id)
+                return joint_index;
+        }
+    }
+
+    void SkeletonDefinition::findJointIndices(const JointId *ids, size_t count,
+        int *indices) const
+    {
+        for (size_t i = 0; i < count; ++i)
+            indices[i] = findJointIndex(ids[i]);
+    }
+
+    bool SkeletonDefinition::addJointPreOrder(const Joint &joint, int parent_index)
+    {
+        assert(!m_is_frozen && "the definition is frozen.");
+        assert(parent_index >= Joint::INDEX_NULL && parent_index <
+            (int)m_parent_indices.size() && "parent_index is not valid.");
+
+        // Ids are looked up without comparing the names, so they must be
+        // unique.
+        const JointId joint_id(joint.getName());
+        if (findJointIndex(joint_id) != Joint::INDEX_NULL)
+            return false;
+
+        const int new_joint_index = m_parent_indices.size();
+
+        m_parent_indices.push_back(parent_index);
+        m_binding_lcl_transforms.push_back(joint.getLclTransform());
+        m_inv_glb_binding_transforms.push_back(joint.getInvGlbBindingTransform());
+        m_skinning_ids.push_back(joint.getSkinningId());
+        m_joint_names.push_back(joint.getName());
+        m_joint_ids.push_back(joint_id);
+
+        // Keep the id table at most half full.
+        if (m_joint_ids.size() * 2 > m_joint_id_table.size())
+            _rebuildJointIdTable(std::max<size_t>(m_joint_id_table.size() * 2, 16));
+        else
+            _insertJointId(new_joint_index);
+
+        // The new joint has no children yet.
+        if (m_child_offsets.empty())
+            m_child_offsets.push_back(0);
+        m_child_offsets.push_back(m_child_offsets.back());
+
+        // If the added joint is not a root joint, append it to its parent's
+        // children, which shifts the children of all the joints after the
+        // parent.
+        if (parent_index != Joint::INDEX_NULL) {
+            m_child_indices.insert(m_child_indices.begin() +
+                m_child_offsets[parent_index + 1], new_joint_index);
+            for (size_t i = parent_index + 1; i < m_child_offsets.size(); ++i)
+                ++m_child_offsets[i];
+        }
+
+        // A non-dummy joint needs a skinning matrix.
+        if (joint.isDummy() == false)
+            ++m_skinning_matrix_count;
+
+        return true;
+    }
+
+    size_t SkeletonDefinition::addLodLevel(const vector<JointRange> &ranges,
+        unsigned int update_interval)
+    {
+        assert(!m_is_frozen && "the definition is frozen.");
+        assert(update_interval > 0 && "update_interval must be positive.");
+        for (size_t i_range = 0; i_range < ranges.size(); ++i_range) {
+            assert(ranges[i_range].begin <= ranges[i_range].end &&
+                "joint range is reversed.");
+            assert((i_range == 0 || ranges[i_range - 1].end <= ranges[i_range].begin) &&
+                "ranges are not sorted or overlap.");
+        }
+
+        _LodLevel level;
+        level.ranges = ranges;
+        level.update_interval = update_interval;
+
+        // The root is always animated for the root motion.
+        if (level.ranges.empty() || level.ranges.front().begin > 0) {
+            const JointRange root_range = { 0, 1 };
+            if (!level.ranges.empty() && level.ranges.front().begin == 1)
+                level.ranges.front().begin = 0;
+            else
+                level.ranges.insert(level.ranges.begin(), root_range);
+        }
+
+        m_lod_levels.push_back(level);
+
+        // Level 0 isn't inserted yet.
+        return m_lod_levels.size();
+    }
+
+    void SkeletonDefinition::freeze()
+    {
+        if (m_is_frozen)
+            return;
+
+        _buildDepthLevels();
+        _buildLodJointMasks();
+        m_is_frozen = true;
+    }
+
+    void SkeletonDefinition::_buildDepthLevels()
+    {
+        const size_t joint_count = m_parent_indices.size();
+
+        // Joints are stored in pre-order, so a joint's parent always comes
+        // before it and its depth is known already.
+        vector<size_t> depths(joint_count, 0);
+        size_t level_count = joint_count > 0 ? 1 : 0;
+        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+            const int parent_index = m_parent_indices[i_joint];
+            if (parent_index != Joint::INDEX_NULL) {
+                depths[i_joint] = depths[parent_index] + 1;
+                level_count = std::max(level_count, depths[i_joint] + 1);
+            }
+        }
+
+        // Counting sort the joints by depth. Joints of a level stay in
+        // pre-order, so siblings are near each other.
+        m_depth_level_offsets.assign(level_count + 1, 0);
+        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint)
+            ++m_depth_level_offsets[depths[i_joint] + 1];
+        for (size_t i_level = 0; i_level < level_count; ++i_level)
+            m_depth_level_offsets[i_level + 1] += m_depth_level_offsets[i_level];
+
+        vector<size_t> level_ends(m_depth_level_offsets.begin(),
+            m_depth_level_offsets.end() - 1);
+        m_depth_level_joints.resize(joint_count);
+        m_depth_level_parents.resize(joint_count);
+        for (size_t i_joint = 0; i_joint < joint_count; ++i_joint) {
+            const size_t position = level_ends[depths[i_joint]]++;
+            m_depth_level_joints[position] = (int)i_joint;
+            m_depth_level_parents[position] = m_parent_indices[i_joint];
+        }
+    }
+
+    void SkeletonDefinition::_rebuildJointIdTable(size_t slot_count)
+    {
+        m_joint_id_table.assign(slot_count, (int)Joint::INDEX_NULL);
+        for (size_t i_joint = 0; i_joint < m_joint_ids.size(); ++i_joint)
+            _insertJointId((int)i_joint);
+    }
+
+    void SkeletonDefinition::_insertJointId(int joint_index)
+    {
+        const size_t mask = m_joint_id_table.size() - 1;
+        size_t i_slot = m_joint_ids[joint_index].getHash() & mask;
+        while (m_joint_id_table[i_slot] != Joint::INDEX_NULL)
+            i_slot = (i_slot + 1) & mask;
+
+        m_joint_id_table[i_slot] = joint_index;
+    }
+
+    void SkeletonDefinition::_buildLodJointMasks()
+    {
+        const size_t joint_count = m_parent_indices.size();
+
+        m_lod_joint_masks.assign(m_lod_levels.size() * joint_count, 0);
+        for (size_t i_level = 0; i_level < m_lod_levels.size(); ++i_level) {
+            unsigned char *mask = m_lod_joint_masks.data() + i_level * joint_count;
+            for (const JointRange &range : m_lod_levels[i_level].ranges) {
+                assert(range.begin <= range.end && range.end <= joint_count &&
+                    "joint range out of range");
+                std::fill(mask + range.begin, mask + range.end, 1);
+            }
+        }
+
+        // Insert the full skeleton as level 0.
+        _LodLevel full_level;
+        full_level.update_interval = 1;
+        m_lod_levels.insert(m_lod_levels.begin(), full_level);
+    }
+};
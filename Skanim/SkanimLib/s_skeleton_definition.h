@@ -0,0 +1,336 @@
+#pragma once
+
+#include "s_precomp.h"
+#include "s_prerequisites.h"
+#include "s_joint.h"
+#include "s_joint_id.h"
+#include "s_pose.h"
+#include "s_transform.h"
+
+namespace Skanim
+{
+    /** Skeleton definition is the immutable part of a skeleton: the joint
+     *  hierarchy, the names, the binding pose and the skinning ids. It's
+     *  reference counted and shared by all the skeletons which are instances
+     *  of it, so a crowd of identical characters keeps a single copy.
+     *  Joints are added to a definition in pre-order, then the definition is
+     *  frozen and no joint could be added anymore. Skeletons could only be
+     *  created from a frozen definition.
+     */
+    class _SKANIM_EXPORT SkeletonDefinition
+    {
+    public:
+
+        /** Create an empty definition. The caller holds a reference to it and
+         *  has to release it.
+         */
+        static SkeletonDefinition *create();
+
+        /** Add a reference to this definition.
+         */
+        void addReference() const
+        {
+            ++m_ref_count;
+        }
+
+        /** Release a reference to this definition. The definition is
+         *  destroyed when the last reference is released.
+         */
+        void release() const;
+
+        /** Get the number of references to this definition.
+         */
+        size_t getReferenceCount() const
+        {
+            return m_ref_count;
+        }
+
+        /** Add a joint to this definition in pre-order and attach it to a
+         *  parent joint. The joint's local transform is its transform in the
+         *  binding pose.
+         *  @return false if the id of the joint's name is already used by
+         *  another joint, because the names are the same or their ids
+         *  collide. The joint isn't added then.
+         */
+        bool addJointPreOrder(const Joint &joint, int parent_index);
+
+        /** Add a level of detail. Only the joints in the given ranges are
+         *  animated at the level, the other joints keep their binding local
+         *  transforms and follow their parents rigidly. The ranges must be
+         *  sorted and must not overlap, the root joint is always animated.
+         *  Level 0 is the full skeleton and the added levels are numbered
+         *  from 1.
+         *  @param update_interval Characters at the level are updated every
+         *  update_interval frames by a character batch.
+         *  @return The added level.
+         */
+        size_t addLodLevel(const vector<JointRange> &ranges,
+            unsigned int update_interval);
+
+        /** Freeze this definition after all joints and levels of detail are
+         *  added.
+         */
+        void freeze();
+
+        /** Check if this definition is frozen.
+         */
+        bool isFrozen() const
+        {
+            return m_is_frozen;
+        }
+
+        /** Get the number of joint in this definition.
+         */
+        size_t getJointCount() const
+        {
+            return m_parent_indices.size();
+        }
+
+        /** Get the number of non-dummy joints, which is the number of skinning
+         *  matrices of a skeleton.
+         */
+        size_t getSkinningMatrixCount() const
+        {
+            return m_skinning_matrix_count;
+        }
+
+        /** Find a joint's index by its id. Return Joint::INDEX_NULL if there
+         *  is no such joint.
+         */
+        int findJointIndex(JointId id) const;
+
+        /** Find a joint's index by its name. Return Joint::INDEX_NULL if there
+         *  is no such joint, also if the name's id is used by a joint of
+         *  another name.
+         */
+        int findJointIndex(const String &name) const
+        {
+            const int index = findJointIndex(JointId(name));
+            return index != Joint::INDEX_NULL && m_joint_names[index] == name ?
+                index : (int)Joint::INDEX_NULL;
+        }
+
+        /** Resolve count joint ids to indices at once, so that the indices
+         *  could be cached instead of looking the joints up repeatedly. An id
+         *  of no joint resolves to Joint::INDEX_NULL.
+         */
+        void findJointIndices(const JointId *ids, size_t count, int *indices) const;
+
+        /** Get the id of a joint's name.
+         */
+        JointId getJointId(size_t index) const
+        {
+            assert(index < m_joint_ids.size() && "index out of range");
+            return m_joint_ids[index];
+        }
+
+        /** Get the name of a joint.
+         */
+        const String &getJointName(size_t index) const
+        {
+            assert(index < m_joint_names.size() && "index out of range");
+            return m_joint_names[index];
+        }
+
+        /** Get the parent index of a joint, which is Joint::INDEX_NULL for the
+         *  root.
+         */
+        int getParentIndex(size_t index) const
+        {
+            assert(index < m_parent_indices.size() && "index out of range");
+            return m_parent_indices[index];
+        }
+
+        /** Get the parent indices of all the joints.
+         */
+        const int *getParentIndices() const
+        {
+            return m_parent_indices.data();
+        }
+
+        /** Get the skinning id of a joint, which is Joint::SKINNING_ID_NULL
+         *  for a dummy joint.
+         */
+        int getSkinningId(size_t index) const
+        {
+            assert(index < m_skinning_ids.size() && "index out of range");
+            return m_skinning_ids[index];
+        }
+
+        /** Get the number of children of a joint.
+         */
+        size_t getChildCount(size_t index) const
+        {
+            assert(index < m_parent_indices.size() && "index out of range");
+            return m_child_offsets[index + 1] - m_child_offsets[index];
+        }
+
+        /** Get the index of the i'th child of a joint.
+         */
+        int getChildIndex(size_t index, size_t i) const
+        {
+            assert(i < getChildCount(index) && "child out of range");
+            return m_child_indices[m_child_offsets[index] + i];
+        }
+
+        /** Get the local transform of a joint in the binding pose.
+         */
+        const Transform &getBindingLclTransform(size_t index) const
+        {
+            assert(index < m_binding_lcl_transforms.size() &&
+                "index out of range");
+            return m_binding_lcl_transforms[index];
+        }
+
+        /** Get the inverse of the global binding transform of a joint.
+         */
+        const Transform &getInvGlbBindingTransform(size_t index) const
+        {
+            assert(index < m_inv_glb_binding_transforms.size() &&
+                "index out of range");
+            return m_inv_glb_binding_transforms[index];
+        }
+
+        /** Get the number of levels of detail, including the full skeleton
+         *  at level 0. Only valid after the definition is frozen.
+         */
+        size_t getLodLevelCount() const
+        {
+            return m_lod_levels.size();
+        }
+
+        /** Get the ranges of the joints which are animated at a level of
+         *  detail. It's empty at level 0 where all the joints are animated.
+         */
+        const vector<JointRange> &getLodJointRanges(size_t level) const
+        {
+            assert(level < m_lod_levels.size() && "level out of range");
+            return m_lod_levels[level].ranges;
+        }
+
+        /** Get the number of frames between two updates of a character at a
+         *  level of detail.
+         */
+        unsigned int getLodUpdateInterval(size_t level) const
+        {
+            assert(level < m_lod_levels.size() && "level out of range");
+            return m_lod_levels[level].update_interval;
+        }
+
+        /** Get a flag per joint which is set if the joint is animated at a
+         *  level of detail. It's nullptr at level 0.
+         */
+        const unsigned char *getLodJointMask(size_t level) const
+        {
+            assert(level < m_lod_levels.size() && "level out of range");
+            return level == 0 ? nullptr :
+                m_lod_joint_masks.data() + (level - 1) * m_parent_indices.size();
+        }
+
+        /** Get the number of depth levels of the hierarchy. Only valid after
+         *  the definition is frozen.
+         */
+        size_t getDepthLevelCount() const
+        {
+            return m_depth_level_offsets.empty() ? 0 :
+                m_depth_level_offsets.size() - 1;
+        }
+
+        /** Get the offsets of the depth levels. The joints of level i are in
+         *  [offsets[i], offsets[i + 1]) of getDepthLevelJoints().
+         */
+        const size_t *getDepthLevelOffsets() const
+        {
+            return m_depth_level_offsets.data();
+        }
+
+        /** Get the joint indices sorted by depth.
+         */
+        const int *getDepthLevelJoints() const
+        {
+            return m_depth_level_joints.data();
+        }
+
+        /** Get the parent index of each joint in getDepthLevelJoints().
+         */
+        const int *getDepthLevelParents() const
+        {
+            return m_depth_level_parents.data();
+        }
+
+    private:
+        friend class MemoryConfig;
+
+        SkeletonDefinition() noexcept;
+
+        ~SkeletonDefinition() = default;
+
+        SkeletonDefinition(const SkeletonDefinition &) = delete;
+
+        SkeletonDefinition &operator=(const SkeletonDefinition &) = delete;
+
+        // Group the joints by their depth.
+        void _buildDepthLevels();
+
+        // Rebuild the id table with the given number of slots, which is a
+        // power of two.
+        void _rebuildJointIdTable(size_t slot_count);
+
+        // Insert a joint into the id table.
+        void _insertJointId(int joint_index);
+
+        // Build the joint masks of the levels of detail.
+        void _buildLodJointMasks();
+
+    private:
+
+        // An array with an element per joint.
+        template <typename T>
+        using _JointArray = std::vector<T, Allocator<T, MEMORY_CATEGORY_SKELETON>>;
+
+        // Each joint's index is the pre-order number in a tree structure, so
+        // a parent always comes before its children.
+        _JointArray<int> m_parent_indices;
+        _JointArray<Transform> m_binding_lcl_transforms;
+        _JointArray<Transform> m_inv_glb_binding_transforms;
+        // Joint::SKINNING_ID_NULL for dummy joints.
+        _JointArray<int> m_skinning_ids;
+        size_t m_skinning_matrix_count;
+
+        // The children of joint i are m_child_indices[m_child_offsets[i],
+        // m_child_offsets[i + 1]).
+        _JointArray<String> m_joint_names;
+        _JointArray<int> m_child_indices;
+        _JointArray<size_t> m_child_offsets;
+
+        // The id of each joint's name.
+        _JointArray<JointId> m_joint_ids;
+        // The open addressing table which maps the ids to the joint indices.
+        // Its size is a power of two and at most half of the slots are used,
+        // unused slots are Joint::INDEX_NULL.
+        _JointArray<int> m_joint_id_table;
+
+        // Joint indices sorted by depth, and the parent index of each of them.
+        // Joints of level i are in [m_depth_level_offsets[i],
+        // m_depth_level_offsets[i + 1]). Built when the definition is frozen.
+        _JointArray<int> m_depth_level_joints;
+        _JointArray<int> m_depth_level_parents;
+        _JointArray<size_t> m_depth_level_offsets;
+
+        struct _LodLevel
+        {
+            vector<JointRange> ranges;
+            unsigned int update_interval;
+        };
+
+        // The levels of detail, the full skeleton is inserted as level 0 when
+        // the definition is frozen.
+        vector<_LodLevel> m_lod_levels;
+        // The joint masks of the levels from 1, one after another.
+        _JointArray<unsigned char> m_lod_joint_masks;
+
+        bool m_is_frozen;
+
+        mutable std::atomic<size_t> m_ref_count;
+    };
+};
@@ -0,0 +1,300 @@
+#include "s_precomp.h"
+#include "s_skinning_palette.h"
+#include "s_simd.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // The largest number of floats in an entry.
+        const size_t MAX_ENTRY_ELEMENT_COUNT = 16;
+
+        size_t _getEntryElementCount(SkinningPalette::Format format)
+        {
+            switch (format) {
+            case SkinningPalette::FORMAT_MATRIX_4X4:
+                return 16;
+            case SkinningPalette::FORMAT_MATRIX_3X4:
+            case SkinningPalette::FORMAT_MATRIX_3X4_HALF:
+                return 12;
+            default:
+                return 8;
+            }
+        }
+
+        bool _isHalfFormat(SkinningPalette::Format format)
+        {
+            return format == SkinningPalette::FORMAT_MATRIX_3X4_HALF ||
+                format == SkinningPalette::FORMAT_DUAL_QUATERNION_HALF;
+        }
+
+        // Convert a float to a half float, rounding to the nearest even.
+        uint16_t _floatToHalf(float value)
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+
+            const uint32_t sign = bits & 0x80000000u;
+            bits ^= sign;
+
+            uint32_t half;
+            if (bits >= (143u << 23)) {
+                // Too large for a half float, or infinity or NaN.
+                half = bits > (255u << 23) ? 0x7e00 : 0x7c00;
+            }
+            else if (bits < (113u << 23)) {
+                // A subnormal half float or zero, let the float addition do
+                // the rounding.
+                const uint32_t DENORM_MAGIC_BITS = 126u << 23;
+                float denorm_magic, f;
+                memcpy(&denorm_magic, &DENORM_MAGIC_BITS, sizeof(float));
+                memcpy(&f, &bits, sizeof(float));
+                f += denorm_magic;
+                memcpy(&bits, &f, sizeof(float));
+                half = bits - DENORM_MAGIC_BITS;
+            }
+            else {
+                // Rebias the exponent and round the mantissa.
+                const uint32_t mantissa_odd = (bits >> 13) & 1;
+                bits += (uint32_t)(15 - 127) << 23;
+                bits += 0xfff + mantissa_odd;
+                half = bits >> 13;
+            }
+
+            return (uint16_t)(half | (sign >> 16));
+        }
+
+        // Convert an entry to half floats.
+        void _convertToHalf(const float *entry, size_t element_count,
+            uint16_t *half_entry)
+        {
+            size_t i = 0;
+#if defined(SKANIM_SIMD_F16C)
+            for (; i + 4 <= element_count; i += 4) {
+                _mm_storel_epi64((__m128i *)(half_entry + i),
+                    _mm_cvtps_ph(_mm_load_ps(entry + i), _MM_FROUND_TO_NEAREST_INT));
+            }
+#endif
+            for (; i < element_count; ++i)
+                half_entry[i] = _floatToHalf(entry[i]);
+        }
+
+        // Write an entry into the palette buffer without reading it. Non
+        // temporal stores need both the destination and the size to be
+        // multiples of 16 bytes.
+        void _writeEntry(const void *entry, size_t size, bool is_streaming,
+            unsigned char *destination)
+        {
+#if defined(SKANIM_SIMD_AVX) || defined(SKANIM_SIMD_SSE)
+            const unsigned char *source = (const unsigned char *)entry;
+            size_t offset = 0;
+            for (; offset + 16 <= size; offset += 16) {
+                const __m128i chunk = _mm_load_si128((const __m128i *)(source + offset));
+                if (is_streaming)
+                    _mm_stream_si128((__m128i *)(destination + offset), chunk);
+                else
+                    _mm_storeu_si128((__m128i *)(destination + offset), chunk);
+            }
+            // Entries are multiples of 8 bytes.
+            if (offset < size) {
+                _mm_storel_epi64((__m128i *)(destination + offset),
+                    _mm_loadl_epi64((const __m128i *)(source + offset)));
+            }
+#else
+            (void)is_streaming;
+            memcpy(destination, entry, size);
+#endif
+        }
+
+        // Calculate the entries of Simd::WIDTH transforms starting at offset
+        // and write the first entry_count of them.
+        void _writeBlock(SkinningPalette::Format format,
+            const float *const *transforms, size_t offset, size_t entry_count,
+            const int *entry_indices, bool is_streaming, unsigned char *buffer)
+        {
+            const Simd::Float qx = Simd::loadUnaligned(transforms[Pose::STREAM_ROTATION_X] + offset);
+            const Simd::Float qy = Simd::loadUnaligned(transforms[Pose::STREAM_ROTATION_Y] + offset);
+            const Simd::Float qz = Simd::loadUnaligned(transforms[Pose::STREAM_ROTATION_Z] + offset);
+            const Simd::Float qw = Simd::loadUnaligned(transforms[Pose::STREAM_ROTATION_W] + offset);
+            const Simd::Float tx = Simd::loadUnaligned(transforms[Pose::STREAM_TRANSLATION_X] + offset);
+            const Simd::Float ty = Simd::loadUnaligned(transforms[Pose::STREAM_TRANSLATION_Y] + offset);
+            const Simd::Float tz = Simd::loadUnaligned(transforms[Pose::STREAM_TRANSLATION_Z] + offset);
+            const Simd::Float s = Simd::loadUnaligned(transforms[Pose::STREAM_SCALE] + offset);
+
+            // Each element of the entries, one entry per lane.
+            alignas(SKANIM_SIMD_ALIGNMENT) float elements[MAX_ENTRY_ELEMENT_COUNT][Simd::WIDTH];
+
+            if (format == SkinningPalette::FORMAT_DUAL_QUATERNION ||
+                format == SkinningPalette::FORMAT_DUAL_QUATERNION_HALF) {
+                // The real part is the scaled rotation r, and the dual part is
+                // the Hamilton product 0.5 * (t, 0) * r.
+                const Simd::Float rx = Simd::mul(s, qx);
+                const Simd::Float ry = Simd::mul(s, qy);
+                const Simd::Float rz = Simd::mul(s, qz);
+                const Simd::Float rw = Simd::mul(s, qw);
+                const Simd::Float half = Simd::set1(0.5f);
+
+                Simd::Float dx = Simd::mul(rw, tx);
+                dx = Simd::madd(ty, rz, dx);
+                dx = Simd::sub(dx, Simd::mul(tz, ry));
+                Simd::Float dy = Simd::mul(rw, ty);
+                dy = Simd::madd(tz, rx, dy);
+                dy = Simd::sub(dy, Simd::mul(tx, rz));
+                Simd::Float dz = Simd::mul(rw, tz);
+                dz = Simd::madd(tx, ry, dz);
+                dz = Simd::sub(dz, Simd::mul(ty, rx));
+                Simd::Float dw = Simd::mul(tx, rx);
+                dw = Simd::madd(ty, ry, dw);
+                dw = Simd::madd(tz, rz, dw);
+
+                Simd::store(elements[0], rx);
+                Simd::store(elements[1], ry);
+                Simd::store(elements[2], rz);
+                Simd::store(elements[3], rw);
+                Simd::store(elements[4], Simd::mul(half, dx));
+                Simd::store(elements[5], Simd::mul(half, dy));
+                Simd::store(elements[6], Simd::mul(half, dz));
+                Simd::store(elements[7], Simd::sub(Simd::zero(), Simd::mul(half, dw)));
+            }
+            else {
+                // The same as MatrixUA4::fromSQT().
+                const Simd::Float fx = Simd::add(qx, qx);
+                const Simd::Float fy = Simd::add(qy, qy);
+                const Simd::Float fz = Simd::add(qz, qz);
+                const Simd::Float fwx = Simd::mul(fx, qw);
+                const Simd::Float fwy = Simd::mul(fy, qw);
+                const Simd::Float fwz = Simd::mul(fz, qw);
+                const Simd::Float fxx = Simd::mul(fx, qx);
+                const Simd::Float fxy = Simd::mul(fy, qx);
+                const Simd::Float fxz = Simd::mul(fz, qx);
+                const Simd::Float fyy = Simd::mul(fy, qy);
+                const Simd::Float fyz = Simd::mul(fz, qy);
+                const Simd::Float fzz = Simd::mul(fz, qz);
+                const Simd::Float one = Simd::set1(1.0f);
+
+                const Simd::Float m00 = Simd::mul(s, Simd::sub(one, Simd::add(fyy, fzz)));
+                const Simd::Float m01 = Simd::mul(s, Simd::add(fxy, fwz));
+                const Simd::Float m02 = Simd::mul(s, Simd::sub(fxz, fwy));
+                const Simd::Float m10 = Simd::mul(s, Simd::sub(fxy, fwz));
+                const Simd::Float m11 = Simd::mul(s, Simd::sub(one, Simd::add(fxx, fzz)));
+                const Simd::Float m12 = Simd::mul(s, Simd::add(fyz, fwx));
+                const Simd::Float m20 = Simd::mul(s, Simd::add(fxz, fwy));
+                const Simd::Float m21 = Simd::mul(s, Simd::sub(fyz, fwx));
+                const Simd::Float m22 = Simd::mul(s, Simd::sub(one, Simd::add(fxx, fyy)));
+
+                if (format == SkinningPalette::FORMAT_MATRIX_4X4) {
+                    const Simd::Float zero = Simd::zero();
+                    Simd::store(elements[0], m00);
+                    Simd::store(elements[1], m01);
+                    Simd::store(elements[2], m02);
+                    Simd::store(elements[3], zero);
+                    Simd::store(elements[4], m10);
+                    Simd::store(elements[5], m11);
+                    Simd::store(elements[6], m12);
+                    Simd::store(elements[7], zero);
+                    Simd::store(elements[8], m20);
+                    Simd::store(elements[9], m21);
+                    Simd::store(elements[10], m22);
+                    Simd::store(elements[11], zero);
+                    Simd::store(elements[12], tx);
+                    Simd::store(elements[13], ty);
+                    Simd::store(elements[14], tz);
+                    Simd::store(elements[15], one);
+                }
+                else {
+                    Simd::store(elements[0], m00);
+                    Simd::store(elements[1], m10);
+                    Simd::store(elements[2], m20);
+                    Simd::store(elements[3], tx);
+                    Simd::store(elements[4], m01);
+                    Simd::store(elements[5], m11);
+                    Simd::store(elements[6], m21);
+                    Simd::store(elements[7], ty);
+                    Simd::store(elements[8], m02);
+                    Simd::store(elements[9], m12);
+                    Simd::store(elements[10], m22);
+                    Simd::store(elements[11], tz);
+                }
+            }
+
+            const size_t element_count = _getEntryElementCount(format);
+            const size_t entry_size = SkinningPalette::getEntrySize(format);
+            const bool is_half = _isHalfFormat(format);
+
+            alignas(16) float entry[MAX_ENTRY_ELEMENT_COUNT];
+            alignas(16) uint16_t half_entry[MAX_ENTRY_ELEMENT_COUNT];
+            for (size_t i = 0; i < entry_count; ++i) {
+                for (size_t i_element = 0; i_element < element_count; ++i_element)
+                    entry[i_element] = elements[i_element][i];
+
+                if (is_half)
+                    _convertToHalf(entry, element_count, half_entry);
+
+                const size_t entry_index = entry_indices ?
+                    (size_t)entry_indices[i] : offset + i;
+                _writeEntry(is_half ? (const void *)half_entry : entry, entry_size,
+                    is_streaming, buffer + entry_index * entry_size);
+            }
+        }
+    }
+
+    size_t SkinningPalette::getEntrySize(Format format)
+    {
+        assert(format >= 0 && format < FORMAT_COUNT && "invalid palette format");
+
+        const size_t element_size = _isHalfFormat(format) ?
+            sizeof(uint16_t) : sizeof(float);
+        return _getEntryElementCount(format) * element_size;
+    }
+
+    void SkinningPalette::write(Format format, size_t count,
+        const TransformBatch::ConstStreams &transforms,
+        const int *entry_indices, void *buffer)
+    {
+        assert(format >= 0 && format < FORMAT_COUNT && "invalid palette format");
+
+        unsigned char *bytes = (unsigned char *)buffer;
+        const bool is_streaming = ((uintptr_t)buffer & 15) == 0 &&
+            getEntrySize(format) % 16 == 0;
+
+        size_t i = 0;
+        for (; i + Simd::WIDTH <= count; i += Simd::WIDTH) {
+            _writeBlock(format, transforms.streams, i, Simd::WIDTH,
+                entry_indices ? entry_indices + i : nullptr, is_streaming, bytes);
+        }
+
+        // Copy the remaining transforms into a block padded with identity.
+        if (i < count) {
+            const float IDENTITY[Pose::STREAM_COUNT] = {
+                0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+            float block[Pose::STREAM_COUNT][Simd::WIDTH];
+            const float *block_streams[Pose::STREAM_COUNT];
+            for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+                for (size_t i_lane = 0; i_lane < Simd::WIDTH; ++i_lane) {
+                    block[i_stream][i_lane] = i + i_lane < count ?
+                        transforms.streams[i_stream][i + i_lane] : IDENTITY[i_stream];
+                }
+                block_streams[i_stream] = block[i_stream];
+            }
+
+            // The block starts at offset 0, so give it explicit entry indices
+            // when there are none.
+            int block_indices[Simd::WIDTH];
+            for (size_t i_lane = 0; i_lane < count - i; ++i_lane) {
+                block_indices[i_lane] = entry_indices ?
+                    entry_indices[i + i_lane] : (int)(i + i_lane);
+            }
+            _writeBlock(format, block_streams, 0, count - i, block_indices,
+                is_streaming, bytes);
+        }
+
+#if defined(SKANIM_SIMD_AVX) || defined(SKANIM_SIMD_SSE)
+        // Make the non-temporal stores visible before the buffer is handed to
+        // the GPU.
+        if (is_streaming)
+            _mm_sfence();
+#endif
+    }
+
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_transform_batch.h"
+
+namespace Skanim
+{
+    /** Skinning palette writes skinning transforms into GPU friendly formats.
+     *  Entries are written straight into the caller's buffer, which could be
+     *  mapped write-combined memory, so the buffer is never read and each
+     *  entry is written in whole with non-temporal stores when the buffer is
+     *  16 bytes aligned.
+     */
+    class _SKANIM_EXPORT SkinningPalette
+    {
+    public:
+        /** Palette entry formats.
+         */
+        enum Format
+        {
+            // MatrixUA4, 16 floats, 64 bytes.
+            FORMAT_MATRIX_4X4,
+            // The transposed upper 4x3 part of MatrixUA4 in row-major order.
+            // Each row dots with (x, y, z, 1) to give one coordinate of the
+            // transformed point. 12 floats, 48 bytes.
+            FORMAT_MATRIX_3X4,
+            // FORMAT_MATRIX_3X4 in half floats, 24 bytes.
+            FORMAT_MATRIX_3X4_HALF,
+            // A unit dual quaternion whose both parts are multiplied by the
+            // uniform scale, the real part (x, y, z, w) followed by the dual
+            // part (x, y, z, w). The length of the real part is the scale, so
+            // shaders divide both parts by it after blending. 8 floats, 32
+            // bytes.
+            FORMAT_DUAL_QUATERNION,
+            // FORMAT_DUAL_QUATERNION in half floats, 16 bytes.
+            FORMAT_DUAL_QUATERNION_HALF,
+            FORMAT_COUNT
+        };
+
+        /** Get the size of an entry in bytes.
+         */
+        static size_t getEntrySize(Format format);
+
+        /** Write count skinning transforms into the buffer. Transform i goes to
+         *  entry entry_indices[i], or to entry i if entry_indices is nullptr.
+         */
+        static void write(Format format, size_t count,
+            const TransformBatch::ConstStreams &transforms,
+            const int *entry_indices, void *buffer);
+    };
+};
@@ -0,0 +1,374 @@
+#include "s_precomp.h"
+#include "s_streaming_animation_clip.h"
+#include "s_animation_state.h"
+#include "s_interleaved_animation_clip.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // The number of bytes read to find the layout of a clip asset, which
+        // is enough for its header and any reasonable name.
+        const size_t HEAD_SIZE = 4096;
+    }
+
+    StreamingAnimationClip::StreamingAnimationClip(size_t block_segment_count,
+        size_t window_block_count) noexcept
+        : m_track_count(0),
+          m_key_count(0),
+          m_key_pose_interval(0),
+          m_key_data_offset(0),
+          m_segment_count(0),
+          m_block_segment_count(block_segment_count),
+          m_block_count(0),
+          m_block_size(0),
+          m_blocks(std::max(window_block_count, (size_t)2)),
+          m_is_stopping(false),
+          m_animation_state(nullptr),
+          m_prefetch_time(1000),
+          m_miss_count(0),
+          m_has_read_error(false)
+    {
+        assert(block_segment_count > 0 && "block segment count can't be 0");
+    }
+
+    StreamingAnimationClip::~StreamingAnimationClip()
+    {
+        close();
+    }
+
+    BinaryAsset::Status StreamingAnimationClip::open(const String &file_name)
+    {
+        close();
+
+        if (!m_stream.open(file_name))
+            return BinaryAsset::STATUS_IO_ERROR;
+
+        // Read the beginning of the asset to find the key data.
+        const uint64_t head_size = std::min(m_stream.getSize(), (uint64_t)HEAD_SIZE);
+        vector<float> head((size_t)(head_size + sizeof(float) - 1) / sizeof(float));
+        if (!m_stream.read(0, head.data(), (size_t)head_size)) {
+            m_stream.close();
+            return BinaryAsset::STATUS_IO_ERROR;
+        }
+
+        BinaryAsset::AnimationClipLayout layout;
+        const BinaryAsset::Status status = BinaryAsset::readAnimationClipLayout(
+            head.data(), (size_t)head_size, m_stream.getSize(), &layout);
+        if (status != BinaryAsset::STATUS_OK) {
+            m_stream.close();
+            return status;
+        }
+
+        m_track_count = layout.track_count;
+        m_key_count = layout.key_count;
+        m_key_pose_interval = layout.key_pose_interval;
+        m_key_data_offset = layout.key_data_offset;
+        m_name.assign(layout.name, layout.name_length);
+
+        m_segment_count = InterleavedAnimationClip::getSegmentCount(m_key_count);
+        m_block_count = (m_segment_count + m_block_segment_count - 1) /
+            m_block_segment_count;
+        m_block_size = InterleavedAnimationClip::getSegmentSize(m_track_count) *
+            m_block_segment_count;
+
+        // The window is allocated once, blocks are read into it in place.
+        for (auto &block : m_blocks) {
+            block.index = 0;
+            block.state = _BLOCK_STATE_EMPTY;
+            block.pin_count = 0;
+            block.key_data.resize(m_block_size);
+        }
+        m_read_queue.clear();
+        m_read_queue.reserve(m_blocks.size());
+
+        m_is_stopping = false;
+        m_io_thread = std::thread(&StreamingAnimationClip::_ioLoop, this);
+        return BinaryAsset::STATUS_OK;
+    }
+
+    void StreamingAnimationClip::close()
+    {
+        if (!m_stream.isOpen())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+        m_read_requested.notify_one();
+        m_io_thread.join();
+
+        m_stream.close();
+        m_key_count = 0;
+        m_track_count = 0;
+    }
+
+    void StreamingAnimationClip::extractPose(long local_time,
+        Pose *extracted_pose) const
+    {
+        _extractPose(local_time, nullptr, 0, extracted_pose);
+    }
+
+    void StreamingAnimationClip::extractPose(long local_time,
+        const JointRange *ranges, size_t range_count, Pose *extracted_pose) const
+    {
+        _extractPose(local_time, ranges, range_count, extracted_pose);
+    }
+
+    void StreamingAnimationClip::_extractPose(long local_time,
+        const JointRange *ranges, size_t range_count, Pose *extracted_pose) const
+    {
+        assert(m_stream.isOpen() && "the clip isn't open");
+        assert(local_time >= 0 && local_time <= getLength() &&
+            "local time out of range");
+        assert(m_key_count > 0 && "no key pose in the clip");
+
+        // Find the segment. The time of the last key pose falls at the end of
+        // the last segment.
+        size_t i_segment = 0;
+        if (m_key_pose_interval > 0)
+            i_segment = std::min((size_t)(local_time / m_key_pose_interval),
+                m_segment_count - 1);
+        const size_t block_index = i_segment / m_block_segment_count;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        _Block *block = _acquireBlock(block_index, lock);
+        _prefetchBlocks(block_index);
+        lock.unlock();
+
+        // A block is a clip of its own whose keys are the keys of its
+        // segments, sample it through an interleaved clip on its key data.
+        const size_t first_segment = block_index * m_block_segment_count;
+        const size_t block_segment_count = std::min(m_block_segment_count,
+            m_segment_count - first_segment);
+        const InterleavedAnimationClip block_clip(block->key_data.data(),
+            m_track_count, block_segment_count + 1, m_key_pose_interval, String());
+        const long block_time = local_time -
+            (long)first_segment * m_key_pose_interval;
+
+        if (ranges)
+            block_clip.extractPose(block_time, ranges, range_count, extracted_pose);
+        else
+            block_clip.extractPose(block_time, extracted_pose);
+
+        // Extractions waiting for a free block could take this one now.
+        lock.lock();
+        if (--block->pin_count == 0)
+            m_block_ready.notify_all();
+    }
+
+    StreamingAnimationClip::_Block *StreamingAnimationClip::_findBlock(
+        size_t block_index) const
+    {
+        for (auto &block : m_blocks) {
+            if (block.state != _BLOCK_STATE_EMPTY && block.index == block_index)
+                return &block;
+        }
+        return nullptr;
+    }
+
+    void StreamingAnimationClip::_getPlayback(bool *is_forward,
+        bool *is_looping, float *speed) const
+    {
+        *is_forward = true;
+        *is_looping = false;
+        *speed = 1.0f;
+        if (m_animation_state) {
+            *speed = m_animation_state->getSpeed();
+            *is_forward = *speed >= 0.0f;
+            *is_looping = m_animation_state->isLooping();
+        }
+    }
+
+    size_t StreamingAnimationClip::_getPlaybackDistance(size_t block_index,
+        size_t other_index, bool is_forward, bool is_looping) const
+    {
+        // Count along the playback direction as if the playback is forward.
+        if (!is_forward)
+            std::swap(block_index, other_index);
+
+        if (other_index >= block_index)
+            return other_index - block_index;
+
+        // A block behind the playback is only played again after a wrap.
+        return is_looping ? other_index + m_block_count - block_index : SIZE_MAX;
+    }
+
+    StreamingAnimationClip::_Block *StreamingAnimationClip::_takeBlock(
+        size_t block_index, const size_t *keep_indices, size_t keep_count) const
+    {
+        bool is_forward, is_looping;
+        float speed;
+        _getPlayback(&is_forward, &is_looping, &speed);
+
+        _Block *taken_block = nullptr;
+        size_t taken_distance = 0;
+        for (auto &block : m_blocks) {
+            if (block.state == _BLOCK_STATE_EMPTY)
+                return &block;
+            if (block.state != _BLOCK_STATE_READY || block.pin_count > 0 ||
+                std::find(keep_indices, keep_indices + keep_count, block.index) !=
+                keep_indices + keep_count)
+                continue;
+
+            // Replace the block which is played last, so the blocks about to
+            // be played stay in the window.
+            const size_t distance = _getPlaybackDistance(block_index,
+                block.index, is_forward, is_looping);
+            if (!taken_block || distance > taken_distance) {
+                taken_block = &block;
+                taken_distance = distance;
+            }
+        }
+        return taken_block;
+    }
+
+    void StreamingAnimationClip::_requestBlock(_Block *block, size_t block_index,
+        bool is_urgent) const
+    {
+        block->index = block_index;
+        block->state = _BLOCK_STATE_LOADING;
+
+        const size_t i_block = block - m_blocks.data();
+        if (is_urgent)
+            m_read_queue.insert(m_read_queue.begin(), i_block);
+        else
+            m_read_queue.push_back(i_block);
+
+        m_read_requested.notify_one();
+    }
+
+    StreamingAnimationClip::_Block *StreamingAnimationClip::_acquireBlock(
+        size_t block_index, std::unique_lock<std::mutex> &lock) const
+    {
+        bool is_missed = false;
+        for (;;) {
+            _Block *block = _findBlock(block_index);
+            if (block && block->state == _BLOCK_STATE_READY) {
+                ++block->pin_count;
+                if (is_missed)
+                    ++m_miss_count;
+                return block;
+            }
+
+            is_missed = true;
+            if (block) {
+                // The block is being read, move it to the front of the queue.
+                const size_t i_block = block - m_blocks.data();
+                auto itor = std::find(m_read_queue.begin(), m_read_queue.end(),
+                    i_block);
+                if (itor != m_read_queue.end() && itor != m_read_queue.begin()) {
+                    m_read_queue.erase(itor);
+                    m_read_queue.insert(m_read_queue.begin(), i_block);
+                }
+            }
+            else {
+                // If every block in the window is busy, wait for one to be
+                // released.
+                block = _takeBlock(block_index, nullptr, 0);
+                if (block)
+                    _requestBlock(block, block_index, true);
+            }
+
+            m_block_ready.wait(lock);
+        }
+    }
+
+    void StreamingAnimationClip::_prefetchBlocks(size_t block_index) const
+    {
+        bool is_forward, is_looping;
+        float speed;
+        _getPlayback(&is_forward, &is_looping, &speed);
+
+        // Prefetch the blocks that the playback reaches in the prefetch time.
+        const long block_time = std::max(m_key_pose_interval *
+            (long)m_block_segment_count, 1L);
+        const size_t max_count = m_blocks.size() - 1;
+        const size_t count = std::min(std::max((size_t)std::ceil(
+            std::fabs(speed) * m_prefetch_time / block_time), (size_t)1), max_count);
+
+        // The blocks wanted in order, the current one first. They're kept in
+        // the window while the others are replaced.
+        const size_t MAX_WANTED_COUNT = 64;
+        size_t wanted_indices[MAX_WANTED_COUNT];
+        size_t wanted_count = 0;
+        wanted_indices[wanted_count++] = block_index;
+
+        size_t next_index = block_index;
+        for (size_t i = 0; i < count && wanted_count < MAX_WANTED_COUNT; ++i) {
+            if (is_forward) {
+                if (next_index + 1 < m_block_count)
+                    ++next_index;
+                else if (is_looping)
+                    next_index = 0;
+                else
+                    break;
+            }
+            else {
+                if (next_index > 0)
+                    --next_index;
+                else if (is_looping)
+                    next_index = m_block_count - 1;
+                else
+                    break;
+            }
+
+            if (next_index == block_index)
+                break;
+            wanted_indices[wanted_count++] = next_index;
+        }
+
+        for (size_t i = 1; i < wanted_count; ++i) {
+            if (_findBlock(wanted_indices[i]))
+                continue;
+
+            _Block *block = _takeBlock(block_index, wanted_indices, wanted_count);
+            if (!block)
+                break;
+            _requestBlock(block, wanted_indices[i], false);
+        }
+    }
+
+    void StreamingAnimationClip::_ioLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (;;) {
+            m_read_requested.wait(lock, [this]() {
+                return m_is_stopping || !m_read_queue.empty(); });
+            if (m_is_stopping)
+                break;
+
+            _Block &block = m_blocks[m_read_queue.front()];
+            m_read_queue.erase(m_read_queue.begin());
+
+            // Nobody else touches a loading block, so it's read unlocked.
+            const size_t first_segment = block.index * m_block_segment_count;
+            const size_t segment_count = std::min(m_block_segment_count,
+                m_segment_count - first_segment);
+            const size_t segment_size =
+                InterleavedAnimationClip::getSegmentSize(m_track_count);
+            const uint64_t offset = m_key_data_offset +
+                (uint64_t)first_segment * segment_size * sizeof(float);
+            const size_t size = segment_count * segment_size * sizeof(float);
+
+            lock.unlock();
+            if (!m_stream.read(offset, block.key_data.data(), size)) {
+                // Fill the block with identity so it's still playable.
+                const float identity[Pose::STREAM_COUNT] = {
+                    0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+                for (size_t i = 0; i < segment_count * segment_size;
+                    i += Pose::STREAM_COUNT)
+                    std::copy(identity, identity + Pose::STREAM_COUNT,
+                        block.key_data.data() + i);
+                m_has_read_error = true;
+            }
+            lock.lock();
+
+            block.state = _BLOCK_STATE_READY;
+            m_block_ready.notify_all();
+        }
+    }
+
+};
\ No newline at end of file
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_asset_file.h"
+#include "s_binary_asset.h"
+#include "s_ianimation_clip.h"
+#include "s_pose.h"
+
+namespace Skanim
+{
+    class AnimationState;
+
+    /** Streaming animation clip plays an animation clip asset from its file
+     *  without loading it whole, for clips too long to be resident. The key
+     *  data of the asset is split into blocks of consecutive segments, and
+     *  only a fixed window of blocks is in memory at a time, so the memory use
+     *  doesn't depend on the length of the clip.
+     *  An I/O thread reads the blocks. Each extraction prefetches the blocks
+     *  which the attached animation state will play next, in its playback
+     *  direction and as far ahead as its speed covers in the prefetch time.
+     *  If a needed block isn't in memory yet the extraction waits for it.
+     *  Extractions could run on several threads at the same time.
+     */
+    class _SKANIM_EXPORT StreamingAnimationClip : public IAnimationClip
+    {
+    public:
+        /** Construct a streaming clip.
+         *  @param block_segment_count The number of segments, the spans
+         *  between adjacent key poses, in a block.
+         *  @param window_block_count The number of blocks in memory, which is
+         *  at least 2 so one block could be read while another is played.
+         */
+        explicit StreamingAnimationClip(size_t block_segment_count = 32,
+            size_t window_block_count = 4) noexcept;
+
+        /** Close the file and stop the I/O thread.
+         */
+        ~StreamingAnimationClip();
+
+        StreamingAnimationClip(const StreamingAnimationClip &) = delete;
+
+        StreamingAnimationClip &operator=(const StreamingAnimationClip &) = delete;
+
+        /** Open an animation clip asset written by
+         *  BinaryAsset::writeAnimationClip() and start the I/O thread. The
+         *  beginning of the asset is validated, the checksum isn't since the
+         *  asset isn't read whole.
+         */
+        BinaryAsset::Status open(const String &file_name);
+
+        /** Close the file and stop the I/O thread. The clip must not be
+         *  extracted while it's closed.
+         */
+        void close();
+
+        /** Get the time length.
+         */
+        virtual long getLength() const override
+        {
+            return m_key_count > 0 ? (m_key_count - 1) * m_key_pose_interval : 0;
+        }
+
+        /** Get the number of tracks
+         */
+        virtual size_t getTrackCount() const override
+        {
+            return m_track_count;
+        }
+
+        /** Extract pose from this clip with local time.
+         */
+        virtual void extractPose(long local_time, Pose *extracted_pose)
+            const override;
+
+        /** Extract the joints in the given ranges from this clip with local
+         *  time.
+         */
+        virtual void extractPose(long local_time, const JointRange *ranges,
+            size_t range_count, Pose *extracted_pose) const override;
+
+        /** Attach the animation state which plays this clip. Its speed and
+         *  looping mode decide which blocks are prefetched and which are
+         *  replaced first. Without a state the blocks after the extracted one
+         *  are prefetched. The extractions read the speed and the looping mode
+         *  without synchronization, so they must not change while the clip is
+         *  extracted on another thread. The state must be detached with
+         *  nullptr before it's destroyed.
+         */
+        void setAnimationState(const AnimationState *animation_state)
+        {
+            m_animation_state = animation_state;
+        }
+
+        /** Get the prefetch time.
+         */
+        long getPrefetchTime() const
+        {
+            return m_prefetch_time;
+        }
+
+        /** Modify the prefetch time, which is how long ahead of the playback
+         *  the blocks are read, in the time of the attached state before its
+         *  speed is applied. At least the next block is always prefetched and
+         *  at most the blocks which fit in the window.
+         */
+        void setPrefetchTime(long prefetch_time)
+        {
+            m_prefetch_time = prefetch_time;
+        }
+
+        /** Get the number of extractions which had to wait for a block.
+         */
+        size_t getMissCount() const
+        {
+            return m_miss_count;
+        }
+
+        /** Check if a block couldn't be read. The transforms of such a block
+         *  are identity.
+         */
+        bool hasReadError() const
+        {
+            return m_has_read_error;
+        }
+
+        /** Get the size in bytes of the blocks in memory.
+         */
+        size_t getResidentSize() const
+        {
+            return m_blocks.size() * m_block_size * sizeof(float);
+        }
+
+        /** Get the name of this clip.
+         */
+        const String &getName() const
+        {
+            return m_name;
+        }
+
+    private:
+        // States of a block in the window.
+        enum _BlockState
+        {
+            _BLOCK_STATE_EMPTY,
+            _BLOCK_STATE_LOADING,
+            _BLOCK_STATE_READY
+        };
+
+        // A block in the window.
+        struct _Block
+        {
+            // The index of the block in the clip.
+            size_t index;
+            _BlockState state;
+            // The number of extractions which are sampling this block.
+            size_t pin_count;
+            // The key data of the block's segments.
+            vector<float> key_data;
+        };
+
+        // Extract the joints in the given ranges, or all the joints if ranges
+        // is nullptr.
+        void _extractPose(long local_time, const JointRange *ranges,
+            size_t range_count, Pose *extracted_pose) const;
+
+        // Find the block in the window which holds the given block, or
+        // nullptr if it's not in the window.
+        _Block *_findBlock(size_t block_index) const;
+
+        // Get the playback direction and speed of the attached state.
+        void _getPlayback(bool *is_forward, bool *is_looping, float *speed) const;
+
+        // Get how many blocks the playback passes from block_index before it
+        // reaches other_index, or SIZE_MAX if it never does.
+        size_t _getPlaybackDistance(size_t block_index, size_t other_index,
+            bool is_forward, bool is_looping) const;
+
+        // Take a window block which isn't used for a new block, the one which
+        // the playback reaches last from block_index. Blocks which are in
+        // keep_indices are kept. Return nullptr if there is none.
+        _Block *_takeBlock(size_t block_index, const size_t *keep_indices,
+            size_t keep_count) const;
+
+        // Start reading a block into a window block.
+        void _requestBlock(_Block *block, size_t block_index, bool is_urgent) const;
+
+        // Pin the given block after it's in memory, reading it if needed.
+        _Block *_acquireBlock(size_t block_index,
+            std::unique_lock<std::mutex> &lock) const;
+
+        // Request the blocks played after the given block.
+        void _prefetchBlocks(size_t block_index) const;
+
+        // The loop of the I/O thread.
+        void _ioLoop();
+
+    private:
+        // The file of the asset.
+        AssetStream m_stream;
+
+        // The layout of the clip in the asset.
+        size_t m_track_count;
+        size_t m_key_count;
+        long m_key_pose_interval;
+        uint64_t m_key_data_offset;
+
+        // The name of this clip.
+        String m_name;
+
+        // The number of segments in the clip and in a block.
+        size_t m_segment_count;
+        const size_t m_block_segment_count;
+        // The number of blocks in the clip.
+        size_t m_block_count;
+        // The number of floats of a full block.
+        size_t m_block_size;
+
+        // The blocks in memory.
+        mutable vector<_Block> m_blocks;
+        // The indices of the window blocks which wait for the I/O thread,
+        // urgent ones are at the front.
+        mutable vector<size_t> m_read_queue;
+
+        // Guards the blocks and the read queue.
+        mutable std::mutex m_mutex;
+        // Signaled when a block is read or the I/O thread has work to do.
+        mutable std::condition_variable m_block_ready;
+        mutable std::condition_variable m_read_requested;
+
+        // The I/O thread and its stop flag.
+        std::thread m_io_thread;
+        bool m_is_stopping;
+
+        // The state which plays this clip.
+        const AnimationState *m_animation_state;
+        // How long ahead of the playback the blocks are read.
+        long m_prefetch_time;
+
+        // Statistics.
+        mutable std::atomic<size_t> m_miss_count;
+        mutable std::atomic<bool> m_has_read_error;
+    };
+};
\ No newline at end of file
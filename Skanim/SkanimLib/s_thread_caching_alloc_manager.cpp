@@ -0,0 +1,128 @@
+#include "s_precomp.h"
+#include "s_thread_caching_alloc_manager.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // The next id of a thread caching alloc manager.
+        std::atomic<uint64_t> _next_manager_id(1);
+
+        // The manager whose cache the calling thread used last, and the cache.
+        // This avoids looking the cache up in most calls.
+        thread_local uint64_t _cached_manager_id = 0;
+        thread_local void *_cached_thread_cache = nullptr;
+    }
+
+    ThreadCachingAllocManager::ThreadCachingAllocManager(
+        size_t cache_block_count, IAllocManager *upstream) noexcept
+        : PoolAllocManager(upstream),
+          m_id(_next_manager_id++),
+          m_cache_block_count(std::max(cache_block_count, (size_t)1)),
+          m_thread_caches(nullptr)
+    {}
+
+    ThreadCachingAllocManager::~ThreadCachingAllocManager()
+    {
+        // The cached blocks belong to the chunks which the pool alloc manager
+        // frees, only the caches themselves are freed here.
+        while (m_thread_caches) {
+            _ThreadCache *next = m_thread_caches->next;
+            m_thread_caches->~_ThreadCache();
+            m_upstream->deallocateBytes(m_thread_caches);
+            m_thread_caches = next;
+        }
+    }
+
+    void *ThreadCachingAllocManager::allocateBytes(size_t count,
+        const wchar_t *file, int line, const wchar_t *func)
+    {
+        const uint32_t size_class = _getSizeClass(count);
+        if (size_class == _LARGE_SIZE_CLASS)
+            return _allocateLarge(count, file, line, func);
+
+        auto &bin = _getThreadCache()->bins[size_class];
+        if (bin.count == 0) {
+            // Refill half of the cache so the next frees don't flush it
+            // right away.
+            bin.count = _popBlocks(size_class, (m_cache_block_count + 1) / 2,
+                &bin.first);
+        }
+
+        void *ptr = bin.first;
+        bin.first = _getNextBlock(ptr);
+        --bin.count;
+
+        return ptr;
+    }
+
+    void ThreadCachingAllocManager::deallocateBytes(void *ptr)
+    {
+        if (ptr == nullptr)
+            return;
+
+        const uint32_t size_class = _getBlockSizeClass(ptr);
+        if (size_class >= _SIZE_CLASS_COUNT) {
+            _deallocateUnpooled(ptr, size_class);
+            return;
+        }
+
+        auto &bin = _getThreadCache()->bins[size_class];
+        _setNextBlock(ptr, bin.first);
+        bin.first = ptr;
+        ++bin.count;
+
+        if (bin.count > m_cache_block_count) {
+            // Give the older half of the blocks back to the shared pool.
+            const size_t kept_count = m_cache_block_count / 2;
+            void *last_kept = bin.first;
+            for (size_t i = 1; i < kept_count; ++i)
+                last_kept = _getNextBlock(last_kept);
+
+            void *first = kept_count > 0 ? _getNextBlock(last_kept) : bin.first;
+            void *last = first;
+            while (_getNextBlock(last) != nullptr)
+                last = _getNextBlock(last);
+
+            _pushBlocks(size_class, first, last, bin.count - kept_count);
+
+            if (kept_count > 0)
+                _setNextBlock(last_kept, nullptr);
+            else
+                bin.first = nullptr;
+            bin.count = kept_count;
+        }
+    }
+
+    ThreadCachingAllocManager::_ThreadCache *
+        ThreadCachingAllocManager::_getThreadCache()
+    {
+        if (_cached_manager_id == m_id)
+            return static_cast<_ThreadCache*>(_cached_thread_cache);
+
+        const std::thread::id thread_id = std::this_thread::get_id();
+
+        std::lock_guard<std::mutex> lock(m_thread_cache_mutex);
+
+        _ThreadCache *cache = m_thread_caches;
+        while (cache && cache->thread_id != thread_id)
+            cache = cache->next;
+
+        if (cache == nullptr) {
+            cache = new (m_upstream->allocateBytes(sizeof(_ThreadCache)))
+                _ThreadCache;
+            cache->thread_id = thread_id;
+            for (auto &bin : cache->bins) {
+                bin.first = nullptr;
+                bin.count = 0;
+            }
+            cache->next = m_thread_caches;
+            m_thread_caches = cache;
+        }
+
+        _cached_manager_id = m_id;
+        _cached_thread_cache = cache;
+
+        return cache;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_pool_alloc_manager.h"
+
+namespace Skanim
+{
+    /** Thread caching alloc manager is a pool alloc manager with a cache of
+     *  free blocks on each thread, so most allocations and deallocations don't
+     *  take any lock. A thread's cache is refilled from the shared pools in
+     *  batches and gives half of its blocks back once it holds more than the
+     *  cache block count of a size class.
+     *  Memory could be freed on another thread than the one which allocated
+     *  it. The cache of a thread stays with the manager after the thread
+     *  exits, it's reused by a later thread with the same id and freed when
+     *  the manager is destroyed.
+     */
+    class _SKANIM_EXPORT ThreadCachingAllocManager : public PoolAllocManager
+    {
+    public:
+        /** The default number of blocks of each size class a thread caches.
+         */
+        static const size_t DEFAULT_CACHE_BLOCK_COUNT = 64;
+
+        /** Construct a thread caching alloc manager.
+         *  @param cache_block_count The number of blocks of each size class a
+         *  thread could cache.
+         *  @param upstream The alloc manager of the chunks and of the large
+         *  allocations. If it's nullptr malloc() and free() are used.
+         */
+        explicit ThreadCachingAllocManager(
+            size_t cache_block_count = DEFAULT_CACHE_BLOCK_COUNT,
+            IAllocManager *upstream = nullptr) noexcept;
+
+        virtual ~ThreadCachingAllocManager();
+
+        virtual void *allocateBytes(size_t count,
+            const wchar_t *file = nullptr, int line = 0,
+            const wchar_t *func = nullptr) override;
+
+        virtual void deallocateBytes(void *ptr) override;
+
+    private:
+        struct _ThreadCache
+        {
+            std::thread::id thread_id;
+            // The next cache of the manager.
+            _ThreadCache *next;
+
+            // The free blocks of each size class.
+            struct
+            {
+                void *first;
+                size_t count;
+            } bins[_SIZE_CLASS_COUNT];
+        };
+
+        // Get the cache of the calling thread, creating it if needed.
+        _ThreadCache *_getThreadCache();
+
+    private:
+        // The id of this manager, which tells the thread caches of different
+        // managers apart. Ids are never reused.
+        const uint64_t m_id;
+
+        const size_t m_cache_block_count;
+
+        // The caches of all threads which used this manager. They are
+        // allocated from the upstream alloc manager, since this manager could
+        // be the one behind the containers.
+        _ThreadCache *m_thread_caches;
+        std::mutex m_thread_cache_mutex;
+    };
+};
\ No newline at end of file
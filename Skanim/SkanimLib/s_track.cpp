@@ -3,5 +3,56 @@
 
 namespace Skanim
 {
+    Track::Track(int key_count) noexcept
+        : m_key_sequence(key_count),
+          m_key_times(key_count)
+    {
+        for (int i_key = 0; i_key < key_count; ++i_key)
+            m_key_times[i_key] = i_key;
+    }
 
-};
\ No newline at end of file
+    Track::Track(const vector<Transform> &key_sequence) noexcept
+        : m_key_sequence(key_sequence),
+          m_key_times(key_sequence.size())
+    {
+        for (size_t i_key = 0; i_key < m_key_times.size(); ++i_key)
+            m_key_times[i_key] = (long)i_key;
+    }
+
+    Track::Track(const vector<Transform> &key_sequence,
+        const vector<long> &key_times) noexcept
+        : m_key_sequence(key_sequence),
+          m_key_times(key_times)
+    {
+        assert(key_sequence.size() == key_times.size() &&
+            "key count doesn't match key time count");
+    }
+
+    void Track::findSegment(long time, size_t *key, float *t) const
+    {
+        assert(!m_key_times.empty() && "track has no key");
+
+        if (time <= m_key_times.front()) {
+            *key = 0;
+            *t = 0.0f;
+            return;
+        }
+
+        if (time >= m_key_times.back()) {
+            *key = m_key_times.size() - 1;
+            *t = 0.0f;
+            return;
+        }
+
+        // Find the first key after the time, the key before it starts the
+        // segment that contains the time.
+        const auto itor_next = std::upper_bound(m_key_times.begin(),
+            m_key_times.end(), time);
+        const size_t next_key = itor_next - m_key_times.begin();
+
+        *key = next_key - 1;
+        *t = (float)(time - m_key_times[*key]) /
+            (m_key_times[next_key] - m_key_times[*key]);
+    }
+
+};
@@ -6,18 +6,28 @@
 namespace Skanim
 {
     /** A track stores a sequence of transform keys which represents the trajectory
-     *  of a joint's motion in space.
+     *  of a joint's motion in space. Each key has a time, keys are sorted by
+     *  their time and don't need to have a constant interval between them.
      */
     class _SKANIM_EXPORT Track
     {
     public:
-        explicit Track(int key_count) noexcept
-            : m_key_sequence(key_count)
-        {}
+        Track() = default;
 
-        explicit Track(const vector<Transform> &key_sequence) noexcept
-            : m_key_sequence(key_sequence)
-        {}
+        /** Construct a track with key count. The time of each key is its index.
+         */
+        explicit Track(int key_count) noexcept;
+
+        /** Construct a track from a key sequence. The time of each key is its
+         *  index.
+         */
+        explicit Track(const vector<Transform> &key_sequence) noexcept;
+
+        /** Construct a track from a key sequence and the time of each key.
+         *  Key times must be strictly increasing.
+         */
+        Track(const vector<Transform> &key_sequence,
+            const vector<long> &key_times) noexcept;
 
         /** Get the numbers of keys.
          */
@@ -26,6 +36,15 @@ namespace Skanim
             return m_key_sequence.size();
         }
 
+        /** Get a specific key on this track.
+         */
+        const Transform &getKey(size_t key) const
+        {
+            assert(key < m_key_sequence.size() && "key out of range");
+
+            return m_key_sequence[key];
+        }
+
         /** Modify a specific key on this track.
          */
         void setKey(size_t key, const Transform &val)
@@ -35,22 +54,62 @@ namespace Skanim
             m_key_sequence[key] = val;
         }
 
+        /** Get the time of a specific key.
+         */
+        long getKeyTime(size_t key) const
+        {
+            assert(key < m_key_times.size() && "key out of range");
+
+            return m_key_times[key];
+        }
+
+        /** Append a key to the end of this track. Its time must be larger than
+         *  the time of the last key.
+         */
+        void addKey(long time, const Transform &val)
+        {
+            assert((m_key_times.empty() || time > m_key_times.back()) &&
+                "key time isn't increasing");
+
+            m_key_sequence.push_back(val);
+            m_key_times.push_back(time);
+        }
+
         /** Take sample on this channel.
          */
         Transform takeSample(size_t key, float t) const
         {
             assert(key < m_key_sequence.size() && "key out of range");
 
-            if (key != m_key_sequence.size() - 1) 
-                return Transform::lerp(t, m_key_sequence[key], 
+            if (key != m_key_sequence.size() - 1)
+                return Transform::lerp(t, m_key_sequence[key],
                     m_key_sequence[key + 1]);
-            else 
+            else
                 // If the key is the last one then there is no way to interpolate.
                 return m_key_sequence[key];
         }
 
+        /** Take sample on this channel at the given time.
+         */
+        Transform takeSample(long time) const
+        {
+            size_t key;
+            float t;
+            findSegment(time, &key, &t);
+            return takeSample(key, t);
+        }
+
+        /** Find the key at or right before the given time, and the factor t for
+         *  interpolation between that key and the next one. Times out of the
+         *  track's range are clamped to the first or the last key.
+         */
+        void findSegment(long time, size_t *key, float *t) const;
+
     private:
         // A transform key sequence.
         vector<Transform> m_key_sequence;
+
+        // The time of each key.
+        vector<long> m_key_times;
     };
 };
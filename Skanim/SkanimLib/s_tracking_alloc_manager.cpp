@@ -0,0 +1,227 @@
+#include "s_precomp.h"
+#include "s_tracking_alloc_manager.h"
+#include "s_memory_config.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        const wchar_t *CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {
+            L"general",
+            L"pose",
+            L"skeleton",
+            L"string",
+            L"animation clip"
+        };
+    }
+
+    void *TrackingAllocManager::_CategoryAllocManager::allocateBytes(
+        size_t count, const wchar_t *file, int line, const wchar_t *func)
+    {
+        void *ptr = _getUpstream()->allocateBytes(count, file, line, func);
+
+        const _CallSite site = { file, line, func };
+        tracker->_addAllocation(ptr, count, category, site);
+
+        return ptr;
+    }
+
+    void TrackingAllocManager::_CategoryAllocManager::deallocateBytes(void *ptr)
+    {
+        if (ptr == nullptr)
+            return;
+
+        tracker->_removeAllocation(ptr);
+        _getUpstream()->deallocateBytes(ptr);
+    }
+
+    void *TrackingAllocManager::_CategoryAllocManager::allocateAlignedBytes(
+        size_t count, size_t alignment, const wchar_t *file, int line,
+        const wchar_t *func)
+    {
+        void *ptr = _getUpstream()->allocateAlignedBytes(count, alignment,
+            file, line, func);
+
+        const _CallSite site = { file, line, func };
+        tracker->_addAllocation(ptr, count, category, site);
+
+        return ptr;
+    }
+
+    void TrackingAllocManager::_CategoryAllocManager::deallocateAlignedBytes(
+        void *ptr)
+    {
+        if (ptr == nullptr)
+            return;
+
+        tracker->_removeAllocation(ptr);
+        _getUpstream()->deallocateAlignedBytes(ptr);
+    }
+
+    IAllocManager *TrackingAllocManager::_CategoryAllocManager::_getUpstream() const
+    {
+        // Without an alloc manager of its own the category uses the global
+        // one.
+        return upstream ? upstream : MemoryConfig::getAllocManager();
+    }
+
+    TrackingAllocManager::TrackingAllocManager() noexcept
+        : m_is_installed(false)
+    {
+        for (int i_category = 0; i_category < MEMORY_CATEGORY_COUNT; ++i_category) {
+            _CategoryAllocManager &manager = m_category_managers[i_category];
+            manager.tracker = this;
+            manager.category = (MemoryCategory)i_category;
+            manager.upstream = nullptr;
+
+            m_category_statistics[i_category] = Statistics();
+        }
+    }
+
+    TrackingAllocManager::~TrackingAllocManager()
+    {
+        uninstall();
+    }
+
+    void TrackingAllocManager::install()
+    {
+        if (m_is_installed)
+            return;
+
+        for (int i_category = 0; i_category < MEMORY_CATEGORY_COUNT; ++i_category) {
+            const MemoryCategory category = (MemoryCategory)i_category;
+            m_category_managers[i_category].upstream =
+                MemoryConfig::getCategoryAllocManager(category);
+            MemoryConfig::setCategoryAllocManager(category,
+                &m_category_managers[i_category]);
+        }
+
+        m_is_installed = true;
+    }
+
+    void TrackingAllocManager::uninstall()
+    {
+        if (!m_is_installed)
+            return;
+
+        for (int i_category = 0; i_category < MEMORY_CATEGORY_COUNT; ++i_category) {
+            const MemoryCategory category = (MemoryCategory)i_category;
+            assert(MemoryConfig::getCategoryAllocManager(category) ==
+                &m_category_managers[i_category] &&
+                "category alloc manager changed while tracking");
+            MemoryConfig::setCategoryAllocManager(category,
+                m_category_managers[i_category].upstream);
+        }
+
+        m_is_installed = false;
+    }
+
+    TrackingAllocManager::Statistics TrackingAllocManager::getCategoryStatistics(
+        MemoryCategory category) const
+    {
+        assert(category < MEMORY_CATEGORY_COUNT && "category out of range");
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_category_statistics[category];
+    }
+
+    TrackingAllocManager::Statistics TrackingAllocManager::getTotalStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Statistics total = Statistics();
+        for (auto &statistics : m_category_statistics) {
+            total.live_size += statistics.live_size;
+            total.live_count += statistics.live_count;
+            // The categories peak at different times, so the sum is an upper
+            // bound of the total peak.
+            total.peak_size += statistics.peak_size;
+            total.total_count += statistics.total_count;
+        }
+
+        return total;
+    }
+
+    void TrackingAllocManager::writeReport(std::wostream &stream) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        stream << L"Skanim memory report\n";
+        stream << L"Category: live bytes / live allocations / peak bytes / "
+            L"total allocations\n";
+        for (int i_category = 0; i_category < MEMORY_CATEGORY_COUNT; ++i_category) {
+            const Statistics &statistics = m_category_statistics[i_category];
+            stream << L"  " << CATEGORY_NAMES[i_category] << L": "
+                << statistics.live_size << L" / " << statistics.live_count
+                << L" / " << statistics.peak_size << L" / "
+                << statistics.total_count << L"\n";
+        }
+
+        // Sort the call sites which still hold memory, the largest first.
+        std::vector<std::pair<const _CallSite*, const Statistics*>> live_sites;
+        for (auto &call_site : m_call_sites) {
+            if (call_site.second.live_count > 0)
+                live_sites.emplace_back(&call_site.first, &call_site.second);
+        }
+        std::sort(live_sites.begin(), live_sites.end(),
+            [](const std::pair<const _CallSite*, const Statistics*> &a,
+               const std::pair<const _CallSite*, const Statistics*> &b) {
+            return a.second->live_size > b.second->live_size;
+        });
+
+        stream << L"Call sites with live memory: " << live_sites.size() << L"\n";
+        for (auto &live_site : live_sites) {
+            const _CallSite &site = *live_site.first;
+            const Statistics &statistics = *live_site.second;
+            stream << L"  " << statistics.live_size << L" bytes in "
+                << statistics.live_count << L" allocations, peak "
+                << statistics.peak_size << L" bytes: ";
+            if (site.file)
+                stream << site.file << L"(" << site.line << L") ";
+            stream << (site.func ? site.func : L"unknown call site") << L"\n";
+        }
+    }
+
+    void TrackingAllocManager::_addAllocation(void *ptr, size_t size,
+        MemoryCategory category, const _CallSite &site)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Statistics &site_statistics = m_call_sites[site];
+        _add(&site_statistics, size);
+        _add(&m_category_statistics[category], size);
+
+        const _Allocation allocation = { size, category, &site_statistics };
+        m_allocations[ptr] = allocation;
+    }
+
+    void TrackingAllocManager::_removeAllocation(void *ptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_allocations.find(ptr);
+        if (it == m_allocations.end())
+            return;
+
+        const _Allocation &allocation = it->second;
+        _remove(allocation.site_statistics, allocation.size);
+        _remove(&m_category_statistics[allocation.category], allocation.size);
+
+        m_allocations.erase(it);
+    }
+
+    void TrackingAllocManager::_add(Statistics *statistics, size_t size)
+    {
+        statistics->live_size += size;
+        ++statistics->live_count;
+        statistics->peak_size = std::max(statistics->peak_size,
+            statistics->live_size);
+        ++statistics->total_count;
+    }
+
+    void TrackingAllocManager::_remove(Statistics *statistics, size_t size)
+    {
+        statistics->live_size -= size;
+        --statistics->live_count;
+    }
+};
\ No newline at end of file
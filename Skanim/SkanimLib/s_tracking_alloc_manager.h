@@ -0,0 +1,163 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_ialloc_manager.h"
+#include "s_memory_category.h"
+
+namespace Skanim
+{
+    /** Tracking alloc manager records the live and the peak memory of each
+     *  memory category and of each call site, to find leaks and to profile
+     *  the heap. It sits in front of the alloc managers which do the actual
+     *  allocations: install() routes every category through it, and the
+     *  memory goes on to the category's own alloc manager, or to the global
+     *  one.
+     *  Call sites are only known when SKANIM_MEMORY_TRACKING is on, otherwise
+     *  all allocations are recorded under an unknown site. Container
+     *  allocations are recorded under Allocator::allocate(), whose function
+     *  name tells the element type.
+     *  The records aren't allocated by Skanim alloc managers, so the tracking
+     *  doesn't show in itself. The manager is thread safe.
+     */
+    class _SKANIM_EXPORT TrackingAllocManager
+    {
+    public:
+        /** The memory statistics of a category or a call site.
+         */
+        struct Statistics
+        {
+            // The bytes and the number of the allocations not freed yet.
+            size_t live_size;
+            size_t live_count;
+            // The largest live_size so far.
+            size_t peak_size;
+            // The number of all allocations so far.
+            size_t total_count;
+        };
+
+        TrackingAllocManager() noexcept;
+
+        /** Uninstall the manager if it's installed.
+         */
+        ~TrackingAllocManager();
+
+        TrackingAllocManager(const TrackingAllocManager &) = delete;
+
+        TrackingAllocManager &operator=(const TrackingAllocManager &) = delete;
+
+        /** Start tracking all the categories. Their current alloc managers are
+         *  kept to do the allocations. Memory allocated before is freed by
+         *  them as well, but it isn't recorded.
+         */
+        void install();
+
+        /** Stop tracking and restore the alloc managers of the categories.
+         */
+        void uninstall();
+
+        /** Check if the manager is installed.
+         */
+        bool isInstalled() const
+        {
+            return m_is_installed;
+        }
+
+        /** Get the statistics of a memory category.
+         */
+        Statistics getCategoryStatistics(MemoryCategory category) const;
+
+        /** Get the statistics of all the categories together.
+         */
+        Statistics getTotalStatistics() const;
+
+        /** Write a report of the categories and of the call sites with live
+         *  memory, the largest first.
+         */
+        void writeReport(std::wostream &stream) const;
+
+    private:
+        // Tracks the allocations of one category.
+        class _CategoryAllocManager : public IAllocManager
+        {
+        public:
+            virtual void *allocateBytes(size_t count,
+                const wchar_t *file = nullptr, int line = 0,
+                const wchar_t *func = nullptr) override;
+
+            virtual void deallocateBytes(void *ptr) override;
+
+            virtual size_t getMaxAllocationSize() override
+            {
+                return _getUpstream()->getMaxAllocationSize();
+            }
+
+            virtual void *allocateAlignedBytes(size_t count, size_t alignment,
+                const wchar_t *file = nullptr, int line = 0,
+                const wchar_t *func = nullptr) override;
+
+            virtual void deallocateAlignedBytes(void *ptr) override;
+
+            TrackingAllocManager *tracker;
+            MemoryCategory category;
+            // The alloc manager of the category before the installation, or
+            // nullptr if the category used the global one.
+            IAllocManager *upstream;
+
+        private:
+            IAllocManager *_getUpstream() const;
+        };
+
+        struct _CallSite
+        {
+            const wchar_t *file;
+            int line;
+            const wchar_t *func;
+
+            bool operator==(const _CallSite &other) const
+            {
+                return file == other.file && line == other.line &&
+                    func == other.func;
+            }
+        };
+
+        struct _CallSiteHash
+        {
+            size_t operator()(const _CallSite &site) const
+            {
+                return std::hash<const void*>()(site.file) ^
+                    std::hash<const void*>()(site.func) * 31 ^ (size_t)site.line;
+            }
+        };
+
+        struct _Allocation
+        {
+            size_t size;
+            MemoryCategory category;
+            // The statistics of the call site.
+            Statistics *site_statistics;
+        };
+
+        // Record an allocation and a deallocation. Memory which wasn't
+        // recorded is ignored on deallocation.
+        void _addAllocation(void *ptr, size_t size, MemoryCategory category,
+            const _CallSite &site);
+        void _removeAllocation(void *ptr);
+
+        static void _add(Statistics *statistics, size_t size);
+        static void _remove(Statistics *statistics, size_t size);
+
+    private:
+        _CategoryAllocManager m_category_managers[MEMORY_CATEGORY_COUNT];
+        bool m_is_installed;
+
+        // Guards the records.
+        mutable std::mutex m_mutex;
+
+        // The records use the std allocator, since the Skanim alloc managers
+        // are the ones being tracked.
+        std::unordered_map<const void*, _Allocation> m_allocations;
+        std::unordered_map<_CallSite, Statistics, _CallSiteHash> m_call_sites;
+
+        Statistics m_category_statistics[MEMORY_CATEGORY_COUNT];
+    };
+};
\ No newline at end of file
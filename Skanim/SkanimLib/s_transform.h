@@ -3,6 +3,7 @@
 #include "s_prerequisites.h"
 #include "s_matrixua4.h"
 #include "s_quaternion.h"
+#include "s_quaternion_batch.h"
 #include "s_vector3.h"
 
 namespace Skanim
@@ -60,6 +61,12 @@ namespace Skanim
             m_scale = val; 
         }
 
+        bool operator==(const Transform &rhs) const
+        {
+            return m_scale == rhs.m_scale && m_rotation == rhs.m_rotation &&
+                m_translation == rhs.m_translation;
+        }
+
         /** Transform point with this transform.
          */
         Vector3 transformPoint(const Vector3 &p) const
@@ -78,8 +85,12 @@ namespace Skanim
          */
         Transform inversed() const
         {
-            return Transform(1.0f / m_scale, m_rotation.conjugate(), 
-                -m_translation);
+            // The translation is undone after the scale and the rotation, so
+            // it's brought into their inverse space.
+            const float inv_scale = 1.0f / m_scale;
+            const Quaternion inv_rotation = m_rotation.conjugate();
+            return Transform(inv_scale, inv_rotation,
+                -m_translation * inv_scale * inv_rotation);
         }
 
         /** Calculate and then return the matrix representation of this transform.
@@ -101,11 +112,20 @@ namespace Skanim
         }
 
         /** Linear Interpolation between two transforms
+         *  @param rotation_mode How the rotations are interpolated.
          */
-        static Transform lerp(float t, const Transform &from, const Transform &to)
+        static Transform lerp(float t, const Transform &from, const Transform &to,
+            QuaternionBatch::Mode rotation_mode = QuaternionBatch::MODE_SLERP_EXACT)
         {
+            Quaternion rotation;
+            if (rotation_mode == QuaternionBatch::MODE_SLERP_EXACT)
+                rotation = Quaternion::slerp(t, from.m_rotation, to.m_rotation);
+            else
+                QuaternionBatch::interpolate(rotation_mode, t, 1, 
+                    &from.m_rotation, &to.m_rotation, &rotation);
+
             return Transform(Math::lerp(t, from.m_scale, to.m_scale),
-                Quaternion::slerp(t, from.m_rotation, to.m_rotation),
+                rotation,
                 Vector3::lerp(t, from.m_translation, to.m_translation));
         }
 
@@ -0,0 +1,219 @@
+#include "s_precomp.h"
+#include "s_transform_batch.h"
+#include "s_matrixua4.h"
+#include "s_simd.h"
+
+namespace Skanim
+{
+    namespace
+    {
+        // Combine Simd::WIDTH pairs of transforms starting at offset.
+        void _combineBlock(const float *const *a, const float *const *b,
+            float *const *result, size_t offset)
+        {
+            const Simd::Float aqx = Simd::loadUnaligned(a[Pose::STREAM_ROTATION_X] + offset);
+            const Simd::Float aqy = Simd::loadUnaligned(a[Pose::STREAM_ROTATION_Y] + offset);
+            const Simd::Float aqz = Simd::loadUnaligned(a[Pose::STREAM_ROTATION_Z] + offset);
+            const Simd::Float aqw = Simd::loadUnaligned(a[Pose::STREAM_ROTATION_W] + offset);
+            const Simd::Float atx = Simd::loadUnaligned(a[Pose::STREAM_TRANSLATION_X] + offset);
+            const Simd::Float aty = Simd::loadUnaligned(a[Pose::STREAM_TRANSLATION_Y] + offset);
+            const Simd::Float atz = Simd::loadUnaligned(a[Pose::STREAM_TRANSLATION_Z] + offset);
+            const Simd::Float as = Simd::loadUnaligned(a[Pose::STREAM_SCALE] + offset);
+
+            const Simd::Float bqx = Simd::loadUnaligned(b[Pose::STREAM_ROTATION_X] + offset);
+            const Simd::Float bqy = Simd::loadUnaligned(b[Pose::STREAM_ROTATION_Y] + offset);
+            const Simd::Float bqz = Simd::loadUnaligned(b[Pose::STREAM_ROTATION_Z] + offset);
+            const Simd::Float bqw = Simd::loadUnaligned(b[Pose::STREAM_ROTATION_W] + offset);
+            const Simd::Float btx = Simd::loadUnaligned(b[Pose::STREAM_TRANSLATION_X] + offset);
+            const Simd::Float bty = Simd::loadUnaligned(b[Pose::STREAM_TRANSLATION_Y] + offset);
+            const Simd::Float btz = Simd::loadUnaligned(b[Pose::STREAM_TRANSLATION_Z] + offset);
+            const Simd::Float bs = Simd::loadUnaligned(b[Pose::STREAM_SCALE] + offset);
+
+            // Quaternion multiplication in skanim is left to right, so A * B
+            // is the Hamilton product B * A.
+            Simd::Float rqw = Simd::mul(bqw, aqw);
+            rqw = Simd::sub(rqw, Simd::mul(bqx, aqx));
+            rqw = Simd::sub(rqw, Simd::mul(bqy, aqy));
+            rqw = Simd::sub(rqw, Simd::mul(bqz, aqz));
+            Simd::Float rqx = Simd::mul(bqw, aqx);
+            rqx = Simd::madd(bqx, aqw, rqx);
+            rqx = Simd::madd(bqy, aqz, rqx);
+            rqx = Simd::sub(rqx, Simd::mul(bqz, aqy));
+            Simd::Float rqy = Simd::mul(bqw, aqy);
+            rqy = Simd::sub(rqy, Simd::mul(bqx, aqz));
+            rqy = Simd::madd(bqy, aqw, rqy);
+            rqy = Simd::madd(bqz, aqx, rqy);
+            Simd::Float rqz = Simd::mul(bqw, aqz);
+            rqz = Simd::madd(bqx, aqy, rqz);
+            rqz = Simd::sub(rqz, Simd::mul(bqy, aqx));
+            rqz = Simd::madd(bqz, aqw, rqz);
+
+            // Scale A's translation by B's scale and rotate it by B's rotation:
+            // v' = v + 2 * w * (u x v) + 2 * u x (u x v), u is the vector part.
+            const Simd::Float vx = Simd::mul(atx, bs);
+            const Simd::Float vy = Simd::mul(aty, bs);
+            const Simd::Float vz = Simd::mul(atz, bs);
+
+            const Simd::Float two = Simd::set1(2.0f);
+            const Simd::Float cx = Simd::mul(two,
+                Simd::sub(Simd::mul(bqy, vz), Simd::mul(bqz, vy)));
+            const Simd::Float cy = Simd::mul(two,
+                Simd::sub(Simd::mul(bqz, vx), Simd::mul(bqx, vz)));
+            const Simd::Float cz = Simd::mul(two,
+                Simd::sub(Simd::mul(bqx, vy), Simd::mul(bqy, vx)));
+
+            Simd::Float rtx = Simd::madd(bqw, cx, vx);
+            rtx = Simd::add(rtx, Simd::sub(Simd::mul(bqy, cz), Simd::mul(bqz, cy)));
+            Simd::Float rty = Simd::madd(bqw, cy, vy);
+            rty = Simd::add(rty, Simd::sub(Simd::mul(bqz, cx), Simd::mul(bqx, cz)));
+            Simd::Float rtz = Simd::madd(bqw, cz, vz);
+            rtz = Simd::add(rtz, Simd::sub(Simd::mul(bqx, cy), Simd::mul(bqy, cx)));
+
+            Simd::storeUnaligned(result[Pose::STREAM_ROTATION_X] + offset, rqx);
+            Simd::storeUnaligned(result[Pose::STREAM_ROTATION_Y] + offset, rqy);
+            Simd::storeUnaligned(result[Pose::STREAM_ROTATION_Z] + offset, rqz);
+            Simd::storeUnaligned(result[Pose::STREAM_ROTATION_W] + offset, rqw);
+            Simd::storeUnaligned(result[Pose::STREAM_TRANSLATION_X] + offset, Simd::add(rtx, btx));
+            Simd::storeUnaligned(result[Pose::STREAM_TRANSLATION_Y] + offset, Simd::add(rty, bty));
+            Simd::storeUnaligned(result[Pose::STREAM_TRANSLATION_Z] + offset, Simd::add(rtz, btz));
+            Simd::storeUnaligned(result[Pose::STREAM_SCALE] + offset, Simd::mul(as, bs));
+        }
+
+        // Convert Simd::WIDTH transforms starting at offset to matrices, and
+        // write the first matrix_count of them.
+        void _toMatricesBlock(const float *const *transforms, size_t offset,
+            MatrixUA4 *matrices, size_t matrix_count)
+        {
+            const Simd::Float qx = Simd::loadUnaligned(transforms[Pose::STREAM_ROTATION_X] + offset);
+            const Simd::Float qy = Simd::loadUnaligned(transforms[Pose::STREAM_ROTATION_Y] + offset);
+            const Simd::Float qz = Simd::loadUnaligned(transforms[Pose::STREAM_ROTATION_Z] + offset);
+            const Simd::Float qw = Simd::loadUnaligned(transforms[Pose::STREAM_ROTATION_W] + offset);
+            const Simd::Float s = Simd::loadUnaligned(transforms[Pose::STREAM_SCALE] + offset);
+
+            // The same as MatrixUA4::fromSQT().
+            const Simd::Float fx = Simd::add(qx, qx);
+            const Simd::Float fy = Simd::add(qy, qy);
+            const Simd::Float fz = Simd::add(qz, qz);
+            const Simd::Float fwx = Simd::mul(fx, qw);
+            const Simd::Float fwy = Simd::mul(fy, qw);
+            const Simd::Float fwz = Simd::mul(fz, qw);
+            const Simd::Float fxx = Simd::mul(fx, qx);
+            const Simd::Float fxy = Simd::mul(fy, qx);
+            const Simd::Float fxz = Simd::mul(fz, qx);
+            const Simd::Float fyy = Simd::mul(fy, qy);
+            const Simd::Float fyz = Simd::mul(fz, qy);
+            const Simd::Float fzz = Simd::mul(fz, qz);
+            const Simd::Float one = Simd::set1(1.0f);
+
+            // The upper 3x3 elements and the translation of each matrix, one
+            // matrix per lane.
+            alignas(SKANIM_SIMD_ALIGNMENT) float elements[12][Simd::WIDTH];
+            Simd::store(elements[0], Simd::mul(s, Simd::sub(one, Simd::add(fyy, fzz))));
+            Simd::store(elements[1], Simd::mul(s, Simd::add(fxy, fwz)));
+            Simd::store(elements[2], Simd::mul(s, Simd::sub(fxz, fwy)));
+            Simd::store(elements[3], Simd::mul(s, Simd::sub(fxy, fwz)));
+            Simd::store(elements[4], Simd::mul(s, Simd::sub(one, Simd::add(fxx, fzz))));
+            Simd::store(elements[5], Simd::mul(s, Simd::add(fyz, fwx)));
+            Simd::store(elements[6], Simd::mul(s, Simd::add(fxz, fwy)));
+            Simd::store(elements[7], Simd::mul(s, Simd::sub(fyz, fwx)));
+            Simd::store(elements[8], Simd::mul(s, Simd::sub(one, Simd::add(fxx, fyy))));
+            Simd::store(elements[9], Simd::loadUnaligned(transforms[Pose::STREAM_TRANSLATION_X] + offset));
+            Simd::store(elements[10], Simd::loadUnaligned(transforms[Pose::STREAM_TRANSLATION_Y] + offset));
+            Simd::store(elements[11], Simd::loadUnaligned(transforms[Pose::STREAM_TRANSLATION_Z] + offset));
+
+            size_t i_matrix = 0;
+#if defined(SKANIM_SIMD_AVX) || defined(SKANIM_SIMD_SSE)
+            // Transpose the lanes into matrix rows four matrices at a time.
+            for (; i_matrix + 4 <= matrix_count; i_matrix += 4) {
+                for (int i_row = 0; i_row < 4; ++i_row) {
+                    __m128 r0 = _mm_load_ps(elements[i_row * 3] + i_matrix);
+                    __m128 r1 = _mm_load_ps(elements[i_row * 3 + 1] + i_matrix);
+                    __m128 r2 = _mm_load_ps(elements[i_row * 3 + 2] + i_matrix);
+                    __m128 r3 = i_row == 3 ? _mm_set1_ps(1.0f) : _mm_setzero_ps();
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+                    _mm_storeu_ps(matrices[i_matrix][i_row], r0);
+                    _mm_storeu_ps(matrices[i_matrix + 1][i_row], r1);
+                    _mm_storeu_ps(matrices[i_matrix + 2][i_row], r2);
+                    _mm_storeu_ps(matrices[i_matrix + 3][i_row], r3);
+                }
+            }
+#endif
+            for (; i_matrix < matrix_count; ++i_matrix) {
+                float *m = matrices[i_matrix].getPtr();
+                for (int i_row = 0; i_row < 4; ++i_row) {
+                    m[i_row * 4] = elements[i_row * 3][i_matrix];
+                    m[i_row * 4 + 1] = elements[i_row * 3 + 1][i_matrix];
+                    m[i_row * 4 + 2] = elements[i_row * 3 + 2][i_matrix];
+                    m[i_row * 4 + 3] = i_row == 3 ? 1.0f : 0.0f;
+                }
+            }
+        }
+    }
+
+    void TransformBatch::combine(size_t count, const ConstStreams &a,
+        const ConstStreams &b, const Streams &result)
+    {
+        size_t i = 0;
+        for (; i + Simd::WIDTH <= count; i += Simd::WIDTH)
+            _combineBlock(a.streams, b.streams, result.streams, i);
+
+        // Copy the remaining transforms into a block padded with identity.
+        if (i < count) {
+            const float IDENTITY[Pose::STREAM_COUNT] = {
+                0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+            float block[3][Pose::STREAM_COUNT][Simd::WIDTH];
+            for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+                for (size_t i_lane = 0; i_lane < Simd::WIDTH; ++i_lane) {
+                    const bool valid = i + i_lane < count;
+                    block[0][i_stream][i_lane] = valid ?
+                        a.streams[i_stream][i + i_lane] : IDENTITY[i_stream];
+                    block[1][i_stream][i_lane] = valid ?
+                        b.streams[i_stream][i + i_lane] : IDENTITY[i_stream];
+                }
+            }
+
+            const float *block_a[Pose::STREAM_COUNT];
+            const float *block_b[Pose::STREAM_COUNT];
+            float *block_result[Pose::STREAM_COUNT];
+            for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+                block_a[i_stream] = block[0][i_stream];
+                block_b[i_stream] = block[1][i_stream];
+                block_result[i_stream] = block[2][i_stream];
+            }
+            _combineBlock(block_a, block_b, block_result, 0);
+
+            for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+                for (size_t i_lane = 0; i + i_lane < count; ++i_lane)
+                    result.streams[i_stream][i + i_lane] = block[2][i_stream][i_lane];
+            }
+        }
+    }
+
+    void TransformBatch::toMatrices(size_t count, const ConstStreams &transforms,
+        MatrixUA4 *matrices)
+    {
+        size_t i = 0;
+        for (; i + Simd::WIDTH <= count; i += Simd::WIDTH)
+            _toMatricesBlock(transforms.streams, i, matrices + i, Simd::WIDTH);
+
+        // Copy the remaining transforms into a block padded with identity.
+        if (i < count) {
+            const float IDENTITY[Pose::STREAM_COUNT] = {
+                0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+            float block[Pose::STREAM_COUNT][Simd::WIDTH];
+            const float *block_streams[Pose::STREAM_COUNT];
+            for (int i_stream = 0; i_stream < Pose::STREAM_COUNT; ++i_stream) {
+                for (size_t i_lane = 0; i_lane < Simd::WIDTH; ++i_lane) {
+                    block[i_stream][i_lane] = i + i_lane < count ?
+                        transforms.streams[i_stream][i + i_lane] : IDENTITY[i_stream];
+                }
+                block_streams[i_stream] = block[i_stream];
+            }
+            _toMatricesBlock(block_streams, 0, matrices + i, count - i);
+        }
+    }
+
+};
\ No newline at end of file
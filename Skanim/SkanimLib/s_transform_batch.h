@@ -0,0 +1,42 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_pose.h"
+
+namespace Skanim
+{
+    /** Batch operations on transform arrays in structure-of-arrays layout.
+     *  A transform array is given as Pose::STREAM_COUNT component arrays which
+     *  are indexed by Pose::Stream, the same layout as Pose::getStream().
+     *  Transforms are processed several at a time with SIMD instructions.
+     */
+    class _SKANIM_EXPORT TransformBatch
+    {
+    public:
+        /** Read only transform component arrays.
+         */
+        struct ConstStreams
+        {
+            const float *streams[Pose::STREAM_COUNT];
+        };
+
+        /** Writable transform component arrays.
+         */
+        struct Streams
+        {
+            float *streams[Pose::STREAM_COUNT];
+        };
+
+        /** Combine count pairs of transforms, the same as Transform::combine()
+         *  on each pair. Result arrays could be the same as the a or b arrays.
+         */
+        static void combine(size_t count, const ConstStreams &a,
+            const ConstStreams &b, const Streams &result);
+
+        /** Convert count transforms to matrices, the same as
+         *  Transform::toMatrix() on each of them.
+         */
+        static void toMatrices(size_t count, const ConstStreams &transforms,
+            MatrixUA4 *matrices);
+    };
+};
@@ -0,0 +1,119 @@
+#include "s_precomp.h"
+#include "s_variable_rate_animation_clip.h"
+
+namespace Skanim
+{
+    VariableRateAnimationClip::VariableRateAnimationClip(size_t track_count,
+        const String &name, long length) noexcept
+        : m_tracks(track_count, Track(vector<Transform>(1, Transform::IDENTITY()))),
+          m_name(name),
+          m_length(length)
+    {}
+
+    size_t VariableRateAnimationClip::getTotalKeyCount() const
+    {
+        size_t key_count = 0;
+        for (auto &track : m_tracks)
+            key_count += track.getKeyCount();
+        return key_count;
+    }
+
+    void VariableRateAnimationClip::extractPose(long local_time,
+        Pose *extracted_pose) const
+    {
+        assert(local_time >= 0 && local_time <= getLength() &&
+            "local time out of range");
+
+        const size_t track_count = m_tracks.size();
+        extracted_pose->resize(track_count);
+
+        const JointRange range = { 0, track_count };
+        _extractTracks(local_time, range, extracted_pose);
+    }
+
+    void VariableRateAnimationClip::extractPose(long local_time,
+        const JointRange *ranges, size_t range_count, Pose *extracted_pose) const
+    {
+        assert(local_time >= 0 && local_time <= getLength() &&
+            "local time out of range");
+
+        extracted_pose->resize(m_tracks.size());
+
+        for (size_t i_range = 0; i_range < range_count; ++i_range)
+            _extractTracks(local_time, ranges[i_range], extracted_pose);
+    }
+
+    void VariableRateAnimationClip::_extractTracks(long local_time,
+        const JointRange &range, Pose *extracted_pose) const
+    {
+        assert(range.begin <= range.end && range.end <= m_tracks.size() &&
+            "joint range out of range");
+
+        float *translation_x = extracted_pose->getStream(Pose::STREAM_TRANSLATION_X);
+        float *translation_y = extracted_pose->getStream(Pose::STREAM_TRANSLATION_Y);
+        float *translation_z = extracted_pose->getStream(Pose::STREAM_TRANSLATION_Z);
+        float *scale = extracted_pose->getStream(Pose::STREAM_SCALE);
+
+        // Every track finds its own segment, so the rotations of a block of
+        // tracks are gathered onto the stack with their own interpolation
+        // factors and then interpolated together.
+        const size_t BLOCK_SIZE = 64;
+        float from_rotations[4][BLOCK_SIZE];
+        float to_rotations[4][BLOCK_SIZE];
+        float factors[BLOCK_SIZE];
+
+        for (size_t i_begin = range.begin; i_begin < range.end;
+            i_begin += BLOCK_SIZE) {
+            const size_t block_count = std::min(BLOCK_SIZE, range.end - i_begin);
+
+            for (size_t i = 0; i < block_count; ++i) {
+                const size_t i_track = i_begin + i;
+                const Track &track = m_tracks[i_track];
+
+                size_t key;
+                float t;
+                track.findSegment(local_time, &key, &t);
+                // The last key has no key next to it, interpolate it with itself.
+                const size_t next_key = std::min(key + 1, track.getKeyCount() - 1);
+
+                const Transform &from = track.getKey(key);
+                const Transform &to = track.getKey(next_key);
+
+                const Quaternion &from_rotation = from.getRotation();
+                const Quaternion &to_rotation = to.getRotation();
+                from_rotations[0][i] = from_rotation.getX();
+                from_rotations[1][i] = from_rotation.getY();
+                from_rotations[2][i] = from_rotation.getZ();
+                from_rotations[3][i] = from_rotation.getW();
+                to_rotations[0][i] = to_rotation.getX();
+                to_rotations[1][i] = to_rotation.getY();
+                to_rotations[2][i] = to_rotation.getZ();
+                to_rotations[3][i] = to_rotation.getW();
+                factors[i] = t;
+
+                const Vector3 &from_translation = from.getTranslation();
+                const Vector3 &to_translation = to.getTranslation();
+                translation_x[i_track] = Math::lerp(t,
+                    from_translation.getX(), to_translation.getX());
+                translation_y[i_track] = Math::lerp(t,
+                    from_translation.getY(), to_translation.getY());
+                translation_z[i_track] = Math::lerp(t,
+                    from_translation.getZ(), to_translation.getZ());
+                scale[i_track] = Math::lerp(t, from.getScale(), to.getScale());
+            }
+
+            const QuaternionBatch::ConstStreams from = {
+                from_rotations[0], from_rotations[1], from_rotations[2], from_rotations[3] };
+            const QuaternionBatch::ConstStreams to = {
+                to_rotations[0], to_rotations[1], to_rotations[2], to_rotations[3] };
+            const QuaternionBatch::Streams result = {
+                extracted_pose->getStream(Pose::STREAM_ROTATION_X) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_Y) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_Z) + i_begin,
+                extracted_pose->getStream(Pose::STREAM_ROTATION_W) + i_begin };
+            QuaternionBatch::interpolate(QuaternionBatch::MODE_SLERP_FAST, factors,
+                block_count, from, to, result);
+        }
+    }
+
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "s_prerequisites.h"
+#include "s_ianimation_clip.h"
+#include "s_pose.h"
+#include "s_track.h"
+
+namespace Skanim
+{
+    /** Variable rate animation clip stores one track per joint. Each track has
+     *  its own keys at arbitrary times, so joints which barely move need only a
+     *  few keys while the others keep as many as they need. Clips of this kind
+     *  are usually produced from key pose animation clips by KeyReducer.
+     */
+    class _SKANIM_EXPORT VariableRateAnimationClip : public IAnimationClip
+    {
+    public:
+        VariableRateAnimationClip(size_t track_count, const String &name,
+            long length) noexcept;
+
+        /** Get the time length.
+         */
+        virtual long getLength() const override
+        {
+            return m_length;
+        }
+
+        /** Get the number of tracks
+         */
+        virtual size_t getTrackCount() const override
+        {
+            return m_tracks.size();
+        }
+
+        /** Extract pose from this clip with local time.
+         */
+        virtual void extractPose(long local_time, Pose *extracted_pose)
+            const override;
+
+        /** Extract the joints in the given ranges from this clip with local
+         *  time. Only the tracks in the ranges are sampled.
+         */
+        virtual void extractPose(long local_time, const JointRange *ranges,
+            size_t range_count, Pose *extracted_pose) const override;
+
+        /** Get the track of a joint.
+         */
+        const Track &getTrack(size_t track_index) const
+        {
+            assert(track_index < m_tracks.size() && "track index out of range");
+
+            return m_tracks[track_index];
+        }
+
+        /** Modify the track of a joint. The track must have at least one key.
+         */
+        void setTrack(size_t track_index, const Track &track)
+        {
+            assert(track_index < m_tracks.size() && "track index out of range");
+            assert(track.getKeyCount() > 0 && "track has no key");
+
+            m_tracks[track_index] = track;
+        }
+
+        /** Get the number of keys of all the tracks.
+         */
+        size_t getTotalKeyCount() const;
+
+        /** Get the name of this clip.
+         */
+        const String &getName() const
+        {
+            return m_name;
+        }
+
+        /** Modify the name of this clip.
+         */
+        void setName(const String &val)
+        {
+            m_name = val;
+        }
+
+    private:
+        // Sample the tracks in a range at local time into the pose.
+        void _extractTracks(long local_time, const JointRange &range,
+            Pose *extracted_pose) const;
+
+    private:
+        typedef vector<Track> _TrackVector;
+
+        // One track per joint.
+        _TrackVector m_tracks;
+
+        // The name of this clip
+        String m_name;
+
+        // The time length of this clip.
+        long m_length;
+    };
+};
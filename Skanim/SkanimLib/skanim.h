@@ -1,14 +1,38 @@
 #pragma once
 
 #include "s_animation_clip.h"
+#include "s_animation_crossfader.h"
 #include "s_animation_state.h"
+#include "s_arena_alloc_manager.h"
+#include "s_asset_file.h"
+#include "s_binary_asset.h"
+#include "s_blend_tree.h"
+#include "s_character_batch.h"
+#include "s_clip_cache.h"
+#include "s_compressed_animation_clip.h"
+#include "s_frame_arena.h"
+#include "s_interleaved_animation_clip.h"
+#include "s_job_system.h"
 #include "s_joint.h"
-#include "s_matrixua4.h"
+#include "s_joint_id.h"
+#include "s_key_reducer.h"
 #include "s_math.h"
+#include "s_matrixua4.h"
+#include "s_pool_alloc_manager.h"
 #include "s_pose.h"
+#include "s_pose_pool.h"
 #include "s_quaternion.h"
+#include "s_root_motion_track.h"
 #include "s_skanim_manager.h"
 #include "s_skeleton.h"
+#include "s_skeleton_definition.h"
+#include "s_skinning_palette.h"
+#include "s_streaming_animation_clip.h"
+#include "s_thread_caching_alloc_manager.h"
+#include "s_track.h"
+#include "s_tracking_alloc_manager.h"
 #include "s_transform.h"
+#include "s_transform_batch.h"
+#include "s_variable_rate_animation_clip.h"
 #include "s_vector3.h"
 #include "s_vector4.h"